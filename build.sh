@@ -32,10 +32,10 @@ else
     USE_DOCKER=1
 fi
 
-CFLAGS="-m68020 -O2 -Wall -noixemul -fcommon -Isdk/include -Isrc"
+CFLAGS="-m68020 -O2 -Wall -noixemul -fcommon -DCJSON_NO_FLOAT -Isdk/include -Isrc"
 LDFLAGS="-noixemul -Lsdk/lib -Wl,--allow-multiple-definition"
 LIBS="-lamisslstubs -lsocket -lm"
-SOURCES="src/main.c src/http.c src/claude.c src/json_utils.c src/cJSON.c src/gui.c src/arexx_port.c src/config.c src/memory.c src/tools.c src/dt_identify.c src/locale.c src/input.c src/base64.c src/png_convert.c"
+SOURCES="src/main.c src/http.c src/claude.c src/json_utils.c src/cJSON.c src/gui.c src/arexx_port.c src/config.c src/memory.c src/tools.c src/dt_identify.c src/locale.c src/input.c src/base64.c src/deflate.c src/png_encode.c src/image_scale.c src/image_encode.c src/bitmap_read.c src/png_convert.c src/tile_hash.c src/screen_rows.c src/screen_grab.c src/batch.c src/cache.c src/sse.c src/json_pull.c src/arena.c src/json_writer.c"
 
 if [ "$USE_DOCKER" = "1" ]; then
     IMAGE="kareandersen/amiga-gcc"
@@ -0,0 +1,174 @@
+/*
+ * arena.c - Bump allocator for transient cJSON trees
+ *
+ * Fetching batch results parses every result line into a tree, copies
+ * one string out of it and deletes it again; every tool call copies
+ * its input before converting it. With libnix malloc that is one
+ * malloc()/free() pair per node, slow and fragmenting over a long
+ * session. While the arena is active, the cJSON hooks take that memory
+ * from big Exec pool blocks by bumping a pointer, and arena_reset()
+ * rewinds it for the next tree in one step.
+ */
+
+#include "arena.h"
+#include "cJSON.h"
+
+#include <stdlib.h>
+
+#include <exec/memory.h>
+#include <proto/exec.h>
+
+#define ARENA_ALIGN  8
+
+struct ArenaBlock {
+    struct ArenaBlock *next;
+    char  *start, *end;         /* Usable range */
+    unsigned long size;         /* Size passed to AllocPooled() */
+    int    single;              /* Holds one big allocation only */
+};
+
+static APTR               arena_pool;
+static struct ArenaBlock *arena_blocks;   /* Newest first */
+static char              *arena_ptr;      /* Bump pointer in arena_blocks */
+static int                arena_active;
+
+/* Add a block with room for at least size bytes */
+static struct ArenaBlock *new_block(size_t size)
+{
+    size_t total = sizeof(struct ArenaBlock) + ARENA_ALIGN + size;
+    struct ArenaBlock *b;
+
+    if (total < ARENA_BLOCK_SIZE - 64)
+        total = ARENA_BLOCK_SIZE - 64;   /* Fits a puddle with pool overhead */
+
+    b = (struct ArenaBlock *)AllocPooled(arena_pool, total);
+    if (!b) return NULL;
+
+    b->start = (char *)(((unsigned long)(b + 1) + ARENA_ALIGN - 1) &
+                        ~(unsigned long)(ARENA_ALIGN - 1));
+    b->end   = (char *)b + total;
+    b->size  = total;
+    b->single = 0;
+    return b;
+}
+
+void *arena_alloc(size_t size)
+{
+    struct ArenaBlock *b;
+    char *p;
+
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    if (arena_blocks && (size_t)(arena_blocks->end - arena_ptr) >= size) {
+        p = arena_ptr;
+        arena_ptr += size;
+        return p;
+    }
+
+    if (!arena_pool) return NULL;
+    b = new_block(size);
+    if (!b) return NULL;
+
+    if (arena_blocks && size > (size_t)(ARENA_BLOCK_SIZE / 4)) {
+        /* Big one-off: keep bumping in the current block */
+        b->single = 1;
+        b->next = arena_blocks->next;
+        arena_blocks->next = b;
+        return b->start;
+    }
+
+    b->next = arena_blocks;
+    arena_blocks = b;
+    arena_ptr = b->start + size;
+    return b->start;
+}
+
+int arena_owns(const void *ptr)
+{
+    const struct ArenaBlock *b;
+    const char *p = (const char *)ptr;
+
+    for (b = arena_blocks; b; b = b->next)
+        if (p >= b->start && p < b->end)
+            return 1;
+    return 0;
+}
+
+/* cJSON hooks */
+static void *hook_malloc(size_t size)
+{
+    void *p = arena_active ? arena_alloc(size) : NULL;
+    return p ? p : malloc(size);
+}
+
+static void hook_free(void *ptr)
+{
+    struct ArenaBlock **bp, *b;
+    const char *p = (const char *)ptr;
+
+    if (!ptr) return;
+
+    for (bp = &arena_blocks; (b = *bp) != NULL; bp = &b->next) {
+        if (p >= b->start && p < b->end) {
+            /* Big one-offs (print buffers that get outgrown) go back
+             * to the pool right away; everything else waits for
+             * arena_release(). */
+            if (b->single && p == b->start) {
+                *bp = b->next;
+                FreePooled(arena_pool, b, b->size);
+            }
+            return;
+        }
+    }
+    free(ptr);
+}
+
+int arena_begin(void)
+{
+    static cJSON_Hooks hooks = { hook_malloc, hook_free };
+
+    if (!arena_pool) {
+        arena_pool = CreatePool(MEMF_ANY, ARENA_BLOCK_SIZE, ARENA_BLOCK_SIZE);
+        if (!arena_pool) return -1;
+    }
+
+    cJSON_InitHooks(&hooks);
+    arena_active = 1;
+    return 0;
+}
+
+void arena_end(void)
+{
+    arena_active = 0;
+}
+
+void arena_reset(void)
+{
+    struct ArenaBlock *b, *next;
+
+    arena_active = 0;
+
+    /* Keep the oldest block (always a regular one, at the end of the
+     * list): the next tree bumps through it again without touching
+     * the pool */
+    for (b = arena_blocks; b && b->next; b = next) {
+        next = b->next;
+        FreePooled(arena_pool, b, b->size);
+    }
+
+    arena_blocks = b;
+    arena_ptr = b ? b->start : NULL;
+}
+
+void arena_release(void)
+{
+    arena_active = 0;
+    cJSON_InitHooks(NULL);
+
+    if (arena_pool) {
+        DeletePool(arena_pool);
+        arena_pool = NULL;
+    }
+    arena_blocks = NULL;
+    arena_ptr = NULL;
+}
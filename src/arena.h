@@ -0,0 +1,41 @@
+#ifndef AMIGAAI_ARENA_H
+#define AMIGAAI_ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_BLOCK_SIZE  32768   /* Pool puddle / arena block size */
+
+/* Arena for transient cJSON trees (batch result lines, tool input
+ * copies).
+ *
+ * Between arena_begin() and arena_end(), cJSON allocations are carved
+ * from large blocks of an Exec memory pool instead of going through
+ * malloc() one node at a time. Freeing arena memory is a no-op; it is
+ * reclaimed at once by arena_reset() or arena_release(). Anything that
+ * must outlive the tree (conversation history) has to be allocated
+ * outside the begin/end window. The arena is global, like the cJSON
+ * hooks. */
+
+/* Route cJSON allocations to the arena. Returns 0 on success, -1 if
+ * the pool cannot be created (allocations then stay on malloc). */
+int arena_begin(void);
+
+/* Stop routing new allocations to the arena. Arena memory stays
+ * valid (and cJSON frees of it stay no-ops) until arena_reset(). */
+void arena_end(void);
+
+/* Rewind the arena for the next tree, keeping its first block. Nothing
+ * allocated from the arena may still be used. */
+void arena_reset(void);
+
+/* Free all arena memory and the pool, and restore the default cJSON
+ * allocator. Called once at exit. */
+void arena_release(void);
+
+/* Allocate size bytes from the arena. Returns NULL on failure. */
+void *arena_alloc(size_t size);
+
+/* Returns 1 if ptr points into arena memory. */
+int arena_owns(const void *ptr);
+
+#endif /* AMIGAAI_ARENA_H */
@@ -24,17 +24,20 @@ static struct ARexxContext *arx_ctx = NULL;
  *   - Set result via MUIA_Application_RexxString on app
  */
 
-/* ASK TEXT/F - Send question to Claude, return response */
+/* ASK NOCACHE/S,TEXT/F - Send question to Claude, return response.
+ * NOCACHE skips the response cache for this question. */
 static ULONG ask_func(struct Hook *hook, Object *app, LONG *params)
 {
-    const char *text = (const char *)params[0];
+    const char *text = (const char *)params[1];
     char *response, *error_msg = NULL;
     (void)hook;
 
     if (!text || !*text)
         return 10;
 
+    arx_ctx->claude->cache_bypass = params[0] != 0;
     response = claude_send(arx_ctx->claude, text, &error_msg);
+    arx_ctx->claude->cache_bypass = 0;
     if (response) {
         free(arx_ctx->last_response);
         arx_ctx->last_response = strdup(response);
@@ -72,15 +75,78 @@ static ULONG clear_func(struct Hook *hook, Object *app, LONG *params)
     return 0;
 }
 
-/* SETMODEL MODEL/A - Change AI model */
+/* Set the model of a route. "OFF" clears the tool/short route.
+ * limit > 0 sets the short query length. Returns 0 or 10. */
+static int set_route_model(const char *model, const char *route_name,
+                           int limit)
+{
+    struct Config *cfg = arx_ctx->claude->config;
+    int route = ROUTE_MAIN;
+    char *dest;
+
+    if (route_name && *route_name) {
+        route = claude_route_lookup(route_name);
+        if (route < 0) return 10;
+    }
+
+    switch (route) {
+    case ROUTE_TOOL:  dest = cfg->tool_model;  break;
+    case ROUTE_SHORT: dest = cfg->short_model; break;
+    default:          dest = cfg->model;       break;
+    }
+
+    if (strcasecmp(model, "OFF") == 0) {
+        if (route == ROUTE_MAIN) return 10;
+        dest[0] = '\0';
+    } else {
+        strncpy(dest, model, CONFIG_MAX_MODEL_LEN - 1);
+        dest[CONFIG_MAX_MODEL_LEN - 1] = '\0';
+    }
+
+    if (route == ROUTE_SHORT && limit > 0)
+        cfg->short_limit = limit;
+
+    return 0;
+}
+
+/* Build the ROUTES result: one line per route,
+ * "<route> <model> <calls> <input_tokens> <output_tokens>" */
+static void format_routes(char *buf, int size)
+{
+    struct Claude *c = arx_ctx->claude;
+    int i, pos = 0;
+
+    buf[0] = '\0';
+    for (i = 0; i < ROUTE_COUNT && pos < size; i++) {
+        pos += snprintf(buf + pos, size - pos, "%s%s %s %d %ld %ld",
+                        i ? "\n" : "", claude_route_name(i),
+                        claude_route_model(c, i),
+                        c->route_stats[i].calls,
+                        c->route_stats[i].input_tokens,
+                        c->route_stats[i].output_tokens);
+    }
+}
+
+/* SETMODEL MODEL/A,ROUTE/K,LIMIT/N - Change AI model of a route
+ * (MAIN, TOOL or SHORT; default MAIN). LIMIT sets the SHORT query length. */
 static ULONG setmodel_func(struct Hook *hook, Object *app, LONG *params)
 {
     const char *model = (const char *)params[0];
+    const char *route = (const char *)params[1];
+    LONG *p_limit = (LONG *)params[2];
     (void)hook; (void)app;
     if (!model || !*model)
         return 10;
-    strncpy(arx_ctx->claude->config->model, model,
-            CONFIG_MAX_MODEL_LEN - 1);
+    return set_route_model(model, route, p_limit ? (int)*p_limit : 0);
+}
+
+/* ROUTES - Return model and usage per route */
+static ULONG routes_func(struct Hook *hook, Object *app, LONG *params)
+{
+    static char buf[3 * (CONFIG_MAX_MODEL_LEN + 48)];
+    (void)hook; (void)params;
+    format_routes(buf, sizeof(buf));
+    set(app, MUIA_Application_RexxString, (ULONG)buf);
     return 0;
 }
 
@@ -291,6 +357,76 @@ static ULONG typetext_func(struct Hook *hook, Object *app, LONG *params)
     return input_type_text(text) == 0 ? 0 : 10;
 }
 
+/* BATCHSUBMIT FILE/A - Submit a file of prompts (one per line) as a
+ * Message Batches job. Returns the batch ID. */
+static ULONG batchsubmit_func(struct Hook *hook, Object *app, LONG *params)
+{
+    const char *file = (const char *)params[0];
+    char *batch_id, *error_msg = NULL;
+    (void)hook;
+
+    if (!file || !*file)
+        return 10;
+
+    batch_id = batch_submit(arx_ctx->claude, file, NULL, &error_msg);
+    if (!batch_id) {
+        free(error_msg);
+        return 10;
+    }
+
+    strncpy(arx_ctx->batch_id, batch_id, BATCH_MAX_ID_LEN - 1);
+    arx_ctx->batch_id[BATCH_MAX_ID_LEN - 1] = '\0';
+    set(app, MUIA_Application_RexxString, (ULONG)batch_id);
+    free(batch_id);
+    return 0;
+}
+
+/* BATCHSTATUS ID - Return status and request counts of a batch
+ * (default: the last submitted batch) */
+static ULONG batchstatus_func(struct Hook *hook, Object *app, LONG *params)
+{
+    const char *id = (const char *)params[0];
+    char *status, *error_msg = NULL;
+    (void)hook;
+
+    status = batch_status(arx_ctx->claude,
+                          id ? id : arx_ctx->batch_id, &error_msg);
+    if (!status) {
+        free(error_msg);
+        return 10;
+    }
+
+    set(app, MUIA_Application_RexxString, (ULONG)status);
+    free(status);
+    return 0;
+}
+
+/* BATCHFETCH FILE/A,ID - Write the results of an ended batch to FILE.
+ * Returns the number of results written. */
+static ULONG batchfetch_func(struct Hook *hook, Object *app, LONG *params)
+{
+    const char *file = (const char *)params[0];
+    const char *id   = (const char *)params[1];
+    char *error_msg = NULL;
+    char buf[16];
+    int n;
+    (void)hook;
+
+    if (!file || !*file)
+        return 10;
+
+    n = batch_fetch(arx_ctx->claude, id ? id : arx_ctx->batch_id,
+                    file, &error_msg);
+    if (n < 0) {
+        free(error_msg);
+        return 10;
+    }
+
+    snprintf(buf, sizeof(buf), "%d", n);
+    set(app, MUIA_Application_RexxString, (ULONG)buf);
+    return 0;
+}
+
 /* Hook structs */
 static struct Hook ask_hook;
 static struct Hook getlast_hook;
@@ -310,14 +446,18 @@ static struct Hook mousemove_hook;
 static struct Hook mouseclick_hook;
 static struct Hook keypress_hook;
 static struct Hook typetext_hook;
+static struct Hook batchsubmit_hook;
+static struct Hook batchstatus_hook;
+static struct Hook batchfetch_hook;
+static struct Hook routes_hook;
 
 /* MUI ARexx command table.
  * MUI handles QUIT automatically via MUIV_Application_ReturnID_Quit. */
 static struct MUI_Command arexx_commands[] = {
-    { (CONST_STRPTR)"ASK",       (CONST_STRPTR)"TEXT/F",   1, NULL, {0,0,0,0,0} },
+    { (CONST_STRPTR)"ASK",       (CONST_STRPTR)"NOCACHE/S,TEXT/F", 2, NULL, {0,0,0,0,0} },
     { (CONST_STRPTR)"GETLAST",   NULL,                     0, NULL, {0,0,0,0,0} },
     { (CONST_STRPTR)"CLEAR",     NULL,                     0, NULL, {0,0,0,0,0} },
-    { (CONST_STRPTR)"SETMODEL",  (CONST_STRPTR)"MODEL/A",  1, NULL, {0,0,0,0,0} },
+    { (CONST_STRPTR)"SETMODEL",  (CONST_STRPTR)"MODEL/A,ROUTE/K,LIMIT/N", 3, NULL, {0,0,0,0,0} },
     { (CONST_STRPTR)"SETSYSTEM", (CONST_STRPTR)"PROMPT/F", 1, NULL, {0,0,0,0,0} },
     { (CONST_STRPTR)"MEMADD",    (CONST_STRPTR)"TEXT/F",   1, NULL, {0,0,0,0,0} },
     { (CONST_STRPTR)"MEMCLEAR",  NULL,                     0, NULL, {0,0,0,0,0} },
@@ -332,6 +472,10 @@ static struct MUI_Command arexx_commands[] = {
     { (CONST_STRPTR)"MOUSECLICK",    (CONST_STRPTR)"BUTTON/A,ACTION/K",    2, NULL, {0,0,0,0,0} },
     { (CONST_STRPTR)"KEYPRESS",      (CONST_STRPTR)"CODE/A/N,QUAL/N",      2, NULL, {0,0,0,0,0} },
     { (CONST_STRPTR)"TYPETEXT",      (CONST_STRPTR)"TEXT/F",                1, NULL, {0,0,0,0,0} },
+    { (CONST_STRPTR)"BATCHSUBMIT",   (CONST_STRPTR)"FILE/A",                1, NULL, {0,0,0,0,0} },
+    { (CONST_STRPTR)"BATCHSTATUS",   (CONST_STRPTR)"ID",                    1, NULL, {0,0,0,0,0} },
+    { (CONST_STRPTR)"BATCHFETCH",    (CONST_STRPTR)"FILE/A,ID",             2, NULL, {0,0,0,0,0} },
+    { (CONST_STRPTR)"ROUTES",        NULL,                                0, NULL, {0,0,0,0,0} },
     { NULL, NULL, 0, NULL, {0,0,0,0,0} }
 };
 
@@ -391,6 +535,16 @@ void arexx_setup(struct ARexxContext *ctx, struct Claude *claude,
     arexx_commands[15].mc_Hook = &mouseclick_hook;
     arexx_commands[16].mc_Hook = &keypress_hook;
     arexx_commands[17].mc_Hook = &typetext_hook;
+
+    init_hook(&batchsubmit_hook, (ULONG (*)())batchsubmit_func);
+    init_hook(&batchstatus_hook, (ULONG (*)())batchstatus_func);
+    init_hook(&batchfetch_hook,  (ULONG (*)())batchfetch_func);
+    arexx_commands[18].mc_Hook = &batchsubmit_hook;
+    arexx_commands[19].mc_Hook = &batchstatus_hook;
+    arexx_commands[20].mc_Hook = &batchfetch_hook;
+
+    init_hook(&routes_hook, (ULONG (*)())routes_func);
+    arexx_commands[21].mc_Hook = &routes_hook;
 }
 
 void arexx_cleanup(struct ARexxContext *ctx)
@@ -558,9 +712,27 @@ char *arexx_exec_local(const char *command, int *rc)
     }
 
     if (strcasecmp(cmd_name, "SETMODEL") == 0) {
-        if (!args || !*args) { *rc = 10; return strdup("Usage: SETMODEL <model>"); }
-        strncpy(arx_ctx->claude->config->model, args, CONFIG_MAX_MODEL_LEN - 1);
-        return strdup("OK");
+        char model[CONFIG_MAX_MODEL_LEN], key[2][8], val[2][16];
+        char *route = NULL;
+        int i, n, limit = 0;
+        n = sscanf(args, "%63s %7s %15s %7s %15s",
+                   model, key[0], val[0], key[1], val[1]);
+        if (n < 1 || n == 2 || n == 4) {
+            *rc = 10;
+            return strdup("Usage: SETMODEL <model> [ROUTE MAIN|TOOL|SHORT] [LIMIT <n>]");
+        }
+        for (i = 0; i < (n - 1) / 2; i++) {
+            if (strcasecmp(key[i], "ROUTE") == 0)      route = val[i];
+            else if (strcasecmp(key[i], "LIMIT") == 0) limit = atoi(val[i]);
+        }
+        *rc = set_route_model(model, route, limit);
+        return strdup(*rc == 0 ? "OK" : "Invalid route or model");
+    }
+
+    if (strcasecmp(cmd_name, "ROUTES") == 0) {
+        char buf[3 * (CONFIG_MAX_MODEL_LEN + 48)];
+        format_routes(buf, sizeof(buf));
+        return strdup(buf);
     }
 
     if (strcasecmp(cmd_name, "SETSYSTEM") == 0) {
@@ -609,6 +781,48 @@ char *arexx_exec_local(const char *command, int *rc)
         return strdup(*rc == 0 ? "OK" : "Failed to type text");
     }
 
+    if (strcasecmp(cmd_name, "BATCHSUBMIT") == 0) {
+        char *batch_id, *error_msg = NULL;
+        if (!args || !*args) { *rc = 10; return strdup("Usage: BATCHSUBMIT <file>"); }
+        batch_id = batch_submit(arx_ctx->claude, args, NULL, &error_msg);
+        if (!batch_id) {
+            *rc = 10;
+            return error_msg ? error_msg : strdup("Batch submit failed");
+        }
+        strncpy(arx_ctx->batch_id, batch_id, BATCH_MAX_ID_LEN - 1);
+        arx_ctx->batch_id[BATCH_MAX_ID_LEN - 1] = '\0';
+        return batch_id;
+    }
+
+    if (strcasecmp(cmd_name, "BATCHSTATUS") == 0) {
+        char *status, *error_msg = NULL;
+        status = batch_status(arx_ctx->claude,
+                              *args ? args : arx_ctx->batch_id, &error_msg);
+        if (!status) {
+            *rc = 10;
+            return error_msg ? error_msg : strdup("Batch status failed");
+        }
+        return status;
+    }
+
+    if (strcasecmp(cmd_name, "BATCHFETCH") == 0) {
+        char file[256], id[BATCH_MAX_ID_LEN];
+        char *error_msg = NULL;
+        int n;
+        file[0] = id[0] = '\0';
+        if (sscanf(args, "%255s %63s", file, id) < 1) {
+            *rc = 10; return strdup("Usage: BATCHFETCH <file> [<id>]");
+        }
+        n = batch_fetch(arx_ctx->claude, id[0] ? id : arx_ctx->batch_id,
+                        file, &error_msg);
+        if (n < 0) {
+            *rc = 10;
+            return error_msg ? error_msg : strdup("Batch fetch failed");
+        }
+        snprintf(result_buf, sizeof(result_buf), "%d", n);
+        return strdup(result_buf);
+    }
+
     *rc = 5;
     snprintf(result_buf, sizeof(result_buf), "Unknown command: %s", cmd_name);
     return strdup(result_buf);
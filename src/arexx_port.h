@@ -2,6 +2,7 @@
 #define AMIGAAI_AREXX_H
 
 #include "claude.h"
+#include "batch.h"
 
 #include <libraries/mui.h>
 
@@ -17,6 +18,7 @@ struct ARexxContext {
     char           *last_response;
     Object         *win;           /* MUI Window for MOVE/RESIZE */
     Object         *app;           /* MUI Application for local exec */
+    char            batch_id[BATCH_MAX_ID_LEN]; /* Last submitted batch */
 };
 
 /* Initialize ARexx context and hooks. Call before gui_open(). */
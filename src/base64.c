@@ -1,48 +1,301 @@
 /*
  * base64.c - Base64 encoding for AmigaAI
  *
- * Used to encode PNG screenshot data for the Claude API.
+ * Used to encode PNG screenshot data for the Claude API (in pieces,
+ * while a request is written out), and to decode base64 text again.
+ *
+ * The encoder looks up 12 bits at a time in a 4096-entry table of
+ * character pairs, so each 3-byte group takes two lookups instead of
+ * four, and reads aligned input as 32-bit words (four groups per three
+ * words). The decoder uses four 256-entry tables holding each
+ * character's value already shifted into place, so a 4-character group
+ * is one OR of four lookups, with invalid characters flagged in a bit
+ * above the data. (A 12-bit decoder table indexed by character pairs
+ * would need 64K entries, too much for an Amiga.)
  */
 
 #include "base64.h"
 #include <stdlib.h>
+#include <string.h>
+
+typedef unsigned int b64_word;      /* 32 bits on all our targets */
+#if defined(__GNUC__)
+typedef unsigned int __attribute__((__may_alias__)) b64_word_alias;
+#else
+typedef unsigned int b64_word_alias;
+#endif
+
+#define IS_WORD_ALIGNED(p) ((((size_t)(p)) & (sizeof(b64_word) - 1)) == 0)
+
+/* Big-endian 32-bit load from an aligned address */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define LOAD_BE32(p) (*(const b64_word_alias *)(p))
+#elif defined(__GNUC__) && defined(__BYTE_ORDER__)
+#define LOAD_BE32(p) __builtin_bswap32(*(const b64_word_alias *)(p))
+#else
+#define LOAD_BE32(p) (((b64_word)(p)[0] << 24) | ((b64_word)(p)[1] << 16) | \
+                      ((b64_word)(p)[2] << 8) | (b64_word)(p)[3])
+#endif
+
+#define B64_BAD 0x01000000U         /* above the 24 data bits */
 
 static const char b64_table[] =
     "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
+static char     b64_pairs[4096][2];
+static b64_word b64_dec[4][256];
+static int      tables_ready;
+
+/* Filled on first use. Every caller writes the same values, so two
+ * tasks racing here do no harm. */
+static void init_tables(void)
+{
+    int i, c;
+
+    for (i = 0; i < 4096; i++) {
+        b64_pairs[i][0] = b64_table[i >> 6];
+        b64_pairs[i][1] = b64_table[i & 63];
+    }
+
+    for (c = 0; c < 256; c++)
+        for (i = 0; i < 4; i++)
+            b64_dec[i][c] = B64_BAD;
+    for (c = 0; c < 64; c++) {
+        unsigned char ch = (unsigned char)b64_table[c];
+        b64_dec[0][ch] = (b64_word)c << 18;
+        b64_dec[1][ch] = (b64_word)c << 12;
+        b64_dec[2][ch] = (b64_word)c << 6;
+        b64_dec[3][ch] = (b64_word)c;
+    }
+
+    tables_ready = 1;
+}
+
+#define PUT_PAIR(o, bits12) memcpy((o), b64_pairs[(bits12)], 2)
+
+/* Encode whole 3-byte groups; len must be a multiple of 3 */
+static size_t encode_groups(const unsigned char *in, size_t len, char *out)
+{
+    char *o = out;
+
+    /* Three groups at most bring the input to a word boundary */
+    while (len >= 3 && !IS_WORD_ALIGNED(in)) {
+        b64_word g = ((b64_word)in[0] << 16) | ((b64_word)in[1] << 8) | in[2];
+        PUT_PAIR(o, g >> 12);
+        PUT_PAIR(o + 2, g & 0xFFF);
+        in += 3;
+        o += 4;
+        len -= 3;
+    }
+
+    /* Four groups from three words */
+    while (len >= 12) {
+        b64_word w0 = LOAD_BE32(in);
+        b64_word w1 = LOAD_BE32(in + 4);
+        b64_word w2 = LOAD_BE32(in + 8);
+
+        PUT_PAIR(o,      w0 >> 20);
+        PUT_PAIR(o + 2,  (w0 >> 8) & 0xFFF);
+        PUT_PAIR(o + 4,  ((w0 & 0xFF) << 4) | (w1 >> 28));
+        PUT_PAIR(o + 6,  (w1 >> 16) & 0xFFF);
+        PUT_PAIR(o + 8,  (w1 >> 4) & 0xFFF);
+        PUT_PAIR(o + 10, ((w1 & 0xF) << 8) | (w2 >> 24));
+        PUT_PAIR(o + 12, (w2 >> 12) & 0xFFF);
+        PUT_PAIR(o + 14, w2 & 0xFFF);
+        in += 12;
+        o += 16;
+        len -= 12;
+    }
+
+    while (len >= 3) {
+        b64_word g = ((b64_word)in[0] << 16) | ((b64_word)in[1] << 8) | in[2];
+        PUT_PAIR(o, g >> 12);
+        PUT_PAIR(o + 2, g & 0xFFF);
+        in += 3;
+        o += 4;
+        len -= 3;
+    }
+
+    return (size_t)(o - out);
+}
+
+/* Last 1 or 2 bytes, padded */
+static size_t encode_tail(const unsigned char *in, size_t len, char *out)
+{
+    b64_word g;
+
+    if (len == 0)
+        return 0;
+
+    g = (b64_word)in[0] << 16;
+    if (len > 1)
+        g |= (b64_word)in[1] << 8;
+    PUT_PAIR(out, g >> 12);
+    out[2] = len > 1 ? b64_table[(g >> 6) & 63] : '=';
+    out[3] = '=';
+    return 4;
+}
+
+size_t base64_encode_block(const unsigned char *data, size_t len, char *out)
+{
+    size_t whole = len - len % 3, j;
+
+    if (!tables_ready)
+        init_tables();
+
+    j = encode_groups(data, whole, out);
+    return j + encode_tail(data + whole, len - whole, out + j);
+}
+
+void base64_encode_init(struct Base64Encoder *enc)
+{
+    enc->ncarry = 0;
+    if (!tables_ready)
+        init_tables();
+}
+
+size_t base64_encode_update(struct Base64Encoder *enc,
+                            const unsigned char *data, size_t len, char *out)
+{
+    size_t j = 0, whole;
+
+    if (enc->ncarry > 0) {
+        while (enc->ncarry < 3 && len > 0) {
+            enc->carry[enc->ncarry++] = *data++;
+            len--;
+        }
+        if (enc->ncarry < 3)
+            return 0;
+        j = encode_groups(enc->carry, 3, out);
+        enc->ncarry = 0;
+    }
+
+    whole = len - len % 3;
+    j += encode_groups(data, whole, out + j);
+
+    while (whole < len)
+        enc->carry[enc->ncarry++] = data[whole++];
+
+    return j;
+}
+
+size_t base64_encode_final(struct Base64Encoder *enc, char *out)
+{
+    size_t j = encode_tail(enc->carry, (size_t)enc->ncarry, out);
+
+    enc->ncarry = 0;
+    return j;
+}
+
 char *base64_encode(const unsigned char *data, size_t len, size_t *out_len)
 {
-    size_t olen, i, j;
+    size_t j;
     char *out;
 
-    olen = 4 * ((len + 2) / 3);
-    out = (char *)malloc(olen + 1);
+    out = (char *)malloc(BASE64_ENCODED_LEN(len) + 1);
     if (!out)
         return NULL;
 
-    for (i = 0, j = 0; i + 2 < len; i += 3) {
-        out[j++] = b64_table[(data[i] >> 2) & 0x3F];
-        out[j++] = b64_table[((data[i] & 0x03) << 4) | ((data[i+1] >> 4) & 0x0F)];
-        out[j++] = b64_table[((data[i+1] & 0x0F) << 2) | ((data[i+2] >> 6) & 0x03)];
-        out[j++] = b64_table[data[i+2] & 0x3F];
-    }
-
-    if (i < len) {
-        out[j++] = b64_table[(data[i] >> 2) & 0x3F];
-        if (i + 1 < len) {
-            out[j++] = b64_table[((data[i] & 0x03) << 4) | ((data[i+1] >> 4) & 0x0F)];
-            out[j++] = b64_table[((data[i+1] & 0x0F) << 2)];
-        } else {
-            out[j++] = b64_table[((data[i] & 0x03) << 4)];
-            out[j++] = '=';
+    j = base64_encode_block(data, len, out);
+    out[j] = '\0';
+
+    if (out_len)
+        *out_len = j;
+
+    return out;
+}
+
+void base64_decode_init(struct Base64Decoder *dec)
+{
+    dec->acc = 0;
+    dec->bits = 0;
+    dec->state = 0;
+    if (!tables_ready)
+        init_tables();
+}
+
+long base64_decode_update(struct Base64Decoder *dec,
+                          const char *text, size_t len, unsigned char *out)
+{
+    const unsigned char *s = (const unsigned char *)text;
+    const unsigned char *end = s + len;
+    unsigned char *o = out;
+
+    if (dec->state < 0)
+        return -1;
+
+    while (s < end) {
+        unsigned char c;
+        b64_word v;
+
+        /* On a group boundary: whole groups with one OR each, until
+         * whitespace, padding or the end of the piece */
+        if (dec->bits == 0 && dec->state == 0) {
+            while (end - s >= 4) {
+                b64_word w = b64_dec[0][s[0]] | b64_dec[1][s[1]] |
+                             b64_dec[2][s[2]] | b64_dec[3][s[3]];
+                if (w & B64_BAD)
+                    break;
+                o[0] = (unsigned char)(w >> 16);
+                o[1] = (unsigned char)(w >> 8);
+                o[2] = (unsigned char)w;
+                o += 3;
+                s += 4;
+            }
+            if (s == end)
+                break;
+        }
+
+        c = *s++;
+        v = b64_dec[3][c];
+        if (!(v & B64_BAD)) {
+            if (dec->state != 0)
+                goto invalid;
+            dec->acc = (dec->acc << 6) | v;
+            dec->bits += 6;
+            if (dec->bits >= 8) {
+                dec->bits -= 8;
+                *o++ = (unsigned char)(dec->acc >> dec->bits);
+            }
+        } else if (c == '=') {
+            dec->state = 1;
+        } else if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+            goto invalid;
         }
-        out[j++] = '=';
     }
 
-    out[j] = '\0';
+    return (long)(o - out);
+
+invalid:
+    dec->state = -1;
+    return -1;
+}
+
+int base64_decode_final(struct Base64Decoder *dec)
+{
+    /* Six bits left means a single character in the last group */
+    return (dec->state < 0 || dec->bits == 6) ? -1 : 0;
+}
+
+unsigned char *base64_decode(const char *text, size_t len, size_t *out_len)
+{
+    struct Base64Decoder dec;
+    unsigned char *out;
+    long n;
+
+    out = (unsigned char *)malloc(BASE64_DECODED_MAX(len));
+    if (!out)
+        return NULL;
+
+    base64_decode_init(&dec);
+    n = base64_decode_update(&dec, text, len, out);
+    if (n < 0 || base64_decode_final(&dec) != 0) {
+        free(out);
+        return NULL;
+    }
 
     if (out_len)
-        *out_len = j;
+        *out_len = (size_t)n;
 
     return out;
 }
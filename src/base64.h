@@ -3,10 +3,67 @@
 
 #include <stddef.h>
 
+/* Length of the base64 text for len bytes */
+#define BASE64_ENCODED_LEN(len) (((len) + 2) / 3 * 4)
+
+/* Room needed for the bytes decoded from len characters of text,
+ * including up to two bytes still pending from an earlier update */
+#define BASE64_DECODED_MAX(len) ((len) / 4 * 3 + 3)
+
+/* Streaming encoder: feed data in pieces of any size while it is
+ * being read, then flush the last partial group with final. */
+struct Base64Encoder {
+    unsigned char carry[3];     /* bytes of an incomplete group */
+    int           ncarry;
+};
+
+/* Streaming decoder. Whitespace between characters is skipped;
+ * only '=' and whitespace may follow padding. */
+struct Base64Decoder {
+    unsigned long acc;
+    int           bits;         /* undecoded bits in acc */
+    int           state;        /* 0 data, 1 after padding, -1 error */
+};
+
+/* Encode len bytes to out (not NUL-terminated), which must have room
+ * for BASE64_ENCODED_LEN(len) characters. Returns the number written.
+ * Data can be encoded in pieces: all pieces but the last must be a
+ * multiple of 3 bytes long. */
+size_t base64_encode_block(const unsigned char *data, size_t len, char *out);
+
+void base64_encode_init(struct Base64Encoder *enc);
+
+/* Encode the next len bytes. out needs room for BASE64_ENCODED_LEN(len)
+ * characters; up to two bytes are held back for the next call.
+ * Returns the number of characters written. */
+size_t base64_encode_update(struct Base64Encoder *enc,
+                            const unsigned char *data, size_t len, char *out);
+
+/* Write the held-back bytes with padding (at most 4 characters).
+ * Returns the number of characters written. */
+size_t base64_encode_final(struct Base64Encoder *enc, char *out);
+
 /* Encode binary data to base64 string.
  * Returns newly allocated null-terminated string (caller must free).
  * If out_len is not NULL, the encoded length (excluding NUL) is stored there.
  * Returns NULL on allocation failure. */
 char *base64_encode(const unsigned char *data, size_t len, size_t *out_len);
 
+void base64_decode_init(struct Base64Decoder *dec);
+
+/* Decode the next len characters into out, which needs room for
+ * BASE64_DECODED_MAX(len) bytes. Returns the number of bytes written,
+ * or -1 on invalid input (the decoder then stays failed). */
+long base64_decode_update(struct Base64Decoder *dec,
+                          const char *text, size_t len, unsigned char *out);
+
+/* Returns 0 if the text ended on a complete group, -1 otherwise */
+int base64_decode_final(struct Base64Decoder *dec);
+
+/* Decode base64 text of length len. Whitespace is skipped.
+ * Returns newly allocated buffer (caller must free) with the decoded
+ * bytes; *out_len is set to their count.
+ * Returns NULL on invalid input or allocation failure. */
+unsigned char *base64_decode(const char *text, size_t len, size_t *out_len);
+
 #endif /* AMIGAAI_BASE64_H */
@@ -0,0 +1,284 @@
+/*
+ * batch.c - Message Batches API support for AmigaAI
+ *
+ * Submits a file of independent prompts as one batch job, polls its
+ * status and downloads the results. Used by the ARexx BATCHSUBMIT,
+ * BATCHSTATUS and BATCHFETCH commands for bulk jobs (mail
+ * classification, document summaries) that do not need answers
+ * immediately.
+ */
+
+#include "batch.h"
+#include "arena.h"
+#include "json_utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Build the system prompt for batch requests: memory + configured
+ * system prompt. Tool hints are omitted since batches run without tools. */
+static const char *batch_system_prompt(struct Claude *ctx, char *buf, int bufsize)
+{
+    int pos = 0;
+
+    buf[0] = '\0';
+
+    if (ctx->memory && ctx->memory->count > 0)
+        pos = memory_format(ctx->memory, buf, bufsize);
+
+    if (ctx->config->system_prompt[0])
+        snprintf(buf + pos, bufsize - pos, "%s", ctx->config->system_prompt);
+
+    return buf[0] ? buf : NULL;
+}
+
+char *batch_submit(struct Claude *ctx, const char *prompt_file,
+                   int *count, char **error_msg)
+{
+    static char system[CONFIG_MAX_PROMPT_LEN + MEMORY_MAX_SIZE + 64];
+    const char *sys_ptr;
+    struct HttpResponse response;
+    cJSON *root, *requests;
+    char *line, *body, *batch_id = NULL;
+    FILE *f;
+    int lineno = 0, n = 0, rc;
+
+    if (count) *count = 0;
+    if (error_msg) *error_msg = NULL;
+
+    if (!ctx->config->api_key[0]) {
+        if (error_msg) *error_msg = strdup("No API key configured");
+        return NULL;
+    }
+
+    f = fopen(prompt_file, "r");
+    if (!f) {
+        if (error_msg) *error_msg = strdup("Cannot open prompt file");
+        return NULL;
+    }
+
+    line = malloc(BATCH_MAX_LINE_LEN);
+    root = cJSON_CreateObject();
+    requests = cJSON_AddArrayToObject(root, "requests");
+    if (!line || !root || !requests) {
+        fclose(f);
+        free(line);
+        cJSON_Delete(root);
+        if (error_msg) *error_msg = strdup("Out of memory");
+        return NULL;
+    }
+
+    sys_ptr = batch_system_prompt(ctx, system, sizeof(system));
+
+    while (fgets(line, BATCH_MAX_LINE_LEN, f)) {
+        int len = strlen(line);
+        char custom_id[24];
+        cJSON *entry;
+
+        lineno++;
+
+        /* Strip trailing whitespace/newline, skip blank lines */
+        while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r' ||
+                           line[len-1] == ' '  || line[len-1] == '\t'))
+            line[--len] = '\0';
+        if (len == 0) continue;
+
+        snprintf(custom_id, sizeof(custom_id), "line-%d", lineno);
+        entry = json_make_batch_entry(custom_id, ctx->config->model,
+                                      ctx->config->max_tokens,
+                                      sys_ptr, line);
+        if (!entry) {
+            fclose(f);
+            free(line);
+            cJSON_Delete(root);
+            if (error_msg) *error_msg = strdup("Out of memory");
+            return NULL;
+        }
+        cJSON_AddItemToArray(requests, entry);
+        n++;
+    }
+    fclose(f);
+    free(line);
+
+    if (n == 0) {
+        cJSON_Delete(root);
+        if (error_msg) *error_msg = strdup("Prompt file is empty");
+        return NULL;
+    }
+
+    body = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (!body) {
+        if (error_msg) *error_msg = strdup("Failed to build request JSON");
+        return NULL;
+    }
+
+    printf("  [batch] submitting %d prompts from %s\n", n, prompt_file);
+
+    rc = claude_api_request(ctx, "POST", BATCH_API_PATH, NULL,
+                            body, (long)strlen(body), &response);
+    cJSON_free(body);
+
+    if (rc != 0) {
+        if (error_msg) *error_msg = strdup("HTTPS request failed");
+        return NULL;
+    }
+
+    if (response.status_code != 200) {
+        if (error_msg) *error_msg = claude_http_error(&response);
+        free(response.body);
+        return NULL;
+    }
+
+    {
+        cJSON *resp = cJSON_Parse(response.body);
+        cJSON *id_obj = cJSON_GetObjectItemCaseSensitive(resp, "id");
+        if (cJSON_IsString(id_obj) &&
+            strlen(id_obj->valuestring) < BATCH_MAX_ID_LEN)
+            batch_id = strdup(id_obj->valuestring);
+        cJSON_Delete(resp);
+    }
+    free(response.body);
+
+    if (!batch_id) {
+        if (error_msg) *error_msg = strdup("No batch ID in response");
+        return NULL;
+    }
+
+    printf("  [batch] created %s\n", batch_id);
+    if (count) *count = n;
+    return batch_id;
+}
+
+/* GET a batch sub-resource. Returns the response body (caller frees)
+ * or NULL with *error_msg set. */
+static char *batch_get(struct Claude *ctx, const char *batch_id,
+                       const char *suffix, char **error_msg)
+{
+    struct HttpResponse response;
+    char path[BATCH_MAX_ID_LEN + 64];
+
+    if (error_msg) *error_msg = NULL;
+
+    if (!batch_id || !batch_id[0] ||
+        strlen(batch_id) >= BATCH_MAX_ID_LEN ||
+        strchr(batch_id, '/') || strchr(batch_id, ' '))
+    {
+        if (error_msg) *error_msg = strdup("Invalid batch ID");
+        return NULL;
+    }
+
+    snprintf(path, sizeof(path), "%s/%s%s", BATCH_API_PATH, batch_id, suffix);
+
+    if (claude_api_request(ctx, "GET", path, NULL, NULL, 0, &response) != 0) {
+        if (error_msg) *error_msg = strdup("HTTPS request failed");
+        return NULL;
+    }
+
+    if (response.status_code != 200) {
+        if (error_msg) *error_msg = claude_http_error(&response);
+        free(response.body);
+        return NULL;
+    }
+
+    return response.body;
+}
+
+char *batch_status(struct Claude *ctx, const char *batch_id,
+                   char **error_msg)
+{
+    static const char *count_keys[] = {
+        "processing", "succeeded", "errored", "canceled", "expired", NULL
+    };
+    char *body, *result = NULL;
+    cJSON *root, *status, *counts;
+
+    body = batch_get(ctx, batch_id, "", error_msg);
+    if (!body) return NULL;
+
+    root = cJSON_Parse(body);
+    free(body);
+
+    status = cJSON_GetObjectItemCaseSensitive(root, "processing_status");
+    counts = cJSON_GetObjectItemCaseSensitive(root, "request_counts");
+
+    if (cJSON_IsString(status)) {
+        char buf[128];
+        int pos, i;
+
+        pos = snprintf(buf, sizeof(buf), "%s", status->valuestring);
+        for (i = 0; count_keys[i] && pos < (int)sizeof(buf); i++) {
+            cJSON *c = cJSON_GetObjectItemCaseSensitive(counts, count_keys[i]);
+            pos += snprintf(buf + pos, sizeof(buf) - pos, " %d",
+                            cJSON_IsNumber(c) ? c->valueint : 0);
+        }
+        result = strdup(buf);
+    } else if (error_msg) {
+        *error_msg = strdup("No processing_status in response");
+    }
+
+    cJSON_Delete(root);
+    return result;
+}
+
+/* Write text on one line, escaping newlines and backslashes */
+static void write_escaped(FILE *f, const char *text)
+{
+    for (; *text; text++) {
+        switch (*text) {
+        case '\n': fputs("\\n", f);  break;
+        case '\\': fputs("\\\\", f); break;
+        case '\r': break;
+        case '\t': fputc(' ', f);    break;
+        default:   fputc(*text, f);  break;
+        }
+    }
+}
+
+int batch_fetch(struct Claude *ctx, const char *batch_id,
+                const char *out_file, char **error_msg)
+{
+    char *body, *line, *next;
+    FILE *f;
+    int n = 0;
+
+    body = batch_get(ctx, batch_id, "/results", error_msg);
+    if (!body) return -1;
+
+    f = fopen(out_file, "w");
+    if (!f) {
+        free(body);
+        if (error_msg) *error_msg = strdup("Cannot create output file");
+        return -1;
+    }
+
+    /* Results are JSONL: one JSON object per line */
+    for (line = body; line && *line; line = next) {
+        char *custom_id, *result_type, *text;
+
+        next = strchr(line, '\n');
+        if (next) *next++ = '\0';
+
+        /* The parsed line only lives until its strings are copied
+         * out, so its nodes come from the arena */
+        arena_begin();
+        text = json_parse_batch_result(line, &custom_id, &result_type);
+        arena_reset();
+        if (text) {
+            fprintf(f, "%s\t%s\t", custom_id, result_type);
+            write_escaped(f, text);
+            fputc('\n', f);
+            n++;
+        }
+        free(custom_id);
+        free(result_type);
+        free(text);
+    }
+
+    fclose(f);
+    free(body);
+
+    printf("  [batch] wrote %d results to %s\n", n, out_file);
+    return n;
+}
@@ -0,0 +1,34 @@
+#ifndef AMIGAAI_BATCH_H
+#define AMIGAAI_BATCH_H
+
+#include "claude.h"
+
+#define BATCH_API_PATH      "/v1/messages/batches"
+#define BATCH_MAX_ID_LEN    64
+#define BATCH_MAX_LINE_LEN  4096   /* Max length of one prompt line */
+
+/* Submit every non-empty line of prompt_file as an independent request
+ * of one Message Batches job. Each request gets custom_id "line-<n>"
+ * (1-based line number) so results can be matched to their prompts.
+ * Requests use the configured model, max_tokens, system prompt and
+ * memory, but no tools and no conversation history.
+ * Returns the newly allocated batch ID (caller must free) or NULL.
+ * *count (if not NULL) is set to the number of submitted prompts.
+ * On error, *error_msg (if not NULL) is set to an error description. */
+char *batch_submit(struct Claude *ctx, const char *prompt_file,
+                   int *count, char **error_msg);
+
+/* Query a batch. Returns a newly allocated status line
+ * "<processing_status> <processing> <succeeded> <errored> <canceled> <expired>"
+ * e.g. "in_progress 10 0 0 0 0" or "ended 0 9 1 0 0", or NULL on error. */
+char *batch_status(struct Claude *ctx, const char *batch_id,
+                   char **error_msg);
+
+/* Download the results of an ended batch into out_file, one line per
+ * request: "<custom_id><TAB><result_type><TAB><text>". Newlines in the
+ * text are written as "\n", backslashes as "\\".
+ * Returns the number of results written, or -1 on error. */
+int batch_fetch(struct Claude *ctx, const char *batch_id,
+                const char *out_file, char **error_msg);
+
+#endif /* AMIGAAI_BATCH_H */
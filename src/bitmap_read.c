@@ -0,0 +1,124 @@
+/*
+ * bitmap_read.c - Read pixels from Amiga bitmaps a row at a time
+ *
+ * Planar (and 8-bit RTG) bitmaps are read as pens with graphics.library
+ * ReadPixelArray8(), which converts planar to chunky through a
+ * temporary bitmap; doing one row at a time keeps that to a single row
+ * of chip RAM. Deeper RTG bitmaps are read as RGB through
+ * cybergraphics.library, which Picasso96 provides too. Used for loaded
+ * pictures (png_convert.c) and the screen (screen_grab.c).
+ */
+
+#include "bitmap_read.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <exec/memory.h>
+#include <proto/exec.h>
+#include <proto/graphics.h>
+#include <proto/cybergraphics.h>
+#include <cybergraphx/cybergraphics.h>
+
+struct GfxBase *GfxBase_bm = NULL;   /* also used by screen_grab.c */
+static struct Library *CyberGfxBase_bm = NULL;
+
+/* Assign to the linker symbols GCC expects */
+#define GfxBase      GfxBase_bm
+#define CyberGfxBase CyberGfxBase_bm
+
+int bitmap_read_open(void)
+{
+    if (!GfxBase_bm) {
+        GfxBase_bm = (APTR)OpenLibrary((CONST_STRPTR)"graphics.library", 39);
+        if (!GfxBase_bm) return -1;
+
+        /* Optional: only needed for truecolor RTG screens */
+        CyberGfxBase_bm = OpenLibrary((CONST_STRPTR)"cybergraphics.library", 40);
+    }
+    return 0;
+}
+
+void bitmap_read_cleanup(void)
+{
+    if (CyberGfxBase_bm) {
+        CloseLibrary(CyberGfxBase_bm);
+        CyberGfxBase_bm = NULL;
+    }
+    if (GfxBase_bm) {
+        CloseLibrary((APTR)GfxBase_bm);
+        GfxBase_bm = NULL;
+    }
+}
+
+int bitmap_is_truecolor(struct BitMap *bm)
+{
+    return CyberGfxBase_bm &&
+           GetCyberMapAttr(bm, CYBRMATTR_ISCYBERGFX) &&
+           GetCyberMapAttr(bm, CYBRMATTR_DEPTH) > 8;
+}
+
+int bitmap_reader_init(struct BitmapReader *br, struct BitMap *bm,
+                       UBYTE depth, UWORD left, UWORD top, UWORD width)
+{
+    int p;
+
+    memset(br, 0, sizeof(*br));
+    br->left = left;
+    br->top = top;
+    br->width = width;
+
+    InitRastPort(&br->src_rp);
+    br->src_rp.BitMap = bm;
+
+    if (bitmap_is_truecolor(bm)) {
+        br->truecolor = 1;
+        return 0;
+    }
+
+    br->alloc_width = (width + 15) & ~15;
+    br->row = malloc(br->alloc_width);
+    if (!br->row) return -1;
+
+    InitBitMap(&br->tmp_bm, depth, br->alloc_width, 1);
+    memset(br->tmp_bm.Planes, 0, sizeof(br->tmp_bm.Planes));
+    for (p = 0; p < depth; p++) {
+        br->tmp_bm.Planes[p] = AllocRaster(br->alloc_width, 1);
+        if (!br->tmp_bm.Planes[p]) return -1;
+    }
+
+    InitRastPort(&br->tmp_rp);
+    br->tmp_rp.BitMap = &br->tmp_bm;
+    return 0;
+}
+
+const UBYTE *bitmap_reader_pens(struct BitmapReader *br, UWORD y)
+{
+    y += br->top;
+    ReadPixelArray8(&br->src_rp, br->left, y, br->left + br->width - 1, y,
+                    br->row, &br->tmp_rp);
+    return br->row;
+}
+
+int bitmap_reader_rgb(struct BitmapReader *br, UWORD y, UBYTE *rgb)
+{
+    ULONG n;
+
+    if (!br->truecolor) return -1;
+    n = ReadPixelArray(rgb, 0, 0, (UWORD)(br->width * 3), &br->src_rp,
+                       br->left, br->top + y, br->width, 1, RECTFMT_RGB);
+    return n ? 0 : -1;
+}
+
+void bitmap_reader_free(struct BitmapReader *br)
+{
+    int p;
+
+    for (p = 0; p < 8; p++) {
+        if (br->tmp_bm.Planes[p])
+            FreeRaster(br->tmp_bm.Planes[p], br->alloc_width, 1);
+        br->tmp_bm.Planes[p] = NULL;
+    }
+    free(br->row);
+    br->row = NULL;
+}
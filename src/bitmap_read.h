@@ -0,0 +1,45 @@
+#ifndef AMIGAAI_BITMAP_READ_H
+#define AMIGAAI_BITMAP_READ_H
+
+#include <exec/types.h>
+#include <graphics/gfx.h>
+#include <graphics/rastport.h>
+
+/* Open graphics.library V39, and cybergraphics.library if installed
+ * (for RTG bitmaps deeper than 8 bits). Called by the readers' users
+ * before anything else here. Returns 0, or -1 without graphics.library. */
+int bitmap_read_open(void);
+
+/* Close the libraries opened by bitmap_read_open(). */
+void bitmap_read_cleanup(void);
+
+/* Reads a region of a bitmap one row at a time: pens (one byte per
+ * pixel) with ReadPixelArray8() through a one-row temporary bitmap, or
+ * for truecolor RTG bitmaps RGB with cybergraphics ReadPixelArray(). */
+struct BitmapReader {
+    struct RastPort src_rp, tmp_rp;
+    struct BitMap   tmp_bm;
+    UWORD           left, top, width;
+    UWORD           alloc_width;    /* pen arrays are multiples of 16 */
+    UBYTE           truecolor;
+    UBYTE          *row;            /* alloc_width pens */
+};
+
+/* 1 if bm is an RTG bitmap deeper than 8 bits, which has no pens */
+int bitmap_is_truecolor(struct BitMap *bm);
+
+/* Set up reading width pixels from left, top down, of a bitmap of depth
+ * planes (ignored for truecolor bitmaps). Returns 0 or -1; free the
+ * reader either way. */
+int bitmap_reader_init(struct BitmapReader *br, struct BitMap *bm,
+                       UBYTE depth, UWORD left, UWORD top, UWORD width);
+
+/* Pens of row y of the region (width bytes, valid until the next call) */
+const UBYTE *bitmap_reader_pens(struct BitmapReader *br, UWORD y);
+
+/* Row y of a truecolor region as RGB (width * 3 bytes). Returns 0 or -1. */
+int bitmap_reader_rgb(struct BitmapReader *br, UWORD y, UBYTE *rgb);
+
+void bitmap_reader_free(struct BitmapReader *br);
+
+#endif /* AMIGAAI_BITMAP_READ_H */
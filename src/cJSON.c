@@ -69,6 +69,7 @@
 #endif
 #define false ((cJSON_bool)0)
 
+#ifndef CJSON_NO_FLOAT
 /* define isnan and isinf for ANSI C, if in C99 or above, isnan and isinf has been defined in math.h */
 #ifndef isinf
 #define isinf(d) (isnan((d - d)) && !isnan(d))
@@ -84,6 +85,91 @@
 #define NAN 0.0/0.0
 #endif
 #endif
+#endif /* CJSON_NO_FLOAT */
+
+/* Word-at-a-time string scanning (AmigaAI).
+ * Long string runs (base64 image data, text) need no escaping; test
+ * four bytes per step for a quote, backslash or control character and
+ * let the callers copy clean runs in bulk. Loads are aligned, so this
+ * is also safe on CPUs without unaligned access. */
+typedef unsigned int cjson_word;    /* 32 bits on all our targets */
+#if defined(__GNUC__)
+typedef unsigned int __attribute__((__may_alias__)) cjson_word_alias;
+#else
+typedef unsigned int cjson_word_alias;
+#endif
+
+#define WORD_ONES  0x01010101U
+#define WORD_HIGHS 0x80808080U
+/* non-zero if a byte of w is zero / is less than n (n <= 128) */
+#define WORD_HAS_ZERO(w)    (((w) - WORD_ONES) & ~(w) & WORD_HIGHS)
+#define WORD_HAS_LESS(w, n) (((w) - WORD_ONES * (n)) & ~(w) & WORD_HIGHS)
+
+#define IS_WORD_ALIGNED(p) ((((size_t)(p)) & (sizeof(cjson_word) - 1)) == 0)
+
+/* Length of the run at p with no '"' or '\\', up to end */
+static size_t skip_plain(const unsigned char *p, const unsigned char *end)
+{
+    const unsigned char *start = p;
+
+    while ((p < end) && !IS_WORD_ALIGNED(p) && (*p != '\"') && (*p != '\\'))
+    {
+        p++;
+    }
+    if ((p < end) && IS_WORD_ALIGNED(p))
+    {
+        while ((size_t)(end - p) >= sizeof(cjson_word))
+        {
+            cjson_word w = *(const cjson_word_alias *)p;
+            if (WORD_HAS_ZERO(w ^ (WORD_ONES * '\"')) | WORD_HAS_ZERO(w ^ (WORD_ONES * '\\')))
+            {
+                break;
+            }
+            p += sizeof(cjson_word);
+        }
+    }
+    while ((p < end) && (*p != '\"') && (*p != '\\'))
+    {
+        p++;
+    }
+
+    return (size_t)(p - start);
+}
+
+/* Length of the run at p (NUL-terminated) that needs no escaping.
+ * The last aligned word may extend past the NUL; it never crosses
+ * into another word, so it cannot leave the string's memory block. */
+#if defined(__SANITIZE_ADDRESS__)
+__attribute__((no_sanitize_address))
+#endif
+static size_t skip_clean(const unsigned char *p)
+{
+    const unsigned char *start = p;
+
+    while (!IS_WORD_ALIGNED(p))
+    {
+        if ((*p < 32) || (*p == '\"') || (*p == '\\'))
+        {
+            return (size_t)(p - start);
+        }
+        p++;
+    }
+    for (;;)
+    {
+        cjson_word w = *(const cjson_word_alias *)p;
+        if (WORD_HAS_LESS(w, 32) | WORD_HAS_ZERO(w ^ (WORD_ONES * '\"')) | WORD_HAS_ZERO(w ^ (WORD_ONES * '\\')))
+        {
+            break;
+        }
+        p += sizeof(cjson_word);
+    }
+    while ((*p > 31) && (*p != '\"') && (*p != '\\'))
+    {
+        p++;
+    }
+
+    return (size_t)(p - start);
+}
 
 typedef struct {
     const unsigned char *json;
@@ -98,7 +184,7 @@ CJSON_PUBLIC(const char *) cJSON_GetErrorPtr(void)
 
 CJSON_PUBLIC(char *) cJSON_GetStringValue(const cJSON * const item)
 {
-    if (!cJSON_IsString(item))
+    if (!cJSON_IsString(item) || cJSON_IsBlob(item))
     {
         return NULL;
     }
@@ -106,11 +192,15 @@ CJSON_PUBLIC(char *) cJSON_GetStringValue(const cJSON * const item)
     return item->valuestring;
 }
 
-CJSON_PUBLIC(double) cJSON_GetNumberValue(const cJSON * const item)
+CJSON_PUBLIC(cJSON_number) cJSON_GetNumberValue(const cJSON * const item)
 {
     if (!cJSON_IsNumber(item))
     {
+#ifdef CJSON_NO_FLOAT
+        return 0;
+#else
         return (double) NAN;
+#endif
     }
 
     return item->valuedouble;
@@ -270,12 +360,17 @@ CJSON_PUBLIC(void) cJSON_Delete(cJSON *item)
             global_hooks.deallocate(item->string);
             item->string = NULL;
         }
+        if (item->child_index != NULL)
+        {
+            global_hooks.deallocate(item->child_index);
+        }
         global_hooks.deallocate(item);
         item = next;
     }
 }
 
 /* get the decimal point character of the current locale */
+#ifndef CJSON_NO_FLOAT
 static unsigned char get_decimal_point(void)
 {
 #ifdef ENABLE_LOCALES
@@ -285,6 +380,7 @@ static unsigned char get_decimal_point(void)
     return '.';
 #endif
 }
+#endif
 
 typedef struct
 {
@@ -303,20 +399,184 @@ typedef struct
 /* get a pointer to the buffer at the position */
 #define buffer_at_offset(buffer) ((buffer)->content + (buffer)->offset)
 
+/* Set valueint from a number, saturating at the int range */
+static int saturate_int(cJSON_number number)
+{
+    if (number >= INT_MAX)
+    {
+        return INT_MAX;
+    }
+    if (number <= (cJSON_number)INT_MIN)
+    {
+        return INT_MIN;
+    }
+    return (int)number;
+}
+
+/* Integer fast path (AmigaAI): nearly every number in the API traffic
+ * is a small integer. Up to 9 digits always fit a 32-bit long, so they
+ * are converted without strtod() and its (soft-)float arithmetic.
+ * Returns the number of characters used, or 0 to take the general path. */
+static size_t parse_integer(const unsigned char *p, size_t available, long *value)
+{
+    size_t i = 0, digits = 0;
+    long n = 0;
+    int negative = 0;
+
+    if ((available > 0) && (p[0] == '-'))
+    {
+        negative = 1;
+        i++;
+    }
+    while ((i < available) && (p[i] >= '0') && (p[i] <= '9'))
+    {
+        if (++digits > 9)
+        {
+            return 0;
+        }
+        n = n * 10 + (p[i] - '0');
+        i++;
+    }
+    if ((digits == 0) ||
+        ((i < available) && ((p[i] == '.') || (p[i] == 'e') || (p[i] == 'E'))))
+    {
+        return 0;
+    }
+
+    *value = negative ? -n : n;
+    return i;
+}
+
+#ifdef CJSON_NO_FLOAT
+/* General integer parser for builds without floating point: numbers
+ * saturate at the long range and are truncated toward zero after the
+ * exponent is applied. Returns characters used, 0 on error. */
+static size_t parse_long(const unsigned char *p, size_t available, long *value)
+{
+    size_t i = 0;
+    unsigned long n = 0, limit;
+    int negative = 0, overflow = 0, digits = 0;
+    long scale = 0, exponent = 0;
+
+    if ((i < available) && ((p[i] == '-') || (p[i] == '+')))
+    {
+        negative = (p[i] == '-');
+        i++;
+    }
+    limit = negative ? (unsigned long)LONG_MAX + 1UL : (unsigned long)LONG_MAX;
+
+    /* mantissa, with fraction digits as long as they fit */
+    for (; (i < available) && (p[i] >= '0') && (p[i] <= '9'); i++, digits++)
+    {
+        unsigned long d = (unsigned long)(p[i] - '0');
+        if (overflow || (n > (limit - d) / 10))
+        {
+            overflow = 1;
+            continue;
+        }
+        n = n * 10 + d;
+    }
+    if ((i < available) && (p[i] == '.'))
+    {
+        for (i++; (i < available) && (p[i] >= '0') && (p[i] <= '9'); i++, digits++)
+        {
+            unsigned long d = (unsigned long)(p[i] - '0');
+            if (!overflow && (n <= (limit - d) / 10))
+            {
+                n = n * 10 + d;
+                scale--;
+            }
+        }
+    }
+    if (digits == 0)
+    {
+        return 0;
+    }
+    if ((i < available) && ((p[i] == 'e') || (p[i] == 'E')))
+    {
+        int exp_negative = 0;
+        i++;
+        if ((i < available) && ((p[i] == '-') || (p[i] == '+')))
+        {
+            exp_negative = (p[i] == '-');
+            i++;
+        }
+        for (; (i < available) && (p[i] >= '0') && (p[i] <= '9'); i++)
+        {
+            if (exponent < 1000)
+            {
+                exponent = exponent * 10 + (p[i] - '0');
+            }
+        }
+        if (exp_negative)
+        {
+            exponent = -exponent;
+        }
+    }
+
+    for (exponent += scale; (exponent > 0) && !overflow && (n != 0); exponent--)
+    {
+        if (n > limit / 10)
+        {
+            overflow = 1;
+        }
+        n *= 10;
+    }
+    for (; (exponent < 0) && (n != 0); exponent++)
+    {
+        n /= 10;
+    }
+    if (overflow || (n > limit))
+    {
+        n = limit;
+    }
+
+    *value = negative ? (long)(0UL - n) : (long)n;
+    return i;
+}
+#endif
+
 /* Parse the input text to generate a number, and populate the result into item. */
 static cJSON_bool parse_number(cJSON * const item, parse_buffer * const input_buffer)
 {
+#ifndef CJSON_NO_FLOAT
     double number = 0;
     unsigned char *after_end = NULL;
     unsigned char number_c_string[64];
     unsigned char decimal_point = get_decimal_point();
     size_t i = 0;
+#endif
+    long integer = 0;
+    size_t length = 0;
 
     if ((input_buffer == NULL) || (input_buffer->content == NULL))
     {
         return false;
     }
 
+    length = parse_integer(buffer_at_offset(input_buffer),
+                           input_buffer->length - input_buffer->offset, &integer);
+#ifdef CJSON_NO_FLOAT
+    if (length == 0)
+    {
+        length = parse_long(buffer_at_offset(input_buffer),
+                            input_buffer->length - input_buffer->offset, &integer);
+        if (length == 0)
+        {
+            return false; /* parse_error */
+        }
+    }
+#endif
+    if (length > 0)
+    {
+        item->valuedouble = integer;
+        item->valueint = saturate_int(integer);
+        item->type = cJSON_Number;
+        input_buffer->offset += length;
+        return true;
+    }
+
+#ifndef CJSON_NO_FLOAT
     /* copy the number into a temporary buffer and replace '.' with the decimal point
      * of the current locale (for strtod)
      * This also takes care of '\0' not necessarily being available for marking the end of the input */
@@ -361,40 +621,21 @@ loop_end:
     item->valuedouble = number;
 
     /* use saturation in case of overflow */
-    if (number >= INT_MAX)
-    {
-        item->valueint = INT_MAX;
-    }
-    else if (number <= (double)INT_MIN)
-    {
-        item->valueint = INT_MIN;
-    }
-    else
-    {
-        item->valueint = (int)number;
-    }
+    item->valueint = saturate_int(number);
 
     item->type = cJSON_Number;
 
     input_buffer->offset += (size_t)(after_end - number_c_string);
     return true;
+#else
+    return false;
+#endif
 }
 
 /* don't ask me, but the original cJSON_SetNumberValue returns an integer or double */
-CJSON_PUBLIC(double) cJSON_SetNumberHelper(cJSON *object, double number)
+CJSON_PUBLIC(cJSON_number) cJSON_SetNumberHelper(cJSON *object, cJSON_number number)
 {
-    if (number >= INT_MAX)
-    {
-        object->valueint = INT_MAX;
-    }
-    else if (number <= (double)INT_MIN)
-    {
-        object->valueint = INT_MIN;
-    }
-    else
-    {
-        object->valueint = (int)number;
-    }
+    object->valueint = saturate_int(number);
 
     return object->valuedouble = number;
 }
@@ -404,7 +645,7 @@ CJSON_PUBLIC(char*) cJSON_SetValuestring(cJSON *object, const char *valuestring)
 {
     char *copy = NULL;
     /* if object's type is not cJSON_String or is cJSON_IsReference, it should not set valuestring */
-    if ((object == NULL) || !(object->type & cJSON_String) || (object->type & cJSON_IsReference))
+    if ((object == NULL) || !(object->type & cJSON_String) || (object->type & (cJSON_IsReference | cJSON_StringIsBlob)))
     {
         return NULL;
     }
@@ -542,38 +783,75 @@ static void update_offset(printbuffer * const buffer)
     buffer->offset += strlen((const char*)buffer_pointer);
 }
 
+#ifndef CJSON_NO_FLOAT
 /* securely comparison of floating-point variables */
 static cJSON_bool compare_double(double a, double b)
 {
     double maxVal = fabs(a) > fabs(b) ? fabs(a) : fabs(b);
     return (fabs(a - b) <= maxVal * DBL_EPSILON);
 }
+#endif
+
+/* Format a long in decimal without sprintf() (AmigaAI).
+ * buffer must hold at least 21 characters. Returns the length. */
+static int print_long(long value, unsigned char *buffer)
+{
+    unsigned char digits[20];
+    unsigned long n = (value < 0) ? 0UL - (unsigned long)value : (unsigned long)value;
+    int count = 0, length = 0;
+
+    do
+    {
+        digits[count++] = (unsigned char)('0' + (n % 10));
+        n /= 10;
+    } while (n != 0);
+
+    if (value < 0)
+    {
+        buffer[length++] = '-';
+    }
+    while (count > 0)
+    {
+        buffer[length++] = digits[--count];
+    }
+    buffer[length] = '\0';
+
+    return length;
+}
 
 /* Render the number nicely from the given item into a string. */
 static cJSON_bool print_number(const cJSON * const item, printbuffer * const output_buffer)
 {
     unsigned char *output_pointer = NULL;
-    double d = item->valuedouble;
     int length = 0;
     size_t i = 0;
     unsigned char number_buffer[26] = {0}; /* temporary buffer to print the number into */
+#ifdef CJSON_NO_FLOAT
+    unsigned char decimal_point = '.';
+#else
+    double d = item->valuedouble;
     unsigned char decimal_point = get_decimal_point();
     double test = 0.0;
+#endif
 
     if (output_buffer == NULL)
     {
         return false;
     }
 
+#ifdef CJSON_NO_FLOAT
+    length = print_long(item->valuedouble, number_buffer);
+#else
+    /* Integers (nearly all numbers) first: no float formatting needed */
+    if (d == (double)item->valueint)
+    {
+        length = print_long(item->valueint, number_buffer);
+    }
     /* This checks for NaN and Infinity */
-    if (isnan(d) || isinf(d))
+    else if (isnan(d) || isinf(d))
     {
         length = sprintf((char*)number_buffer, "null");
     }
-	else if(d == (double)item->valueint)
-	{
-		length = sprintf((char*)number_buffer, "%d", item->valueint);
-	}
     else
     {
         /* Try 15 decimal places of precision to avoid nonsignificant nonzero digits */
@@ -586,6 +864,7 @@ static cJSON_bool print_number(const cJSON * const item, printbuffer * const out
             length = sprintf((char*)number_buffer, "%1.17g", d);
         }
     }
+#endif
 
     /* sprintf failed or buffer overrun occurred */
     if ((length < 0) || (length > (int)(sizeof(number_buffer) - 1)))
@@ -795,8 +1074,16 @@ static cJSON_bool parse_string(cJSON * const item, parse_buffer * const input_bu
         /* calculate approximate size of the output (overestimate) */
         size_t allocation_length = 0;
         size_t skipped_bytes = 0;
+        const unsigned char *content_end = input_buffer->content + input_buffer->length;
         while (((size_t)(input_end - input_buffer->content) < input_buffer->length) && (*input_end != '\"'))
         {
+            /* skip a plain run word-wise */
+            input_end += skip_plain(input_end, content_end);
+            if (((size_t)(input_end - input_buffer->content) >= input_buffer->length) || (*input_end == '\"'))
+            {
+                break;
+            }
+
             /* is escape sequence */
             if (input_end[0] == '\\')
             {
@@ -830,7 +1117,15 @@ static cJSON_bool parse_string(cJSON * const item, parse_buffer * const input_bu
     {
         if (*input_pointer != '\\')
         {
-            *output_pointer++ = *input_pointer++;
+            /* copy the run up to the next escape in one go */
+            size_t run = skip_plain(input_pointer, input_end);
+            if (run == 0)
+            {
+                run = 1; /* a quote inside the literal cannot happen */
+            }
+            memcpy(output_pointer, input_pointer, run);
+            output_pointer += run;
+            input_pointer += run;
         }
         /* escape sequence */
         else
@@ -936,7 +1231,7 @@ static cJSON_bool print_string_ptr(const unsigned char * const input, printbuffe
     }
 
     /* set "flag" to 1 if something needs to be escaped */
-    for (input_pointer = input; *input_pointer; input_pointer++)
+    for (input_pointer = input + skip_clean(input); *input_pointer; input_pointer += 1 + skip_clean(input_pointer + 1))
     {
         switch (*input_pointer)
         {
@@ -985,8 +1280,11 @@ static cJSON_bool print_string_ptr(const unsigned char * const input, printbuffe
     {
         if ((*input_pointer > 31) && (*input_pointer != '\"') && (*input_pointer != '\\'))
         {
-            /* normal character, copy */
-            *output_pointer = *input_pointer;
+            /* normal characters, copy the whole run */
+            size_t run = skip_clean(input_pointer);
+            memcpy(output_pointer, input_pointer, run);
+            output_pointer += run - 1;
+            input_pointer += run - 1;
         }
         else
         {
@@ -1029,9 +1327,49 @@ static cJSON_bool print_string_ptr(const unsigned char * const input, printbuffe
     return true;
 }
 
+/* AmigaAI: print binary data as a base64 string (see cJSON_CreateBlobOwned) */
+static cJSON_bool print_blob(const unsigned char *data, size_t length, printbuffer * const output_buffer)
+{
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    unsigned char *output = NULL;
+    size_t i = 0;
+
+    output = ensure(output_buffer, (length + 2) / 3 * 4 + sizeof("\"\""));
+    if (output == NULL)
+    {
+        return false;
+    }
+
+    *output++ = '\"';
+    for (i = 0; i + 2 < length; i += 3)
+    {
+        *output++ = (unsigned char)table[data[i] >> 2];
+        *output++ = (unsigned char)table[((data[i] & 0x03) << 4) | (data[i + 1] >> 4)];
+        *output++ = (unsigned char)table[((data[i + 1] & 0x0F) << 2) | (data[i + 2] >> 6)];
+        *output++ = (unsigned char)table[data[i + 2] & 0x3F];
+    }
+    if (i < length)
+    {
+        unsigned int rest = (i + 1 < length) ? data[i + 1] : 0;
+        *output++ = (unsigned char)table[data[i] >> 2];
+        *output++ = (unsigned char)table[((data[i] & 0x03) << 4) | (rest >> 4)];
+        *output++ = (unsigned char)((i + 1 < length) ? table[(rest & 0x0F) << 2] : '=');
+        *output++ = '=';
+    }
+    *output++ = '\"';
+    *output = '\0';
+
+    return true;
+}
+
 /* Invoke print_string_ptr (which is useful) on an item. */
 static cJSON_bool print_string(const cJSON * const item, printbuffer * const p)
 {
+    if (item->type & cJSON_StringIsBlob)
+    {
+        return print_blob((const unsigned char*)item->valuestring, (size_t)item->valueint, p);
+    }
+
     return print_string_ptr((unsigned char*)item->valuestring, p);
 }
 
@@ -1455,6 +1793,7 @@ static cJSON_bool parse_array(cJSON * const item, parse_buffer * const input_buf
 {
     cJSON *head = NULL; /* head of the linked list */
     cJSON *current_item = NULL;
+    int count = 0;
 
     if (input_buffer->depth >= CJSON_NESTING_LIMIT)
     {
@@ -1494,6 +1833,7 @@ static cJSON_bool parse_array(cJSON * const item, parse_buffer * const input_buf
         {
             goto fail; /* allocation failure */
         }
+        count++;
 
         /* attach next item to list */
         if (head == NULL)
@@ -1534,6 +1874,7 @@ success:
 
     item->type = cJSON_Array;
     item->child = head;
+    item->child_count = count;
 
     input_buffer->offset++;
 
@@ -1615,6 +1956,7 @@ static cJSON_bool parse_object(cJSON * const item, parse_buffer * const input_bu
 {
     cJSON *head = NULL; /* linked list head */
     cJSON *current_item = NULL;
+    int count = 0;
 
     if (input_buffer->depth >= CJSON_NESTING_LIMIT)
     {
@@ -1652,6 +1994,7 @@ static cJSON_bool parse_object(cJSON * const item, parse_buffer * const input_bu
         {
             goto fail; /* allocation failure */
         }
+        count++;
 
         /* attach next item to list */
         if (head == NULL)
@@ -1715,6 +2058,7 @@ success:
 
     item->type = cJSON_Object;
     item->child = head;
+    item->child_count = count;
 
     input_buffer->offset++;
     return true;
@@ -1842,39 +2186,83 @@ static cJSON_bool print_object(const cJSON * const item, printbuffer * const out
     return true;
 }
 
-/* Get Array size/item / object item. */
-CJSON_PUBLIC(int) cJSON_GetArraySize(const cJSON *array)
+/* AmigaAI: arrays and objects keep their element count up to date, so
+ * cJSON_GetArraySize() is O(1). Random access into a list of at least
+ * CJSON_INDEX_MIN items builds a vector of child pointers on first use;
+ * appends extend it, any other change to the list drops it. */
+#define CJSON_INDEX_MIN 8
+
+struct cJSON_Index
 {
-    cJSON *child = NULL;
-    size_t size = 0;
+    size_t capacity;
+    cJSON *item[1];
+};
 
-    if (array == NULL)
+static void* cast_away_const(const void* string);
+
+static void drop_index(cJSON *array)
+{
+    if (array->child_index != NULL)
     {
-        return 0;
+        global_hooks.deallocate(array->child_index);
+        array->child_index = NULL;
     }
+}
 
-    child = array->child;
+static cJSON_bool build_index(cJSON *array)
+{
+    size_t capacity = (size_t)array->child_count + (size_t)array->child_count / 2;
+    struct cJSON_Index *index = NULL;
+    cJSON *child = NULL;
+    size_t i = 0;
 
-    while(child != NULL)
+    index = (struct cJSON_Index*)global_hooks.allocate(sizeof(struct cJSON_Index) + (capacity - 1) * sizeof(cJSON*));
+    if (index == NULL)
     {
-        size++;
-        child = child->next;
+        return false;
     }
+    index->capacity = capacity;
+    for (child = array->child; child != NULL; child = child->next)
+    {
+        index->item[i++] = child;
+    }
+    array->child_index = index;
+
+    return true;
+}
 
-    /* FIXME: Can overflow here. Cannot be fixed without breaking the API */
+/* Get Array size/item / object item. */
+CJSON_PUBLIC(int) cJSON_GetArraySize(const cJSON *array)
+{
+    if (array == NULL)
+    {
+        return 0;
+    }
 
-    return (int)size;
+    return array->child_count;
 }
 
 static cJSON* get_array_item(const cJSON *array, size_t index)
 {
     cJSON *current_child = NULL;
 
-    if (array == NULL)
+    if ((array == NULL) || (index >= (size_t)array->child_count))
     {
         return NULL;
     }
 
+    /* the last item is always at hand through child->prev */
+    if (index == (size_t)array->child_count - 1)
+    {
+        return array->child->prev;
+    }
+
+    if ((array->child_index != NULL) ||
+        ((array->child_count >= CJSON_INDEX_MIN) && build_index((cJSON*)cast_away_const(array))))
+    {
+        return array->child_index->item[index];
+    }
+
     current_child = array->child;
     while ((current_child != NULL) && (index > 0))
     {
@@ -1966,6 +2354,7 @@ static cJSON *create_reference(const cJSON *item, const internal_hooks * const h
 
     memcpy(reference, item, sizeof(cJSON));
     reference->string = NULL;
+    reference->child_index = NULL;
     reference->type |= cJSON_IsReference;
     reference->next = reference->prev = NULL;
     return reference;
@@ -2001,6 +2390,19 @@ static cJSON_bool add_item_to_array(cJSON *array, cJSON *item)
         }
     }
 
+    array->child_count++;
+    if (array->child_index != NULL)
+    {
+        if ((size_t)array->child_count <= array->child_index->capacity)
+        {
+            array->child_index->item[array->child_count - 1] = item;
+        }
+        else
+        {
+            drop_index(array);
+        }
+    }
+
     return true;
 }
 
@@ -2142,7 +2544,7 @@ CJSON_PUBLIC(cJSON*) cJSON_AddBoolToObject(cJSON * const object, const char * co
     return NULL;
 }
 
-CJSON_PUBLIC(cJSON*) cJSON_AddNumberToObject(cJSON * const object, const char * const name, const double number)
+CJSON_PUBLIC(cJSON*) cJSON_AddNumberToObject(cJSON * const object, const char * const name, const cJSON_number number)
 {
     cJSON *number_item = cJSON_CreateNumber(number);
     if (add_item_to_object(object, name, number_item, &global_hooks, false))
@@ -2209,6 +2611,13 @@ CJSON_PUBLIC(cJSON *) cJSON_DetachItemViaPointer(cJSON *parent, cJSON * const it
         return NULL;
     }
 
+    /* removing the last item leaves the index valid */
+    if (item->next != NULL)
+    {
+        drop_index(parent);
+    }
+    parent->child_count--;
+
     if (item != parent->child)
     {
         /* not the first element */
@@ -2298,6 +2707,9 @@ CJSON_PUBLIC(cJSON_bool) cJSON_InsertItemInArray(cJSON *array, int which, cJSON
         return false;
     }
 
+    drop_index(array);
+    array->child_count++;
+
     newitem->next = after_inserted;
     newitem->prev = after_inserted->prev;
     after_inserted->prev = newitem;
@@ -2324,6 +2736,8 @@ CJSON_PUBLIC(cJSON_bool) cJSON_ReplaceItemViaPointer(cJSON * const parent, cJSON
         return true;
     }
 
+    drop_index(parent);
+
     replacement->next = item->next;
     replacement->prev = item->prev;
 
@@ -2449,7 +2863,7 @@ CJSON_PUBLIC(cJSON *) cJSON_CreateBool(cJSON_bool boolean)
     return item;
 }
 
-CJSON_PUBLIC(cJSON *) cJSON_CreateNumber(double num)
+CJSON_PUBLIC(cJSON *) cJSON_CreateNumber(cJSON_number num)
 {
     cJSON *item = cJSON_New_Item(&global_hooks);
     if(item)
@@ -2458,18 +2872,7 @@ CJSON_PUBLIC(cJSON *) cJSON_CreateNumber(double num)
         item->valuedouble = num;
 
         /* use saturation in case of overflow */
-        if (num >= INT_MAX)
-        {
-            item->valueint = INT_MAX;
-        }
-        else if (num <= (double)INT_MIN)
-        {
-            item->valueint = INT_MIN;
-        }
-        else
-        {
-            item->valueint = (int)num;
-        }
+        item->valueint = saturate_int(num);
     }
 
     return item;
@@ -2504,12 +2907,49 @@ CJSON_PUBLIC(cJSON *) cJSON_CreateStringReference(const char *string)
     return item;
 }
 
+/* AmigaAI: take over a string instead of copying it. Multi-megabyte
+ * base64 image data goes into the tree without a second allocation. */
+CJSON_PUBLIC(cJSON *) cJSON_CreateStringOwned(char *string)
+{
+    cJSON *item;
+
+    if (string == NULL)
+    {
+        return NULL;
+    }
+
+    item = cJSON_New_Item(&global_hooks);
+    if (item == NULL)
+    {
+        global_hooks.deallocate(string);
+        return NULL;
+    }
+    item->type = cJSON_String;
+    item->valuestring = string;
+
+    return item;
+}
+
+/* AmigaAI: element count of a borrowed list */
+static int count_items(const cJSON *child)
+{
+    int count = 0;
+
+    for (; child != NULL; child = child->next)
+    {
+        count++;
+    }
+
+    return count;
+}
+
 CJSON_PUBLIC(cJSON *) cJSON_CreateObjectReference(const cJSON *child)
 {
     cJSON *item = cJSON_New_Item(&global_hooks);
     if (item != NULL) {
         item->type = cJSON_Object | cJSON_IsReference;
         item->child = (cJSON*)cast_away_const(child);
+        item->child_count = count_items(child);
     }
 
     return item;
@@ -2520,6 +2960,7 @@ CJSON_PUBLIC(cJSON *) cJSON_CreateArrayReference(const cJSON *child) {
     if (item != NULL) {
         item->type = cJSON_Array | cJSON_IsReference;
         item->child = (cJSON*)cast_away_const(child);
+        item->child_count = count_items(child);
     }
 
     return item;
@@ -2542,6 +2983,46 @@ CJSON_PUBLIC(cJSON *) cJSON_CreateRaw(const char *raw)
     return item;
 }
 
+/* AmigaAI: binary data that serializes as base64. Images stay in the
+ * conversation as raw bytes, a quarter smaller than their text form. */
+CJSON_PUBLIC(cJSON *) cJSON_CreateBlobOwned(unsigned char *data, size_t length)
+{
+    cJSON *item = NULL;
+
+    if (data == NULL)
+    {
+        return NULL;
+    }
+
+    if (length <= (size_t)INT_MAX)
+    {
+        item = cJSON_New_Item(&global_hooks);
+    }
+    if (item == NULL)
+    {
+        global_hooks.deallocate(data);
+        return NULL;
+    }
+    item->type = cJSON_String | cJSON_StringIsBlob;
+    item->valuestring = (char*)data;
+    item->valueint = (int)length;
+
+    return item;
+}
+
+/* AmigaAI: splice pre-serialized JSON without copying it */
+CJSON_PUBLIC(cJSON *) cJSON_CreateRawReference(const char *raw)
+{
+    cJSON *item = cJSON_New_Item(&global_hooks);
+    if (item != NULL)
+    {
+        item->type = cJSON_Raw | cJSON_IsReference;
+        item->valuestring = (char*)cast_away_const(raw);
+    }
+
+    return item;
+}
+
 CJSON_PUBLIC(cJSON *) cJSON_CreateArray(void)
 {
     cJSON *item = cJSON_New_Item(&global_hooks);
@@ -2600,11 +3081,13 @@ CJSON_PUBLIC(cJSON *) cJSON_CreateIntArray(const int *numbers, int count)
 
     if (a && a->child) {
         a->child->prev = n;
+        a->child_count = count;
     }
 
     return a;
 }
 
+#ifndef CJSON_NO_FLOAT
 CJSON_PUBLIC(cJSON *) cJSON_CreateFloatArray(const float *numbers, int count)
 {
     size_t i = 0;
@@ -2640,6 +3123,7 @@ CJSON_PUBLIC(cJSON *) cJSON_CreateFloatArray(const float *numbers, int count)
 
     if (a && a->child) {
         a->child->prev = n;
+        a->child_count = count;
     }
 
     return a;
@@ -2680,10 +3164,12 @@ CJSON_PUBLIC(cJSON *) cJSON_CreateDoubleArray(const double *numbers, int count)
 
     if (a && a->child) {
         a->child->prev = n;
+        a->child_count = count;
     }
 
     return a;
 }
+#endif
 
 CJSON_PUBLIC(cJSON *) cJSON_CreateStringArray(const char *const *strings, int count)
 {
@@ -2720,6 +3206,7 @@ CJSON_PUBLIC(cJSON *) cJSON_CreateStringArray(const char *const *strings, int co
 
     if (a && a->child) {
         a->child->prev = n;
+        a->child_count = count;
     }
 
     return a;
@@ -2748,7 +3235,16 @@ CJSON_PUBLIC(cJSON *) cJSON_Duplicate(const cJSON *item, cJSON_bool recurse)
     newitem->type = item->type & (~cJSON_IsReference);
     newitem->valueint = item->valueint;
     newitem->valuedouble = item->valuedouble;
-    if (item->valuestring)
+    if (item->valuestring && (item->type & cJSON_StringIsBlob))
+    {
+        newitem->valuestring = (char*)global_hooks.allocate((size_t)item->valueint + 1);
+        if (!newitem->valuestring)
+        {
+            goto fail;
+        }
+        memcpy(newitem->valuestring, item->valuestring, (size_t)item->valueint);
+    }
+    else if (item->valuestring)
     {
         newitem->valuestring = (char*)cJSON_strdup((unsigned char*)item->valuestring, &global_hooks);
         if (!newitem->valuestring)
@@ -2778,6 +3274,7 @@ CJSON_PUBLIC(cJSON *) cJSON_Duplicate(const cJSON *item, cJSON_bool recurse)
         {
             goto fail;
         }
+        newitem->child_count++;
         if (next != NULL)
         {
             /* If newitem->child already set, then crosswire ->prev and ->next and move on */
@@ -2996,6 +3493,16 @@ CJSON_PUBLIC(cJSON_bool) cJSON_IsObject(const cJSON * const item)
     return (item->type & 0xFF) == cJSON_Object;
 }
 
+CJSON_PUBLIC(cJSON_bool) cJSON_IsBlob(const cJSON * const item)
+{
+    if (item == NULL)
+    {
+        return false;
+    }
+
+    return (item->type & (cJSON_String | cJSON_StringIsBlob)) == (cJSON_String | cJSON_StringIsBlob);
+}
+
 CJSON_PUBLIC(cJSON_bool) cJSON_IsRaw(const cJSON * const item)
 {
     if (item == NULL)
@@ -3045,7 +3552,11 @@ CJSON_PUBLIC(cJSON_bool) cJSON_Compare(const cJSON * const a, const cJSON * cons
             return true;
 
         case cJSON_Number:
+#ifdef CJSON_NO_FLOAT
+            if (a->valuedouble == b->valuedouble)
+#else
             if (compare_double(a->valuedouble, b->valuedouble))
+#endif
             {
                 return true;
             }
@@ -3057,6 +3568,13 @@ CJSON_PUBLIC(cJSON_bool) cJSON_Compare(const cJSON * const a, const cJSON * cons
             {
                 return false;
             }
+            if ((a->type & cJSON_StringIsBlob) || (b->type & cJSON_StringIsBlob))
+            {
+                /* blobs only equal blobs with the same bytes */
+                return ((a->type & b->type & cJSON_StringIsBlob) &&
+                        (a->valueint == b->valueint) &&
+                        (memcmp(a->valuestring, b->valuestring, (size_t)a->valueint) == 0));
+            }
             if (strcmp(a->valuestring, b->valuestring) == 0)
             {
                 return true;
@@ -98,6 +98,18 @@ then using the CJSON_API_VISIBILITY flag to "export" the same symbols the way CJ
 
 #define cJSON_IsReference 256
 #define cJSON_StringIsConst 512
+/* AmigaAI: a cJSON_String whose valuestring holds valueint bytes of
+ * binary data instead of text; it is printed as their base64 encoding */
+#define cJSON_StringIsBlob 1024
+
+/* AmigaAI: define CJSON_NO_FLOAT to build cJSON without floating point
+ * (for 68020/030 systems without an FPU). Numbers are then longs:
+ * fractions are truncated and values saturate at the long range. */
+#ifdef CJSON_NO_FLOAT
+typedef long cJSON_number;
+#else
+typedef double cJSON_number;
+#endif
 
 /* The cJSON structure: */
 typedef struct cJSON
@@ -116,10 +128,17 @@ typedef struct cJSON
     /* writing to valueint is DEPRECATED, use cJSON_SetNumberValue instead */
     int valueint;
     /* The item's number, if type==cJSON_Number */
-    double valuedouble;
+    cJSON_number valuedouble;
 
     /* The item's name string, if this item is the child of, or is in the list of subitems of an object. */
     char *string;
+
+    /* AmigaAI: arrays and objects only. Number of items in the child
+     * chain, and a lookup vector for cJSON_GetArrayItem() that is built
+     * on demand. Both are maintained by the cJSON functions: lists must
+     * not be relinked by hand. */
+    int child_count;
+    struct cJSON_Index *child_index;
 } cJSON;
 
 typedef struct cJSON_Hooks
@@ -177,7 +196,7 @@ CJSON_PUBLIC(const char *) cJSON_GetErrorPtr(void);
 
 /* Check item type and return its value */
 CJSON_PUBLIC(char *) cJSON_GetStringValue(const cJSON * const item);
-CJSON_PUBLIC(double) cJSON_GetNumberValue(const cJSON * const item);
+CJSON_PUBLIC(cJSON_number) cJSON_GetNumberValue(const cJSON * const item);
 
 /* These functions check the type of an item */
 CJSON_PUBLIC(cJSON_bool) cJSON_IsInvalid(const cJSON * const item);
@@ -190,13 +209,15 @@ CJSON_PUBLIC(cJSON_bool) cJSON_IsString(const cJSON * const item);
 CJSON_PUBLIC(cJSON_bool) cJSON_IsArray(const cJSON * const item);
 CJSON_PUBLIC(cJSON_bool) cJSON_IsObject(const cJSON * const item);
 CJSON_PUBLIC(cJSON_bool) cJSON_IsRaw(const cJSON * const item);
+/* AmigaAI: binary string, see cJSON_CreateBlobOwned */
+CJSON_PUBLIC(cJSON_bool) cJSON_IsBlob(const cJSON * const item);
 
 /* These calls create a cJSON item of the appropriate type. */
 CJSON_PUBLIC(cJSON *) cJSON_CreateNull(void);
 CJSON_PUBLIC(cJSON *) cJSON_CreateTrue(void);
 CJSON_PUBLIC(cJSON *) cJSON_CreateFalse(void);
 CJSON_PUBLIC(cJSON *) cJSON_CreateBool(cJSON_bool boolean);
-CJSON_PUBLIC(cJSON *) cJSON_CreateNumber(double num);
+CJSON_PUBLIC(cJSON *) cJSON_CreateNumber(cJSON_number num);
 CJSON_PUBLIC(cJSON *) cJSON_CreateString(const char *string);
 /* raw json */
 CJSON_PUBLIC(cJSON *) cJSON_CreateRaw(const char *raw);
@@ -206,6 +227,19 @@ CJSON_PUBLIC(cJSON *) cJSON_CreateObject(void);
 /* Create a string where valuestring references a string so
  * it will not be freed by cJSON_Delete */
 CJSON_PUBLIC(cJSON *) cJSON_CreateStringReference(const char *string);
+/* AmigaAI: create a string that takes ownership of string instead of
+ * copying it. string must come from the allocator cJSON frees with
+ * (malloc() unless cJSON_InitHooks() installed another one); it is
+ * freed by cJSON_Delete, or right away if the item cannot be created. */
+CJSON_PUBLIC(cJSON *) cJSON_CreateStringOwned(char *string);
+/* AmigaAI: create a string item that holds length bytes of binary data
+ * and is printed as their base64 encoding. Takes ownership of data like
+ * cJSON_CreateStringOwned (data is freed if the item cannot be created).
+ * cJSON_GetStringValue returns NULL for it. */
+CJSON_PUBLIC(cJSON *) cJSON_CreateBlobOwned(unsigned char *data, size_t length);
+/* AmigaAI: raw json that references raw instead of copying it, so it
+ * will not be freed by cJSON_Delete */
+CJSON_PUBLIC(cJSON *) cJSON_CreateRawReference(const char *raw);
 /* Create an object/array that only references it's elements so
  * they will not be freed by cJSON_Delete */
 CJSON_PUBLIC(cJSON *) cJSON_CreateObjectReference(const cJSON *child);
@@ -214,8 +248,10 @@ CJSON_PUBLIC(cJSON *) cJSON_CreateArrayReference(const cJSON *child);
 /* These utilities create an Array of count items.
  * The parameter count cannot be greater than the number of elements in the number array, otherwise array access will be out of bounds.*/
 CJSON_PUBLIC(cJSON *) cJSON_CreateIntArray(const int *numbers, int count);
+#ifndef CJSON_NO_FLOAT
 CJSON_PUBLIC(cJSON *) cJSON_CreateFloatArray(const float *numbers, int count);
 CJSON_PUBLIC(cJSON *) cJSON_CreateDoubleArray(const double *numbers, int count);
+#endif
 CJSON_PUBLIC(cJSON *) cJSON_CreateStringArray(const char *const *strings, int count);
 
 /* Append item to the specified array/object. */
@@ -265,7 +301,7 @@ CJSON_PUBLIC(cJSON*) cJSON_AddNullToObject(cJSON * const object, const char * co
 CJSON_PUBLIC(cJSON*) cJSON_AddTrueToObject(cJSON * const object, const char * const name);
 CJSON_PUBLIC(cJSON*) cJSON_AddFalseToObject(cJSON * const object, const char * const name);
 CJSON_PUBLIC(cJSON*) cJSON_AddBoolToObject(cJSON * const object, const char * const name, const cJSON_bool boolean);
-CJSON_PUBLIC(cJSON*) cJSON_AddNumberToObject(cJSON * const object, const char * const name, const double number);
+CJSON_PUBLIC(cJSON*) cJSON_AddNumberToObject(cJSON * const object, const char * const name, const cJSON_number number);
 CJSON_PUBLIC(cJSON*) cJSON_AddStringToObject(cJSON * const object, const char * const name, const char * const string);
 CJSON_PUBLIC(cJSON*) cJSON_AddRawToObject(cJSON * const object, const char * const name, const char * const raw);
 CJSON_PUBLIC(cJSON*) cJSON_AddObjectToObject(cJSON * const object, const char * const name);
@@ -274,8 +310,8 @@ CJSON_PUBLIC(cJSON*) cJSON_AddArrayToObject(cJSON * const object, const char * c
 /* When assigning an integer value, it needs to be propagated to valuedouble too. */
 #define cJSON_SetIntValue(object, number) ((object) ? (object)->valueint = (object)->valuedouble = (number) : (number))
 /* helper for the cJSON_SetNumberValue macro */
-CJSON_PUBLIC(double) cJSON_SetNumberHelper(cJSON *object, double number);
-#define cJSON_SetNumberValue(object, number) ((object != NULL) ? cJSON_SetNumberHelper(object, (double)number) : (number))
+CJSON_PUBLIC(cJSON_number) cJSON_SetNumberHelper(cJSON *object, cJSON_number number);
+#define cJSON_SetNumberValue(object, number) ((object != NULL) ? cJSON_SetNumberHelper(object, (cJSON_number)number) : (number))
 /* Change the valuestring of a cJSON_String object, only takes effect when type of object is cJSON_String */
 CJSON_PUBLIC(char*) cJSON_SetValuestring(cJSON *object, const char *valuestring);
 
@@ -0,0 +1,226 @@
+/*
+ * cache.c - On-disk response cache for AmigaAI
+ *
+ * Stores raw Messages API response bodies in AmigaAI:cache/, one file
+ * per request, named after a 64-bit hash of the request JSON. The first
+ * line of each file holds the request length and a second hash, checked
+ * on lookup, so a key collision is a miss rather than the wrong answer.
+ * Repeated
+ * identical requests (typically from ARexx scripts) are answered from
+ * disk without a network round trip. File dates track last use; when
+ * the directory grows past the configured size, the oldest entries are
+ * deleted first.
+ */
+
+#include "cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <proto/dos.h>
+#include <proto/exec.h>
+
+struct CacheEntry {
+    char            name[CACHE_KEY_LEN];
+    long            size;
+    struct DateStamp date;
+};
+
+void cache_key_init(struct CacheKeyState *st)
+{
+    st->fnv = 2166136261UL;   /* FNV-1a */
+    st->djb = 5381;           /* djb2 (xor variant) */
+    st->sdbm = 0;             /* sdbm, for the check */
+    st->len = 0;
+}
+
+void cache_key_update(struct CacheKeyState *st, const char *data, long len)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    unsigned long fnv = st->fnv, djb = st->djb, sdbm = st->sdbm;
+    long i;
+
+    for (i = 0; i < len; i++) {
+        fnv = ((fnv ^ p[i]) * 16777619UL) & 0xFFFFFFFFUL;
+        djb = ((djb << 5) + djb) ^ p[i];
+        djb &= 0xFFFFFFFFUL;
+        sdbm = (p[i] + (sdbm << 6) + (sdbm << 16) - sdbm) & 0xFFFFFFFFUL;
+    }
+
+    st->fnv = fnv;
+    st->djb = djb;
+    st->sdbm = sdbm;
+    st->len += (unsigned long)len;
+}
+
+void cache_key_final(const struct CacheKeyState *st, char *key, char *check)
+{
+    snprintf(key, CACHE_KEY_LEN, "%08lx%08lx", st->fnv, st->djb);
+    snprintf(check, CACHE_CHECK_LEN, "%08lx%08lx",
+             st->len & 0xFFFFFFFFUL, st->sdbm);
+}
+
+void cache_key(const char *request, long len, char *key, char *check)
+{
+    struct CacheKeyState st;
+
+    cache_key_init(&st);
+    cache_key_update(&st, request, len);
+    cache_key_final(&st, key, check);
+}
+
+static void cache_path(const char *key, char *path, int size)
+{
+    snprintf(path, size, "%s/%s", CACHE_DIR, key);
+}
+
+char *cache_get(const char *key, const char *check)
+{
+    char path[64], line[CACHE_CHECK_LEN + 1];
+    struct DateStamp now;
+    FILE *f;
+    long len;
+    char *body;
+
+    cache_path(key, path, sizeof(path));
+
+    f = fopen(path, "rb");
+    if (!f) return NULL;
+
+    /* A different request with the same key (or an entry from before
+     * checks were stored) */
+    if (fread(line, 1, CACHE_CHECK_LEN, f) != CACHE_CHECK_LEN ||
+        memcmp(line, check, CACHE_CHECK_LEN - 1) != 0 ||
+        line[CACHE_CHECK_LEN - 1] != '\n') {
+        fclose(f);
+        return NULL;
+    }
+
+    fseek(f, 0, SEEK_END);
+    len = ftell(f) - CACHE_CHECK_LEN;
+    fseek(f, CACHE_CHECK_LEN, SEEK_SET);
+
+    body = len > 0 ? malloc(len + 1) : NULL;
+    if (body && (long)fread(body, 1, len, f) != len) {
+        free(body);
+        body = NULL;
+    }
+    fclose(f);
+
+    if (!body) return NULL;
+    body[len] = '\0';
+
+    /* Mark as recently used */
+    DateStamp(&now);
+    SetFileDate((CONST_STRPTR)path, &now);
+
+    return body;
+}
+
+static int date_before(const struct DateStamp *a, const struct DateStamp *b)
+{
+    if (a->ds_Days != b->ds_Days)     return a->ds_Days < b->ds_Days;
+    if (a->ds_Minute != b->ds_Minute) return a->ds_Minute < b->ds_Minute;
+    return a->ds_Tick < b->ds_Tick;
+}
+
+/* Delete least recently used entries until `needed` more bytes fit
+ * within max_bytes. */
+static void cache_evict(long needed, long max_bytes)
+{
+    struct FileInfoBlock *fib;
+    struct CacheEntry *entries = NULL;
+    int count = 0, cap = 0;
+    long total = 0;
+    BPTR lock;
+
+    lock = Lock((CONST_STRPTR)CACHE_DIR, ACCESS_READ);
+    if (!lock) return;
+
+    fib = (struct FileInfoBlock *)AllocDosObject(DOS_FIB, NULL);
+    if (!fib) {
+        UnLock(lock);
+        return;
+    }
+
+    if (Examine(lock, fib)) {
+        while (ExNext(lock, fib)) {
+            if (fib->fib_DirEntryType >= 0 ||
+                strlen((const char *)fib->fib_FileName) != CACHE_KEY_LEN - 1)
+                continue;
+
+            if (count == cap) {
+                struct CacheEntry *n;
+                cap = cap ? cap * 2 : 32;
+                n = realloc(entries, cap * sizeof(*entries));
+                if (!n) break;
+                entries = n;
+            }
+            strcpy(entries[count].name, (const char *)fib->fib_FileName);
+            entries[count].size = fib->fib_Size;
+            entries[count].date = fib->fib_Date;
+            total += fib->fib_Size;
+            count++;
+        }
+    }
+
+    FreeDosObject(DOS_FIB, fib);
+    UnLock(lock);
+
+    while (count > 0 && total + needed > max_bytes) {
+        char path[64];
+        int i, oldest = 0;
+
+        for (i = 1; i < count; i++)
+            if (date_before(&entries[i].date, &entries[oldest].date))
+                oldest = i;
+
+        cache_path(entries[oldest].name, path, sizeof(path));
+        DeleteFile((CONST_STRPTR)path);
+        total -= entries[oldest].size;
+        entries[oldest] = entries[--count];
+    }
+
+    free(entries);
+}
+
+int cache_put(const char *key, const char *check, const char *body,
+              long len, long max_bytes)
+{
+    char path[64], tmp[72];
+    BPTR lock;
+    FILE *f;
+    int ok;
+
+    if (len <= 0 || len + CACHE_CHECK_LEN > max_bytes) return -1;
+
+    /* Create cache directory if needed */
+    lock = Lock((CONST_STRPTR)CACHE_DIR, ACCESS_READ);
+    if (!lock) {
+        lock = CreateDir((CONST_STRPTR)CACHE_DIR);
+        if (!lock) return -1;
+    }
+    UnLock(lock);
+
+    cache_evict(len + CACHE_CHECK_LEN, max_bytes);
+
+    /* Write to a temporary name first so a failed write never
+     * leaves a truncated entry behind */
+    cache_path(key, path, sizeof(path));
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    f = fopen(tmp, "wb");
+    if (!f) return -1;
+    ok = fprintf(f, "%s\n", check) == CACHE_CHECK_LEN &&
+         (long)fwrite(body, 1, len, f) == len;
+    if (fclose(f) != 0) ok = 0;
+
+    DeleteFile((CONST_STRPTR)path);
+    if (!ok || !Rename((CONST_STRPTR)tmp, (CONST_STRPTR)path)) {
+        DeleteFile((CONST_STRPTR)tmp);
+        return -1;
+    }
+
+    return 0;
+}
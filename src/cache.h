@@ -0,0 +1,38 @@
+#ifndef AMIGAAI_CACHE_H
+#define AMIGAAI_CACHE_H
+
+#define CACHE_DIR      "AmigaAI:cache"
+#define CACHE_KEY_LEN  17    /* 16 hex digits + NUL */
+#define CACHE_CHECK_LEN 17   /* 16 hex digits + NUL */
+
+/* Compute the cache key for a serialized API request, and a check
+ * value stored with the entry. The key covers the whole request body
+ * (model, system prompt, messages, tools), so any change in context
+ * yields a new key; the check (request length and a third, independent
+ * hash) catches two requests whose keys collide. */
+void cache_key(const char *request, long len, char *key, char *check);
+
+/* Incremental form of cache_key(), for requests that are never held
+ * in one piece: init, update with each piece in order, final. */
+struct CacheKeyState {
+    unsigned long fnv, djb, sdbm;
+    unsigned long len;
+};
+
+void cache_key_init(struct CacheKeyState *st);
+void cache_key_update(struct CacheKeyState *st, const char *data, long len);
+void cache_key_final(const struct CacheKeyState *st, char *key, char *check);
+
+/* Look up a cached response body for the request with this key and
+ * check. Returns a newly allocated string (caller must free) or NULL on
+ * a miss; an entry stored with another check is a miss.
+ * A hit refreshes the entry's date so eviction is least-recently-used. */
+char *cache_get(const char *key, const char *check);
+
+/* Store a response body under key, with its check, first evicting the
+ * least recently used entries so the cache directory stays within
+ * max_bytes. Returns 0 on success, -1 on error. */
+int cache_put(const char *key, const char *check, const char *body,
+              long len, long max_bytes);
+
+#endif /* AMIGAAI_CACHE_H */
@@ -1,6 +1,10 @@
 #include "claude.h"
 #include "http.h"
+#include "arena.h"
 #include "json_utils.h"
+#include "json_writer.h"
+#include "cache.h"
+#include "sse.h"
 #include "tools.h"
 
 #include <stdio.h>
@@ -17,8 +21,16 @@ int claude_init(struct Claude *ctx, struct Config *cfg, struct Memory *mem)
     ctx->messages = cJSON_CreateArray();
     if (!ctx->messages) return -1;
 
-    /* Build tool definitions */
-    ctx->tools = tools_build_json();
+    /* Build tool definitions. They never change, so they are serialized
+     * once here and every request splices the text in as raw JSON. */
+    {
+        cJSON *tools = tools_build_json();
+        char *json = tools ? cJSON_PrintUnformatted(tools) : NULL;
+
+        ctx->tools = json ? cJSON_CreateRaw(json) : NULL;
+        cJSON_free(json);
+        cJSON_Delete(tools);
+    }
 
     return 0;
 }
@@ -33,6 +45,7 @@ void claude_cleanup(struct Claude *ctx)
         cJSON_Delete(ctx->tools);
         ctx->tools = NULL;
     }
+    arena_release();
 }
 
 void claude_set_tool_callback(struct Claude *ctx,
@@ -49,6 +62,9 @@ int claude_clear_history(struct Claude *ctx)
     if (ctx->messages)
         cJSON_Delete(ctx->messages);
 
+    /* Claude hasn't seen the screen in the new conversation */
+    tools_forget_screen();
+
     new_arr = cJSON_CreateArray();
     if (!new_arr) {
         ctx->messages = NULL;
@@ -134,264 +150,770 @@ static const char *build_system_prompt(struct Claude *ctx, char *buf, int bufsiz
     return pos > 0 ? buf : NULL;
 }
 
-/* Perform a single API call and return the raw response body.
- * Caller must free the returned body string. */
-static char *api_call(struct Claude *ctx, char **error_msg)
+/* Split an api_host spec "[http://|https://]host[:port]" into its parts.
+ * An empty spec selects the real API over HTTPS. */
+static void parse_api_host(const char *spec, char *host, int hostsize,
+                           int *port, int *use_tls)
 {
-    char *request_json;
-    struct HttpResponse response;
-    char api_key_header[256];
-    int rc;
+    const char *colon;
+    int len;
 
-    static char effective_system[CONFIG_MAX_PROMPT_LEN + MEMORY_MAX_SIZE + 512];
-    const char *sys_ptr;
+    *use_tls = 1;
+    *port = HTTPS_PORT;
+
+    if (!spec || !spec[0]) {
+        snprintf(host, hostsize, "%s", CLAUDE_API_HOST);
+        return;
+    }
+
+    if (strncasecmp(spec, "http://", 7) == 0) {
+        *use_tls = 0;
+        *port = HTTP_PORT;
+        spec += 7;
+    } else if (strncasecmp(spec, "https://", 8) == 0) {
+        spec += 8;
+    }
+
+    colon = strchr(spec, ':');
+    len = colon ? (int)(colon - spec) : (int)strcspn(spec, "/");
+    if (len >= hostsize) len = hostsize - 1;
+    memcpy(host, spec, len);
+    host[len] = '\0';
+
+    if (colon && atoi(colon + 1) > 0)
+        *port = atoi(colon + 1);
+}
 
-    const char *headers[] = {
-        "Content-Type: application/json",
-        api_key_header,
-        "anthropic-version: " CLAUDE_API_VERSION,
-        NULL
-    };
+/* claude_api_request() with an optional streaming response callback.
+ * If body_writer is set, it produces the body_len bytes of the body
+ * instead of body. */
+static int api_request_stream(struct Claude *ctx,
+                              const char *method,
+                              const char *path,
+                              const char **extra_headers,
+                              const char *body,
+                              HttpBodyWriter body_writer,
+                              void *body_userdata,
+                              long body_len,
+                              HttpDataCallback data_cb,
+                              void *data_userdata,
+                              struct HttpResponse *response)
+{
+    char api_key_header[256];
+    char host[CONFIG_MAX_HOST_LEN];
+    const char *headers[12];
+    int port, use_tls;
+    int n = 0, own_type = 0;
 
     /* Build x-api-key header */
     snprintf(api_key_header, sizeof(api_key_header),
              "x-api-key: %s", ctx->config->api_key);
 
+    if (extra_headers) {
+        int i;
+        for (i = 0; extra_headers[i]; i++)
+            if (strncasecmp(extra_headers[i], "Content-Type:", 13) == 0)
+                own_type = 1;
+    }
+
+    if (!own_type)
+        headers[n++] = "Content-Type: application/json";
+    headers[n++] = api_key_header;
+    headers[n++] = "anthropic-version: " CLAUDE_API_VERSION;
+    if (extra_headers) {
+        int i;
+        for (i = 0; extra_headers[i] && n < 11; i++)
+            headers[n++] = extra_headers[i];
+    }
+    headers[n] = NULL;
+
+    parse_api_host(ctx->config->api_host, host, sizeof(host),
+                   &port, &use_tls);
+
+    if (body_writer)
+        return http_request_body(method, host, port, use_tls, path, headers,
+                                 body_writer, body_userdata, body_len,
+                                 data_cb, data_userdata, response);
+
+    return http_request_stream(method, host, port, use_tls, path, headers,
+                               body, body_len, data_cb, data_userdata,
+                               response);
+}
+
+int claude_api_request(struct Claude *ctx,
+                       const char *method,
+                       const char *path,
+                       const char **extra_headers,
+                       const char *body,
+                       long body_len,
+                       struct HttpResponse *response)
+{
+    return api_request_stream(ctx, method, path, extra_headers,
+                              body, NULL, NULL, body_len, NULL, NULL,
+                              response);
+}
+
+char *claude_http_error(const struct HttpResponse *response)
+{
+    char buf[256];
+    char *api_err = NULL;
+
+    if (response->body)
+        json_parse_response(response->body, &api_err);
+
+    snprintf(buf, sizeof(buf), "HTTP %d: %s",
+             response->status_code,
+             api_err ? api_err : "Request failed");
+
+    free(api_err);
+    return strdup(buf);
+}
+
+/* Multipart body of an image upload: head, image, tail */
+struct UploadBody {
+    const char          *head, *tail;
+    long                 head_len, tail_len;
+    const unsigned char *data;
+    long                 data_len;
+};
+
+/* HttpBodyWriter: send the parts straight from where they are, so the
+ * image is not copied into a body buffer */
+static int write_upload(HttpDataCallback sink, void *sink_data,
+                        void *userdata)
+{
+    struct UploadBody *ub = (struct UploadBody *)userdata;
+
+    if (sink(ub->head, ub->head_len, sink_data) != 0)
+        return -1;
+    if (sink((const char *)ub->data, ub->data_len, sink_data) != 0)
+        return -1;
+    return sink(ub->tail, ub->tail_len, sink_data) != 0 ? -1 : 0;
+}
+
+/* Upload an image through the Files API.
+ * Returns the new file ID (caller must free) or NULL, in which case the
+ * caller sends the image inline. A rejected upload (4xx) before any
+ * upload has succeeded marks the Files API unavailable for the session. */
+static char *upload_image(struct Claude *ctx, const unsigned char *data,
+                          long data_len, const char *media_type)
+{
+    static const char boundary[] = "AmigaAI-7d3f9a1c5e";
+    const char *headers[3];
+    char content_type[80], head[256], tail[48];
+    struct HttpResponse response;
+    struct UploadBody ub;
+    char *file_id = NULL;
+    const char *ext;
+    int rc;
+
+    ext = strchr(media_type, '/');
+    ext = ext ? ext + 1 : "bin";
+
+    ub.head = head;
+    ub.head_len = snprintf(head, sizeof(head),
+        "--%s\r\n"
+        "Content-Disposition: form-data; name=\"file\"; filename=\"image.%s\"\r\n"
+        "Content-Type: %s\r\n\r\n",
+        boundary, ext, media_type);
+    ub.tail = tail;
+    ub.tail_len = snprintf(tail, sizeof(tail), "\r\n--%s--\r\n", boundary);
+    ub.data = data;
+    ub.data_len = data_len;
+
+    snprintf(content_type, sizeof(content_type),
+             "Content-Type: multipart/form-data; boundary=%s", boundary);
+    headers[0] = content_type;
+    headers[1] = CLAUDE_FILES_BETA;
+    headers[2] = NULL;
+
+    rc = api_request_stream(ctx, "POST", CLAUDE_FILES_PATH, headers,
+                            NULL, write_upload, &ub,
+                            ub.head_len + data_len + ub.tail_len,
+                            NULL, NULL, &response);
+
+    if (rc != 0) {
+        printf("  [files] upload failed, sending image inline\n");
+        return NULL;
+    }
+
+    if (response.status_code == 200) {
+        cJSON *resp = cJSON_Parse(response.body);
+        cJSON *id_obj = cJSON_GetObjectItemCaseSensitive(resp, "id");
+        if (cJSON_IsString(id_obj) &&
+            strlen(id_obj->valuestring) < CLAUDE_MAX_FILE_ID_LEN)
+            file_id = strdup(id_obj->valuestring);
+        cJSON_Delete(resp);
+    }
+
+    if (file_id) {
+        printf("  [files] uploaded %ld bytes as %s\n", data_len, file_id);
+        ctx->files_api_state = 1;
+    } else {
+        char *err = claude_http_error(&response);
+        printf("  [files] upload rejected (%s), sending image inline\n",
+               err ? err : "?");
+        free(err);
+        if (ctx->files_api_state == 0 &&
+            response.status_code >= 400 && response.status_code < 500)
+            ctx->files_api_state = -1;
+    }
+
+    free(response.body);
+    return file_id;
+}
+
+/* Return a file ID for the image if the Files API is enabled and
+ * available, else NULL (send inline). Caller must free. */
+static char *image_file_id(struct Claude *ctx, const unsigned char *image,
+                           long image_len, const char *media_type)
+{
+    if (!ctx->config->files_api || ctx->files_api_state < 0)
+        return NULL;
+    return upload_image(ctx, image, image_len, media_type);
+}
+
+/* Build the tool_result for a tool that returned a PNG screenshot
+ * with its caption (see tool_execute()). image is consumed (moved into
+ * the block or freed). */
+static cJSON *make_image_tool_result(struct Claude *ctx, const char *tool_id,
+                                     unsigned char *image, long image_len,
+                                     const char *caption)
+{
+    char *file_id = image_file_id(ctx, image, image_len, "image/png");
+    cJSON *tr = json_make_tool_result_with_image(tool_id, image, image_len,
+                                                 file_id, "image/png",
+                                                 caption ? caption :
+                                                 "Screenshot captured");
+    cJSON *content = tr ? cJSON_GetObjectItemCaseSensitive(tr, "content") : NULL;
+
+    /* The screenshot counts as seen (tools.c) only if the image block
+     * made it into the result */
+    if (!cJSON_HasObjectItem(cJSON_GetArrayItem(content, 0), "source"))
+        tools_forget_screen();
+
+    free(file_id);
+    return tr;
+}
+
+/* Free results of tools run during the last streamed response. Any
+ * left were never used, e.g. because the response was discarded on
+ * escalation: a screenshot among them was not seen after all. */
+static void prefetch_clear(struct Claude *ctx)
+{
+    int i;
+    for (i = 0; i < ctx->prefetch_count; i++) {
+        if (ctx->prefetch[i].result && ctx->prefetch[i].image_len &&
+            !ctx->prefetch[i].is_error)
+            tools_forget_screen();
+        free(ctx->prefetch[i].id);
+        free(ctx->prefetch[i].result);
+        free(ctx->prefetch[i].caption);
+    }
+    ctx->prefetch_count = 0;
+    ctx->prefetch_blocked = 0;
+}
+
+/* SseToolCallback: a tool_use block has arrived completely. Read-only
+ * tools run right away, unless a side-effecting tool_use came earlier
+ * in the message (its effects must be visible to the later tools). */
+static void prefetch_tool(cJSON *block, void *userdata)
+{
+    struct Claude *ctx = (struct Claude *)userdata;
+    cJSON *id_obj   = cJSON_GetObjectItemCaseSensitive(block, "id");
+    cJSON *name_obj = cJSON_GetObjectItemCaseSensitive(block, "name");
+    cJSON *input;
+    struct ToolPrefetch *pf;
+
+    if (!cJSON_IsString(id_obj) || !cJSON_IsString(name_obj))
+        return;
+
+    if (!tool_is_read_only(name_obj->valuestring)) {
+        ctx->prefetch_blocked = 1;
+        return;
+    }
+    if (ctx->prefetch_blocked || ctx->prefetch_count >= CLAUDE_MAX_PREFETCH)
+        return;
+
+    /* tool_execute() converts the input in place; keep the stream's
+     * copy in UTF-8 for the conversation history. The copy is
+     * transient, so its nodes come from the arena. */
+    arena_begin();
+    input = cJSON_Duplicate(cJSON_GetObjectItemCaseSensitive(block, "input"), 1);
+    arena_end();
+    if (!input) {
+        arena_reset();
+        return;
+    }
+
+    printf("  [agent] prefetch: %s (id=%s)\n",
+           name_obj->valuestring, id_obj->valuestring);
+
+    pf = &ctx->prefetch[ctx->prefetch_count];
+    pf->id = strdup(id_obj->valuestring);
+    pf->result = tool_execute(name_obj->valuestring, input,
+                              &pf->is_error, &pf->image_len, &pf->caption);
+    cJSON_Delete(input);
+    arena_reset();
+
+    if (pf->id) {
+        ctx->prefetch_count++;
+    } else {
+        free(pf->result);
+        free(pf->caption);
+    }
+}
+
+/* Take the prefetched result for a tool_use id, if any.
+ * Returns 1 and transfers *result and *caption to the caller if found. */
+static int prefetch_take(struct Claude *ctx, const char *id, char **result,
+                         int *is_error, long *image_len, char **caption)
+{
+    int i;
+    for (i = 0; i < ctx->prefetch_count; i++) {
+        struct ToolPrefetch *pf = &ctx->prefetch[i];
+        if (pf->id && strcmp(pf->id, id) == 0) {
+            *result    = pf->result;
+            *is_error  = pf->is_error;
+            *image_len = pf->image_len;
+            *caption   = pf->caption;
+            pf->result = NULL;
+            pf->caption = NULL;
+            free(pf->id);
+            pf->id = NULL;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* json_write() sink for the measuring pass: feeds the cache key */
+static int measure_request(const char *data, long len, void *userdata)
+{
+    if (userdata)
+        cache_key_update((struct CacheKeyState *)userdata, data, len);
+    return 0;
+}
+
+/* HttpBodyWriter: serialize the request tree straight to the socket */
+static int write_request(HttpDataCallback sink, void *sink_data,
+                         void *userdata)
+{
+    return json_write((cJSON *)userdata, sink, sink_data) < 0 ? -1 : 0;
+}
+
+/* Perform a single API call with the given model and return the
+ * parsed response message (caller must cJSON_Delete).
+ * The body is parsed exactly once; streamed responses arrive already
+ * parsed. Cached responses carry no "usage" (no tokens were spent).
+ * *status is set to the HTTP status code (0 on transport error). */
+static cJSON *api_call(struct Claude *ctx, const char *model,
+                       int *status, char **error_msg)
+{
+    cJSON *request;
+    long request_len;
+    struct CacheKeyState ks;
+    struct HttpResponse response;
+    struct SseStream sse;
+    cJSON *message = NULL;
+    char key[CACHE_KEY_LEN], check[CACHE_CHECK_LEN];
+    int use_cache = ctx->config->cache_size > 0;
+    int rc;
+
+    static char effective_system[CONFIG_MAX_PROMPT_LEN + MEMORY_MAX_SIZE + 512];
+    const char *sys_ptr;
+
     /* Build system prompt */
     sys_ptr = build_system_prompt(ctx, effective_system, sizeof(effective_system));
 
     /* Build request JSON with tools */
-    request_json = json_build_request(
-        ctx->config->model,
+    *status = 0;
+    prefetch_clear(ctx);
+
+    /* The request tree references the conversation instead of copying
+     * it, so it is only a few nodes. A first pass over it measures the
+     * body (Content-Length) and computes the cache key; the second one
+     * writes it to the socket. */
+    request = json_build_request_tree(
+        model,
         ctx->config->max_tokens,
         sys_ptr,
         ctx->messages,
-        ctx->tools
+        ctx->tools,
+        ctx->config->stream
     );
-    if (!request_json) {
+
+    cache_key_init(&ks);
+    request_len = request ? json_write(request, measure_request,
+                                       use_cache ? &ks : NULL) : -1;
+    if (request_len < 0) {
+        cJSON_Delete(request);
         if (error_msg) *error_msg = strdup("Failed to build request JSON");
         return NULL;
     }
 
-    /* Perform HTTPS POST */
-    rc = http_post(CLAUDE_API_HOST, CLAUDE_API_PATH,
-                   headers, request_json, &response);
+    /* Identical request answered before? */
+    if (use_cache) {
+        cache_key_final(&ks, key, check);
+        if (!ctx->cache_bypass) {
+            char *cached = cache_get(key, check);
+            if (cached) {
+                message = cJSON_Parse(cached);
+                free(cached);
+            }
+            if (message) {
+                printf("  [cache] hit %s\n", key);
+                cJSON_Delete(request);
+                cJSON_DeleteItemFromObjectCaseSensitive(message, "usage");
+                *status = 200;
+                return message;
+            }
+        }
+    }
+
+    /* Perform HTTPS POST. Once images have been uploaded, the history
+     * may reference file IDs, which needs the Files API beta header.
+     * Streamed responses are rebuilt into a message as they arrive;
+     * read-only tools may already run during the stream. */
+    {
+        static const char *files_headers[] = { CLAUDE_FILES_BETA, NULL };
+
+        sse_init(&sse, prefetch_tool, ctx);
+        rc = api_request_stream(ctx, "POST", CLAUDE_API_PATH,
+                                ctx->files_api_state > 0 ? files_headers : NULL,
+                                NULL, write_request, request, request_len,
+                                ctx->config->stream ? sse_feed : NULL, &sse,
+                                &response);
+    }
 
-    cJSON_free(request_json);
+    cJSON_Delete(request);
 
     if (rc != 0) {
-        if (error_msg) *error_msg = strdup("HTTPS request failed");
+        sse_free(&sse);
+        if (error_msg)
+            *error_msg = strdup(rc == -3 ? "Streamed response could not "
+                                           "be processed"
+                                         : "HTTPS request failed");
         return NULL;
     }
 
     /* Check HTTP status */
+    *status = response.status_code;
     if (response.status_code != 200) {
-        char buf[256];
-        char *api_err = NULL;
-
-        if (response.body)
-            json_parse_response(response.body, &api_err);
-
-        snprintf(buf, sizeof(buf), "HTTP %d: %s",
-                 response.status_code,
-                 api_err ? api_err : "Request failed");
-
-        if (error_msg) *error_msg = strdup(buf);
-        free(api_err);
+        sse_free(&sse);
+        if (error_msg) *error_msg = claude_http_error(&response);
         free(response.body);
         return NULL;
     }
 
-    /* Parse token usage */
-    json_parse_usage(response.body,
-                     &ctx->last_input_tokens,
-                     &ctx->last_output_tokens);
+    if (ctx->config->stream) {
+        free(response.body);
+        response.body = NULL;
+        if (sse.error) use_cache = 0;
+        message = sse_finish(&sse);
+        sse_free(&sse);
+        if (!message) {
+            if (error_msg) *error_msg = strdup("Incomplete streamed response");
+            return NULL;
+        }
+        if (use_cache)
+            response.body = cJSON_PrintUnformatted(message);
+    } else {
+        sse_free(&sse);
+        message = cJSON_Parse(response.body);
+        if (!message) {
+            if (error_msg) *error_msg = strdup("Failed to parse JSON response");
+            free(response.body);
+            return NULL;
+        }
+    }
+
+    if (use_cache && response.body)
+        cache_put(key, check, response.body, (long)strlen(response.body),
+                  (long)ctx->config->cache_size * 1024);
+    free(response.body);
 
-    return response.body;  /* caller frees */
+    return message;
 }
 
-char *claude_send(struct Claude *ctx, const char *user_message, char **error_msg)
+static const char *route_names[ROUTE_COUNT] = { "main", "tool", "short" };
+
+const char *claude_route_name(int route)
 {
-    cJSON *user_msg = NULL;
-    int iteration;
-    char *final_text = NULL;
-    int final_text_len = 0;
-    int final_text_cap = 0;
-    int initial_msg_count;
+    return (route >= 0 && route < ROUTE_COUNT) ? route_names[route] : NULL;
+}
 
-    if (error_msg) *error_msg = NULL;
+int claude_route_lookup(const char *name)
+{
+    int i;
+    for (i = 0; i < ROUTE_COUNT; i++)
+        if (strcasecmp(name, route_names[i]) == 0)
+            return i;
+    return -1;
+}
 
-    /* Check API key */
-    if (!ctx->config->api_key[0]) {
-        if (error_msg) *error_msg = strdup("No API key configured");
-        return NULL;
+const char *claude_route_model(struct Claude *ctx, int route)
+{
+    if (route == ROUTE_TOOL && ctx->config->tool_model[0])
+        return ctx->config->tool_model;
+    if (route == ROUTE_SHORT && ctx->config->short_model[0])
+        return ctx->config->short_model;
+    return ctx->config->model;
+}
+
+/* Pick the route for the first call of a turn: short text queries go
+ * to the short route if one is configured. */
+static int first_route(struct Claude *ctx, const char *user_message)
+{
+    if (user_message && ctx->config->short_model[0] &&
+        ctx->config->short_limit > 0 &&
+        (int)strlen(user_message) <= ctx->config->short_limit)
+        return ROUTE_SHORT;
+    return ROUTE_MAIN;
+}
+
+/* Append text to the accumulated reply, separated by newlines */
+static void append_text(char **final_text, int *len, int *cap,
+                        const char *text)
+{
+    int tlen = strlen(text);
+    int needed = *len + tlen + 2;
+
+    if (needed > *cap) {
+        char *n;
+        *cap = needed + 256;
+        n = realloc(*final_text, *cap);
+        if (!n) return;
+        *final_text = n;
     }
+    if (*len > 0)
+        (*final_text)[(*len)++] = '\n';
+    memcpy(*final_text + *len, text, tlen);
+    *len += tlen;
+    (*final_text)[*len] = '\0';
+}
 
-    /* Remember message count so we can roll back on failure */
-    initial_msg_count = cJSON_GetArraySize(ctx->messages);
+/* Execute the tool_use blocks of an assistant message.
+ * Returns an array of tool_result blocks; *tool_error is set if any
+ * tool reported an error. */
+static cJSON *run_tools(struct Claude *ctx, cJSON *content, int *tool_error)
+{
+    cJSON *tool_results = cJSON_CreateArray();
+    int i, count = cJSON_GetArraySize(content);
+
+    *tool_error = 0;
+    if (!tool_results) return NULL;
+
+    for (i = 0; i < count; i++) {
+        cJSON *block = cJSON_GetArrayItem(content, i);
+        cJSON *type = cJSON_GetObjectItemCaseSensitive(block, "type");
+        cJSON *id_obj, *name_obj, *inp_obj;
+        const char *tool_id, *tool_name;
+        int is_error = 0;
+        long image_len = 0;
+        char *result, *caption, *inp_summary;
+        cJSON *tr;
+
+        if (!cJSON_IsString(type) ||
+            strcmp(type->valuestring, "tool_use") != 0)
+            continue;
+
+        id_obj   = cJSON_GetObjectItemCaseSensitive(block, "id");
+        name_obj = cJSON_GetObjectItemCaseSensitive(block, "name");
+        inp_obj  = cJSON_GetObjectItemCaseSensitive(block, "input");
+
+        if (!inp_obj || !cJSON_IsString(id_obj) || !cJSON_IsString(name_obj))
+            continue;
+
+        tool_id   = id_obj->valuestring;
+        tool_name = name_obj->valuestring;
+
+        /* Notify callback with input detail */
+        inp_summary = cJSON_PrintUnformatted(inp_obj);
+        if (ctx->tool_cb)
+            ctx->tool_cb(tool_name, "executing", inp_summary,
+                         ctx->tool_cb_data);
+        cJSON_free(inp_summary);
+
+        printf("  [agent] tool_use: %s (id=%s)\n", tool_name, tool_id);
+
+        /* Execute the tool, unless it already ran during streaming.
+         * tool_execute() converts the input in place, and the content
+         * belongs to the history (UTF-8), so it gets an arena copy. */
+        if (!prefetch_take(ctx, tool_id, &result, &is_error, &image_len,
+                           &caption)) {
+            cJSON *input;
+
+            arena_begin();
+            input = cJSON_Duplicate(inp_obj, 1);
+            arena_end();
+            result = tool_execute(tool_name, input ? input : inp_obj,
+                                  &is_error, &image_len, &caption);
+            cJSON_Delete(input);
+            arena_reset();
+        }
 
-    /* Add user message to conversation */
-    user_msg = json_make_message("user", user_message);
-    if (!user_msg) {
-        if (error_msg) *error_msg = strdup("Out of memory");
-        return NULL;
+        printf("  [agent] result: %s%s\n",
+               is_error ? "ERROR: " : "",
+               image_len ? "(image data)" : (result ? result : "(null)"));
+
+        /* Notify callback with result */
+        if (ctx->tool_cb)
+            ctx->tool_cb(tool_name, is_error ? "error" : "done",
+                         image_len ? "(screenshot)" : result,
+                         ctx->tool_cb_data);
+
+        /* Build tool_result block */
+        if (image_len && !is_error) {
+            tr = make_image_tool_result(ctx, tool_id,
+                                        (unsigned char *)result, image_len,
+                                        caption);
+            result = NULL;
+        } else
+            tr = json_make_tool_result(tool_id, result, is_error);
+        if (tr)
+            cJSON_AddItemToArray(tool_results, tr);
+
+        if (is_error)
+            *tool_error = 1;
+        free(result);
+        free(caption);
     }
-    cJSON_AddItemToArray(ctx->messages, user_msg);
 
-    /* Tool use loop */
+    return tool_results;
+}
+
+/* Run the API / tool use loop for a user message that has already been
+ * appended to ctx->messages. route selects the model of the first call;
+ * tool continuation calls use the tool route.
+ *
+ * Escalation to the main model (for the rest of the turn):
+ *  - a routed call fails with HTTP 400/404 (e.g. unknown model)
+ *  - a routed call stops at max_tokens
+ *  - a tool reports an error
+ * A final answer from the tool route is kept: regenerating it would
+ * cost another full request and round trip on every agentic turn.
+ * Discarded responses are not added to the conversation.
+ * On failure, all messages added since initial_msg_count are removed. */
+static char *run_turn(struct Claude *ctx, int route, int initial_msg_count,
+                      char **error_msg)
+{
+    int iteration;
+    int escalated = 0;
+    char *final_text = NULL;
+    int final_text_len = 0;
+    int final_text_cap = 0;
+
     for (iteration = 0; iteration < TOOLS_MAX_ITERATIONS; iteration++) {
-        char *body;
+        const char *model;
+        cJSON *message;
         char *stop_reason = NULL;
         char *text = NULL;
         char *err = NULL;
-        cJSON *content;
-        int has_tool_use = 0;
+        cJSON *content, *tool_results, *asst_msg, *owned;
+        int used, status, is_tool_use, tool_error;
+
+        /* Unconfigured routes fall back to the main model */
+        used = escalated ? ROUTE_MAIN : route;
+        model = claude_route_model(ctx, used);
+        if (used != ROUTE_MAIN && model == ctx->config->model)
+            used = ROUTE_MAIN;
 
         /* API call */
-        body = api_call(ctx, &err);
-        if (!body) {
+        message = api_call(ctx, model, &status, &err);
+        if (!message) {
+            if (used != ROUTE_MAIN && (status == 400 || status == 404)) {
+                printf("  [route] %s model failed (%s), escalating\n",
+                       route_names[used], err ? err : "?");
+                free(err);
+                escalated = 1;
+                continue;
+            }
             if (error_msg) *error_msg = err;
             goto fail;
         }
 
-        /* Parse full response */
-        content = json_parse_full_response(body, &stop_reason, &text, &err);
-        free(body);
+        /* Take usage, stop_reason, text and content in one pass */
+        ctx->last_input_tokens = 0;
+        ctx->last_output_tokens = 0;
+        content = json_take_response(message, &stop_reason, &text,
+                                     &ctx->last_input_tokens,
+                                     &ctx->last_output_tokens, &err);
+        cJSON_Delete(message);
+
+        ctx->route_stats[used].calls++;
+        ctx->route_stats[used].input_tokens  += ctx->last_input_tokens;
+        ctx->route_stats[used].output_tokens += ctx->last_output_tokens;
 
         if (!content) {
             if (error_msg) *error_msg = err;
             goto fail;
         }
 
-        /* Accumulate any text from this response */
-        if (text && text[0]) {
-            int tlen = strlen(text);
-            int needed = final_text_len + tlen + 2;
-            if (needed > final_text_cap) {
-                final_text_cap = needed + 256;
-                final_text = realloc(final_text, final_text_cap);
-            }
-            if (final_text) {
-                if (final_text_len > 0)
-                    final_text[final_text_len++] = '\n';
-                memcpy(final_text + final_text_len, text, tlen);
-                final_text_len += tlen;
-                final_text[final_text_len] = '\0';
-            }
-        }
-        free(text);
+        is_tool_use = stop_reason && strcmp(stop_reason, "tool_use") == 0;
 
-        /* Add assistant response to conversation history */
+        if (used != ROUTE_MAIN &&
+            stop_reason && strcmp(stop_reason, "max_tokens") == 0)
         {
-            cJSON *asst_msg = json_make_content_message("assistant",
-                                  cJSON_Duplicate(content, 1));
-            if (asst_msg)
-                cJSON_AddItemToArray(ctx->messages, asst_msg);
+            printf("  [route] %s model stopped (%s), escalating\n",
+                   route_names[used], stop_reason ? stop_reason : "?");
+            cJSON_Delete(content);
+            free(stop_reason);
+            free(text);
+            escalated = 1;
+            continue;
         }
 
-        /* Check if we need to execute tools */
-        if (stop_reason && strcmp(stop_reason, "tool_use") == 0) {
-            cJSON *tool_results = cJSON_CreateArray();
-            int i, count = cJSON_GetArraySize(content);
-
-            for (i = 0; i < count; i++) {
-                cJSON *block = cJSON_GetArrayItem(content, i);
-                cJSON *type = cJSON_GetObjectItemCaseSensitive(block, "type");
-
-                if (type && cJSON_IsString(type) &&
-                    strcmp(type->valuestring, "tool_use") == 0)
-                {
-                    cJSON *id_obj   = cJSON_GetObjectItemCaseSensitive(block, "id");
-                    cJSON *name_obj = cJSON_GetObjectItemCaseSensitive(block, "name");
-                    cJSON *inp_obj  = cJSON_GetObjectItemCaseSensitive(block, "input");
-
-                    if (id_obj && name_obj && inp_obj &&
-                        cJSON_IsString(id_obj) && cJSON_IsString(name_obj))
-                    {
-                        const char *tool_id   = id_obj->valuestring;
-                        const char *tool_name = name_obj->valuestring;
-                        int is_error = 0;
-                        int has_image = 0;
-                        char *result;
-
-                        /* Build a summary of the tool input */
-                        {
-                            char *inp_summary = cJSON_PrintUnformatted(inp_obj);
-
-                            /* Notify callback with input detail */
-                            if (ctx->tool_cb)
-                                ctx->tool_cb(tool_name, "executing",
-                                             inp_summary, ctx->tool_cb_data);
-
-                            printf("  [agent] tool_use: %s (id=%s)\n",
-                                   tool_name, tool_id);
-
-                            /* Execute the tool */
-                            result = tool_execute(tool_name, inp_obj,
-                                                  &is_error, &has_image);
-
-                            printf("  [agent] result: %s%s\n",
-                                   is_error ? "ERROR: " : "",
-                                   has_image ? "(image data)"
-                                   : (result ? result : "(null)"));
-
-                            /* Notify callback with result */
-                            if (ctx->tool_cb)
-                                ctx->tool_cb(tool_name,
-                                             is_error ? "error" : "done",
-                                             has_image ? "(screenshot)"
-                                             : result,
-                                             ctx->tool_cb_data);
-
-                            cJSON_free(inp_summary);
-                        }
-
-                        /* Build tool_result block */
-                        {
-                            cJSON *tr;
-                            if (has_image && !is_error) {
-                                tr = json_make_tool_result_with_image(
-                                    tool_id, result, "image/png",
-                                    "Screenshot captured");
-                            } else {
-                                tr = json_make_tool_result(
-                                    tool_id, result, is_error);
-                            }
-                            if (tr)
-                                cJSON_AddItemToArray(tool_results, tr);
-                        }
-
-                        free(result);
-                        has_tool_use = 1;
-                    }
-                }
-            }
+        /* Accumulate any text from this response */
+        if (text && text[0])
+            append_text(&final_text, &final_text_len, &final_text_cap, text);
+        free(text);
 
-            cJSON_Delete(content);
-            free(stop_reason);
+        /* Move the content into the conversation history (no copy).
+         * It stays valid for run_tools() below. */
+        free(stop_reason);
+        asst_msg = json_make_content_message("assistant", content);
+        if (asst_msg) {
+            cJSON_AddItemToArray(ctx->messages, asst_msg);
+            owned = NULL;
+        } else {
+            owned = content;
+        }
 
-            if (has_tool_use && cJSON_GetArraySize(tool_results) > 0) {
-                /* Add tool results as a user message */
-                cJSON *tr_msg = json_make_content_message("user", tool_results);
-                if (tr_msg)
-                    cJSON_AddItemToArray(ctx->messages, tr_msg);
-                else
-                    cJSON_Delete(tool_results);
+        /* Not a tool_use response — we're done */
+        if (!is_tool_use) {
+            cJSON_Delete(owned);
+            break;
+        }
 
-                /* Continue the loop for next API call */
-                continue;
-            }
+        tool_results = run_tools(ctx, content, &tool_error);
+        cJSON_Delete(owned);
 
+        if (!tool_results || cJSON_GetArraySize(tool_results) == 0) {
             cJSON_Delete(tool_results);
             break;  /* No tool use blocks found despite stop_reason */
         }
 
-        /* Not a tool_use response — we're done */
-        cJSON_Delete(content);
-        free(stop_reason);
-        break;
+        /* Add tool results as a user message */
+        {
+            cJSON *tr_msg = json_make_content_message("user", tool_results);
+            if (tr_msg) {
+                cJSON_AddItemToArray(ctx->messages, tr_msg);
+            } else {
+                cJSON_Delete(tool_results);
+                tools_forget_screen();
+            }
+        }
+
+        if (tool_error)
+            escalated = 1;
+
+        /* Continue the loop for next API call */
+        route = ROUTE_TOOL;
     }
 
+    prefetch_clear(ctx);
+
     /* Return accumulated text */
     if (final_text && final_text[0])
         return final_text;
@@ -404,6 +926,7 @@ char *claude_send(struct Claude *ctx, const char *user_message, char **error_msg
 
 fail:
     free(final_text);
+    prefetch_clear(ctx);
 
     /* Remove ALL messages added during this call (user msg, assistant msgs,
      * tool results) so the conversation history stays consistent.
@@ -419,183 +942,71 @@ fail:
         }
     }
 
+    /* Screenshots sent during this call went with them */
+    tools_forget_screen();
+
     return NULL;
 }
 
-char *claude_send_image(struct Claude *ctx, const char *image_base64,
-                        const char *media_type, const char *text,
-                        char **error_msg)
+char *claude_send(struct Claude *ctx, const char *user_message, char **error_msg)
 {
     cJSON *user_msg;
-    int iteration;
-    char *final_text = NULL;
-    int final_text_len = 0;
-    int final_text_cap = 0;
     int initial_msg_count;
 
     if (error_msg) *error_msg = NULL;
 
+    /* Check API key */
     if (!ctx->config->api_key[0]) {
         if (error_msg) *error_msg = strdup("No API key configured");
         return NULL;
     }
 
+    /* Remember message count so we can roll back on failure */
     initial_msg_count = cJSON_GetArraySize(ctx->messages);
 
-    /* Build user message with image content */
-    user_msg = json_make_user_image_message(image_base64, media_type, text);
+    /* Add user message to conversation */
+    user_msg = json_make_message("user", user_message);
     if (!user_msg) {
         if (error_msg) *error_msg = strdup("Out of memory");
         return NULL;
     }
     cJSON_AddItemToArray(ctx->messages, user_msg);
 
-    /* Tool use loop (same as claude_send) */
-    for (iteration = 0; iteration < TOOLS_MAX_ITERATIONS; iteration++) {
-        char *body;
-        char *stop_reason = NULL;
-        char *resp_text = NULL;
-        char *err = NULL;
-        cJSON *content;
-        int has_tool_use = 0;
-
-        body = api_call(ctx, &err);
-        if (!body) {
-            if (error_msg) *error_msg = err;
-            goto img_fail;
-        }
-
-        content = json_parse_full_response(body, &stop_reason, &resp_text, &err);
-        free(body);
-
-        if (!content) {
-            if (error_msg) *error_msg = err;
-            goto img_fail;
-        }
-
-        /* Accumulate text */
-        if (resp_text && resp_text[0]) {
-            int tlen = strlen(resp_text);
-            int needed = final_text_len + tlen + 2;
-            if (needed > final_text_cap) {
-                final_text_cap = needed + 256;
-                final_text = realloc(final_text, final_text_cap);
-            }
-            if (final_text) {
-                if (final_text_len > 0)
-                    final_text[final_text_len++] = '\n';
-                memcpy(final_text + final_text_len, resp_text, tlen);
-                final_text_len += tlen;
-                final_text[final_text_len] = '\0';
-            }
-        }
-        free(resp_text);
-
-        /* Add assistant response */
-        {
-            cJSON *asst_msg = json_make_content_message("assistant",
-                                  cJSON_Duplicate(content, 1));
-            if (asst_msg)
-                cJSON_AddItemToArray(ctx->messages, asst_msg);
-        }
-
-        /* Handle tool use */
-        if (stop_reason && strcmp(stop_reason, "tool_use") == 0) {
-            cJSON *tool_results = cJSON_CreateArray();
-            int i, count = cJSON_GetArraySize(content);
-
-            for (i = 0; i < count; i++) {
-                cJSON *block = cJSON_GetArrayItem(content, i);
-                cJSON *type = cJSON_GetObjectItemCaseSensitive(block, "type");
-
-                if (type && cJSON_IsString(type) &&
-                    strcmp(type->valuestring, "tool_use") == 0)
-                {
-                    cJSON *id_obj   = cJSON_GetObjectItemCaseSensitive(block, "id");
-                    cJSON *name_obj = cJSON_GetObjectItemCaseSensitive(block, "name");
-                    cJSON *inp_obj  = cJSON_GetObjectItemCaseSensitive(block, "input");
-
-                    if (id_obj && name_obj && inp_obj &&
-                        cJSON_IsString(id_obj) && cJSON_IsString(name_obj))
-                    {
-                        const char *tool_id   = id_obj->valuestring;
-                        const char *tool_name = name_obj->valuestring;
-                        int is_error = 0;
-                        int has_image = 0;
-                        char *result;
-
-                        if (ctx->tool_cb)
-                            ctx->tool_cb(tool_name, "executing",
-                                         NULL, ctx->tool_cb_data);
-
-                        result = tool_execute(tool_name, inp_obj,
-                                              &is_error, &has_image);
-
-                        if (ctx->tool_cb)
-                            ctx->tool_cb(tool_name,
-                                         is_error ? "error" : "done",
-                                         has_image ? "(image)" : result,
-                                         ctx->tool_cb_data);
-
-                        {
-                            cJSON *tr;
-                            if (has_image && !is_error) {
-                                tr = json_make_tool_result_with_image(
-                                    tool_id, result, "image/png",
-                                    "Screenshot captured");
-                            } else {
-                                tr = json_make_tool_result(
-                                    tool_id, result, is_error);
-                            }
-                            if (tr)
-                                cJSON_AddItemToArray(tool_results, tr);
-                        }
-
-                        free(result);
-                        has_tool_use = 1;
-                    }
-                }
-            }
-
-            cJSON_Delete(content);
-            free(stop_reason);
+    return run_turn(ctx, first_route(ctx, user_message),
+                    initial_msg_count, error_msg);
+}
 
-            if (has_tool_use && cJSON_GetArraySize(tool_results) > 0) {
-                cJSON *tr_msg = json_make_content_message("user", tool_results);
-                if (tr_msg)
-                    cJSON_AddItemToArray(ctx->messages, tr_msg);
-                else
-                    cJSON_Delete(tool_results);
-                continue;
-            }
+char *claude_send_image(struct Claude *ctx, unsigned char *image,
+                        long image_len, const char *media_type,
+                        const char *text, char **error_msg)
+{
+    cJSON *user_msg;
+    char *file_id;
+    int initial_msg_count;
 
-            cJSON_Delete(tool_results);
-            break;
-        }
+    if (error_msg) *error_msg = NULL;
 
-        cJSON_Delete(content);
-        free(stop_reason);
-        break;
+    if (!ctx->config->api_key[0]) {
+        if (error_msg) *error_msg = strdup("No API key configured");
+        free(image);
+        return NULL;
     }
 
-    if (final_text && final_text[0])
-        return final_text;
-
-    free(final_text);
-    if (error_msg && !*error_msg)
-        *error_msg = strdup("No text in response");
-    return NULL;
+    initial_msg_count = cJSON_GetArraySize(ctx->messages);
 
-img_fail:
-    free(final_text);
-    {
-        int len = cJSON_GetArraySize(ctx->messages);
-        while (len > initial_msg_count) {
-            cJSON *item = cJSON_DetachItemFromArray(ctx->messages, len - 1);
-            if (item)
-                cJSON_Delete(item);
-            len--;
-        }
+    /* Build user message with image content; the image bytes move into
+     * it as they are. With the Files API the image is uploaded once and
+     * history only keeps its file ID. */
+    file_id = image_file_id(ctx, image, image_len, media_type);
+    user_msg = json_make_user_image_message(image, image_len, file_id,
+                                            media_type, text);
+    free(file_id);
+    if (!user_msg) {
+        if (error_msg) *error_msg = strdup("Out of memory");
+        return NULL;
     }
-    return NULL;
+    cJSON_AddItemToArray(ctx->messages, user_msg);
+
+    /* Images always go to the main model first */
+    return run_turn(ctx, ROUTE_MAIN, initial_msg_count, error_msg);
 }
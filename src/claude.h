@@ -4,11 +4,45 @@
 #include "config.h"
 #include "memory.h"
 #include "cJSON.h"
+#include "http.h"
 
 #define CLAUDE_API_HOST    "api.anthropic.com"
 #define CLAUDE_API_PATH    "/v1/messages"
 #define CLAUDE_API_VERSION "2023-06-01"
 
+#define CLAUDE_FILES_PATH  "/v1/files"
+#define CLAUDE_FILES_BETA  "anthropic-beta: files-api-2025-04-14"
+#define CLAUDE_MAX_FILE_ID_LEN 128
+
+/* Model routes. Each API call of a turn goes to one route:
+ * MAIN  - configured model (first calls, images, escalations)
+ * TOOL  - tool continuation calls (config tool_model)
+ * SHORT - first call for short text queries (config short_model) */
+enum {
+    ROUTE_MAIN,
+    ROUTE_TOOL,
+    ROUTE_SHORT,
+    ROUTE_COUNT
+};
+
+/* Per-route usage since startup */
+struct RouteStats {
+    int  calls;
+    long input_tokens;
+    long output_tokens;
+};
+
+#define CLAUDE_MAX_PREFETCH 8
+
+/* Result of a read-only tool started while the response was streaming */
+struct ToolPrefetch {
+    char *id;             /* tool_use id */
+    char *result;
+    int   is_error;
+    long  image_len;      /* > 0: result is PNG data of this size */
+    char *caption;        /* the image's caption */
+};
+
 /* Callback for tool use status updates.
  * status: "executing", "done", "error"
  * detail: tool input summary (executing) or result text (done/error) */
@@ -21,10 +55,24 @@ struct Claude {
     struct Config   *config;
     struct Memory   *memory;       /* Persistent memory for system prompt */
     cJSON           *messages;     /* JSON array of conversation messages */
-    cJSON           *tools;        /* Tool definitions for API (NULL = no tools) */
+    cJSON           *tools;        /* Tool definitions as raw JSON (NULL = no tools) */
     int              last_input_tokens;
     int              last_output_tokens;
 
+    /* Files API state: 0 = untried, 1 = uploads work,
+     * -1 = unavailable this session (images are sent inline) */
+    int              files_api_state;
+
+    /* Skip response cache lookups (fresh replies still refresh the cache) */
+    int              cache_bypass;
+
+    struct RouteStats route_stats[ROUTE_COUNT];
+
+    /* Tools run early during the current streamed response */
+    struct ToolPrefetch prefetch[CLAUDE_MAX_PREFETCH];
+    int              prefetch_count;
+    int              prefetch_blocked;   /* Side-effecting tool_use seen */
+
     /* Optional callback for tool use status updates */
     ToolStatusCallback tool_cb;
     void              *tool_cb_data;
@@ -41,19 +89,52 @@ void claude_set_tool_callback(struct Claude *ctx,
                               ToolStatusCallback cb, void *userdata);
 
 /* Send a user message and get the assistant's reply.
- * Automatically handles tool use loops (up to TOOLS_MAX_ITERATIONS).
+ * Automatically handles tool use loops (up to TOOLS_MAX_ITERATIONS),
+ * routing each call to a model as described for ROUTE_*.
  * Returns a newly allocated string (caller must free) or NULL on error.
  * On error, *error_msg (if not NULL) is set to an error description. */
 char *claude_send(struct Claude *ctx, const char *user_message, char **error_msg);
 
 /* Send a user message with an image and get the assistant's reply.
- * image_base64: base64-encoded image data.
+ * image, image_len: the image file's bytes (PNG, JPEG, GIF).
  * media_type: e.g. "image/png", "image/jpeg".
  * text: accompanying text (e.g. "User dropped image: Work:pic.png").
+ * image must be malloc()ed and is consumed: the conversation keeps
+ * the bytes without a copy (or they are freed). They are base64-encoded
+ * only while a request is written.
  * Returns newly allocated reply string or NULL on error. */
-char *claude_send_image(struct Claude *ctx, const char *image_base64,
-                        const char *media_type, const char *text,
-                        char **error_msg);
+char *claude_send_image(struct Claude *ctx, unsigned char *image,
+                        long image_len, const char *media_type,
+                        const char *text, char **error_msg);
+
+/* Perform a request against the configured API endpoint
+ * (api.anthropic.com, or ENV:AmigaAI/api_host for a local stand-in server).
+ * Adds the x-api-key, anthropic-version and Content-Type headers
+ * (Content-Type only if extra_headers does not supply its own).
+ * extra_headers (NULL-terminated) may be NULL. body may be NULL.
+ * Returns 0 on success (caller must free response->body),
+ * -2 on user abort, other negative on transport error. */
+int claude_api_request(struct Claude *ctx,
+                       const char *method,
+                       const char *path,
+                       const char **extra_headers,
+                       const char *body,
+                       long body_len,
+                       struct HttpResponse *response);
+
+/* Build an error description for a failed (non-2xx) API response,
+ * including the API's error message if present.
+ * Returns a newly allocated string (caller must free). */
+char *claude_http_error(const struct HttpResponse *response);
+
+/* Route name ("main", "tool", "short") or NULL if out of range. */
+const char *claude_route_name(int route);
+
+/* Route index for a name (case-insensitive) or -1. */
+int claude_route_lookup(const char *name);
+
+/* Model used for a route (the main model if the route is not set). */
+const char *claude_route_model(struct Claude *ctx, int route);
 
 /* Clear conversation history. Returns 0 on success, -1 on alloc failure. */
 int claude_clear_history(struct Claude *ctx);
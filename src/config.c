@@ -1,4 +1,5 @@
 #include "config.h"
+#include "image_scale.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -12,6 +13,10 @@ void config_defaults(struct Config *cfg)
     memset(cfg, 0, sizeof(*cfg));
     strncpy(cfg->model, "claude-sonnet-4-6", CONFIG_MAX_MODEL_LEN - 1);
     cfg->max_tokens = 1024;
+    cfg->short_limit = 200;
+    cfg->png_level = 3;
+    cfg->image_max_edge = IMAGE_DEFAULT_MAX_EDGE;
+    cfg->image_max_pixels = IMAGE_DEFAULT_MAX_PIXELS;
     cfg->system_prompt[0] = '\0';
     cfg->api_key[0] = '\0';
 }
@@ -68,6 +73,9 @@ int config_load(struct Config *cfg)
     read_file_string(CONFIG_DIR_ENV "/api_key", cfg->api_key, CONFIG_MAX_KEY_LEN);
     read_file_string(CONFIG_DIR_ENV "/model", cfg->model, CONFIG_MAX_MODEL_LEN);
     read_file_string(CONFIG_DIR_ENV "/system_prompt", cfg->system_prompt, CONFIG_MAX_PROMPT_LEN);
+    read_file_string(CONFIG_DIR_ENV "/api_host", cfg->api_host, CONFIG_MAX_HOST_LEN);
+    read_file_string(CONFIG_DIR_ENV "/tool_model", cfg->tool_model, CONFIG_MAX_MODEL_LEN);
+    read_file_string(CONFIG_DIR_ENV "/short_model", cfg->short_model, CONFIG_MAX_MODEL_LEN);
 
     if (read_file_string(CONFIG_DIR_ENV "/max_tokens", buf, sizeof(buf))) {
         int val = atoi(buf);
@@ -75,6 +83,42 @@ int config_load(struct Config *cfg)
             cfg->max_tokens = val;
     }
 
+    if (read_file_string(CONFIG_DIR_ENV "/files_api", buf, sizeof(buf)))
+        cfg->files_api = atoi(buf) != 0;
+
+    if (read_file_string(CONFIG_DIR_ENV "/stream", buf, sizeof(buf)))
+        cfg->stream = atoi(buf) != 0;
+
+    if (read_file_string(CONFIG_DIR_ENV "/short_limit", buf, sizeof(buf))) {
+        int val = atoi(buf);
+        if (val > 0)
+            cfg->short_limit = val;
+    }
+
+    if (read_file_string(CONFIG_DIR_ENV "/cache_size", buf, sizeof(buf))) {
+        int val = atoi(buf);
+        if (val > 0)
+            cfg->cache_size = val;
+    }
+
+    if (read_file_string(CONFIG_DIR_ENV "/png_level", buf, sizeof(buf))) {
+        int val = atoi(buf);
+        if (val >= 0 && val <= 9)
+            cfg->png_level = val;
+    }
+
+    if (read_file_string(CONFIG_DIR_ENV "/image_max_edge", buf, sizeof(buf))) {
+        int val = atoi(buf);
+        if (val >= 0)
+            cfg->image_max_edge = val;
+    }
+
+    if (read_file_string(CONFIG_DIR_ENV "/image_max_pixels", buf, sizeof(buf))) {
+        int val = atoi(buf);
+        if (val >= 0)
+            cfg->image_max_pixels = val;
+    }
+
     /* Check if we have an API key */
     return cfg->api_key[0] != '\0';
 }
@@ -106,6 +150,53 @@ static int save_to_dir(const struct Config *cfg, const char *dir)
         write_file_string(path, cfg->system_prompt);
     }
 
+    if (cfg->api_host[0]) {
+        snprintf(path, sizeof(path), "%s/api_host", dir);
+        write_file_string(path, cfg->api_host);
+    }
+
+    if (cfg->files_api) {
+        snprintf(path, sizeof(path), "%s/files_api", dir);
+        write_file_int(path, cfg->files_api);
+    }
+
+    if (cfg->stream) {
+        snprintf(path, sizeof(path), "%s/stream", dir);
+        write_file_int(path, cfg->stream);
+    }
+
+    if (cfg->tool_model[0]) {
+        snprintf(path, sizeof(path), "%s/tool_model", dir);
+        write_file_string(path, cfg->tool_model);
+    }
+
+    if (cfg->short_model[0]) {
+        snprintf(path, sizeof(path), "%s/short_model", dir);
+        write_file_string(path, cfg->short_model);
+        snprintf(path, sizeof(path), "%s/short_limit", dir);
+        write_file_int(path, cfg->short_limit);
+    }
+
+    if (cfg->cache_size) {
+        snprintf(path, sizeof(path), "%s/cache_size", dir);
+        write_file_int(path, cfg->cache_size);
+    }
+
+    if (cfg->png_level != 3) {
+        snprintf(path, sizeof(path), "%s/png_level", dir);
+        write_file_int(path, cfg->png_level);
+    }
+
+    if (cfg->image_max_edge != IMAGE_DEFAULT_MAX_EDGE) {
+        snprintf(path, sizeof(path), "%s/image_max_edge", dir);
+        write_file_int(path, cfg->image_max_edge);
+    }
+
+    if (cfg->image_max_pixels != (int)IMAGE_DEFAULT_MAX_PIXELS) {
+        snprintf(path, sizeof(path), "%s/image_max_pixels", dir);
+        write_file_int(path, cfg->image_max_pixels);
+    }
+
     return 1;
 }
 
@@ -7,12 +7,23 @@
 #define CONFIG_MAX_KEY_LEN     128
 #define CONFIG_MAX_MODEL_LEN    64
 #define CONFIG_MAX_PROMPT_LEN 2048
+#define CONFIG_MAX_HOST_LEN    128
 
 struct Config {
     char api_key[CONFIG_MAX_KEY_LEN];
     char model[CONFIG_MAX_MODEL_LEN];
     char system_prompt[CONFIG_MAX_PROMPT_LEN];
     int  max_tokens;
+    char api_host[CONFIG_MAX_HOST_LEN];  /* "[http://]host[:port]", empty = default API */
+    int  files_api;                      /* Upload images via the Files API (0/1) */
+    int  cache_size;                     /* Response cache limit in KB, 0 = off */
+    int  stream;                         /* Streamed responses (0/1) */
+    char tool_model[CONFIG_MAX_MODEL_LEN];  /* Tool continuation calls, empty = model */
+    char short_model[CONFIG_MAX_MODEL_LEN]; /* Short queries, empty = model */
+    int  short_limit;                    /* Max chars of a "short" query */
+    int  png_level;                      /* PNG deflate level 0-9 */
+    int  image_max_edge;                 /* Longest image side sent, 0 = any */
+    int  image_max_pixels;               /* Most image pixels sent, 0 = any */
 };
 
 /* Load config from ENV:AmigaAI/ */
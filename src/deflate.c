@@ -0,0 +1,886 @@
+/*
+ * deflate.c - Deflate compressor (zlib format) for AmigaAI
+ *
+ * A small, self-contained encoder for the PNG writer, so screenshots
+ * and converted pictures are compressed without a zlib dependency.
+ *
+ * LZ77 matches are found through hash chains over a 32 KB sliding
+ * window (greedy matching at low levels, lazy matching above level 3,
+ * with zlib's chain and length limits per level). Each block is sent
+ * stored, with the fixed Huffman codes or with dynamic codes built for
+ * that block, whichever is smallest.
+ *
+ * Memory: one allocation of about 250 KB per stream.
+ */
+
+#include "deflate.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WSIZE         32768U
+#define WMASK         (WSIZE - 1)
+#define HASH_BITS     15
+#define HASH_SIZE     (1U << HASH_BITS)
+#define HASH_MASK     (HASH_SIZE - 1)
+#define MIN_MATCH     3
+#define MAX_MATCH     258
+#define MIN_LOOKAHEAD (MAX_MATCH + MIN_MATCH + 1)
+#define MAX_DIST      (WSIZE - MIN_LOOKAHEAD)
+#define TOO_FAR       4096      /* 3-byte matches further away cost more than literals */
+#define NIL           0
+
+#define LIT_BUFSIZE   16384     /* symbols per block */
+#define OUT_BUFSIZE   4096
+
+#define END_BLOCK     256
+#define L_CODES       286
+#define D_CODES       30
+#define BL_CODES      19
+#define MAX_BITS      15
+#define MAX_BL_BITS   7
+
+#define ADLER_BASE    65521
+
+/* Per-level search limits (zlib's table). For the greedy levels,
+ * "lazy" is the longest match whose strings are all entered into the
+ * hash chains. */
+static const struct {
+    unsigned short good;    /* shorten the search above this length */
+    unsigned short lazy;    /* don't look for a better match above this */
+    unsigned short nice;    /* stop searching at this length */
+    unsigned short chain;   /* hash chain entries to try */
+} level_table[DEFLATE_MAX_LEVEL + 1] = {
+    {  0,   0,   0,    0 },     /* 0: stored */
+    {  4,   4,   8,    4 },     /* 1-3: greedy */
+    {  4,   5,  16,    8 },
+    {  4,   6,  32,   32 },
+    {  4,   4,  16,   16 },     /* 4-9: lazy */
+    {  8,  16,  32,   32 },
+    {  8,  16, 128,  128 },
+    {  8,  32, 128,  256 },
+    { 32, 128, 258, 1024 },
+    { 32, 258, 258, 4096 }
+};
+
+static const unsigned char extra_lbits[29] = {
+    0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0
+};
+static const unsigned char extra_dbits[D_CODES] = {
+    0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13
+};
+static const unsigned char extra_blbits[BL_CODES] = {
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,2,3,7
+};
+static const unsigned char bl_order[BL_CODES] = {
+    16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15
+};
+
+/* Length and distance code lookup, and the fixed Huffman code */
+static unsigned char  length_code[256];     /* match length - 3 */
+static unsigned char  base_length[29];
+static unsigned char  dist_code[512];       /* see D_CODE() */
+static unsigned short base_dist[D_CODES];
+static unsigned char  fixed_llens[L_CODES + 2];
+static unsigned short fixed_lcodes[L_CODES + 2];
+static unsigned char  fixed_dlens[D_CODES];
+static unsigned short fixed_dcodes[D_CODES];
+static int            tables_ready;
+
+/* Code of distance - 1 */
+#define D_CODE(d) ((d) < 256 ? dist_code[d] : dist_code[256 + ((d) >> 7)])
+
+struct Deflate {
+    DeflateSink    sink;
+    void          *userdata;
+    int            failed;
+    long           total_out;
+
+    int            level;
+    unsigned       good_length, max_lazy, nice_length, max_chain;
+    unsigned long  adler;
+
+    /* LZ77 state; window positions, with strstart the next byte */
+    long           block_start;     /* < 0 once the block start has slid out */
+    unsigned       strstart, lookahead;
+    unsigned       match_start, match_length, prev_length;
+    int            match_available;
+
+    /* Symbols of the current block: distance 0 means a literal */
+    unsigned       sym_count;
+    unsigned int   lit_freq[L_CODES];
+    unsigned int   dist_freq[D_CODES];
+
+    unsigned long  bitbuf;
+    int            bitcount;
+    int            out_used;
+
+    unsigned short d_buf[LIT_BUFSIZE];
+    unsigned char  l_buf[LIT_BUFSIZE];
+    unsigned short head[HASH_SIZE];
+    unsigned short prev[WSIZE];
+    unsigned char  out[OUT_BUFSIZE];
+    unsigned char  window[2 * WSIZE + MAX_MATCH];
+};
+
+/* ===================== Tables ===================== */
+
+static unsigned reverse_bits(unsigned code, int len)
+{
+    unsigned res = 0;
+
+    while (len-- > 0) {
+        res = (res << 1) | (code & 1);
+        code >>= 1;
+    }
+    return res;
+}
+
+/* Canonical Huffman codes for the given lengths, bit-reversed for
+ * LSB-first output */
+static void gen_codes(const unsigned char *lens, int n, unsigned short *codes)
+{
+    unsigned count[MAX_BITS + 1], next[MAX_BITS + 1], code = 0;
+    int i;
+
+    memset(count, 0, sizeof(count));
+    for (i = 0; i < n; i++)
+        count[lens[i]]++;
+    count[0] = 0;
+    for (i = 1; i <= MAX_BITS; i++) {
+        code = (code + count[i - 1]) << 1;
+        next[i] = code;
+    }
+    for (i = 0; i < n; i++)
+        codes[i] = lens[i] ? (unsigned short)reverse_bits(next[lens[i]]++, lens[i]) : 0;
+}
+
+static void init_tables(void)
+{
+    int code, n, length = 0, dist = 0;
+
+    for (code = 0; code < 28; code++) {
+        base_length[code] = (unsigned char)length;
+        for (n = 0; n < (1 << extra_lbits[code]); n++)
+            length_code[length++] = (unsigned char)code;
+    }
+    /* Length 258 has its own code rather than 284 with extra bits */
+    base_length[28] = 255;
+    length_code[255] = 28;
+
+    for (code = 0; code < 16; code++) {
+        base_dist[code] = (unsigned short)dist;
+        for (n = 0; n < (1 << extra_dbits[code]); n++)
+            dist_code[dist++] = (unsigned char)code;
+    }
+    dist >>= 7;
+    for (; code < D_CODES; code++) {
+        base_dist[code] = (unsigned short)(dist << 7);
+        for (n = 0; n < (1 << (extra_dbits[code] - 7)); n++)
+            dist_code[256 + dist++] = (unsigned char)code;
+    }
+
+    for (n = 0; n < L_CODES + 2; n++)
+        fixed_llens[n] = n < 144 ? 8 : n < 256 ? 9 : n < 280 ? 7 : 8;
+    gen_codes(fixed_llens, L_CODES + 2, fixed_lcodes);
+    for (n = 0; n < D_CODES; n++)
+        fixed_dlens[n] = 5;
+    gen_codes(fixed_dlens, D_CODES, fixed_dcodes);
+
+    tables_ready = 1;
+}
+
+/* ===================== Huffman code lengths ===================== */
+
+struct SymFreq {
+    unsigned int   key;
+    unsigned short sym;
+};
+
+/* Moffat and Katajainen's in-place minimum-redundancy code: a[] sorted
+ * by ascending frequency on entry, code lengths in key on return */
+static void min_redundancy(struct SymFreq *a, int n)
+{
+    int root, leaf, next, avbl, used, depth;
+
+    a[0].key += a[1].key;
+    root = 0;
+    leaf = 2;
+    for (next = 1; next < n - 1; next++) {
+        if (leaf >= n || a[root].key < a[leaf].key) {
+            a[next].key = a[root].key;
+            a[root++].key = (unsigned int)next;
+        } else {
+            a[next].key = a[leaf++].key;
+        }
+        if (leaf >= n || (root < next && a[root].key < a[leaf].key)) {
+            a[next].key += a[root].key;
+            a[root++].key = (unsigned int)next;
+        } else {
+            a[next].key += a[leaf++].key;
+        }
+    }
+
+    a[n - 2].key = 0;
+    for (next = n - 3; next >= 0; next--)
+        a[next].key = a[a[next].key].key + 1;
+
+    avbl = 1;
+    used = depth = 0;
+    root = n - 2;
+    next = n - 1;
+    while (avbl > 0) {
+        while (root >= 0 && (int)a[root].key == depth) {
+            used++;
+            root--;
+        }
+        while (avbl > used) {
+            a[next--].key = (unsigned int)depth;
+            avbl--;
+        }
+        avbl = 2 * used;
+        depth++;
+        used = 0;
+    }
+}
+
+/* Code lengths of at most max_bits for n symbols. At least two
+ * symbols always get a code, which keeps every code complete. */
+static void build_lengths(const unsigned int *freq, int n, int max_bits,
+                          unsigned char *lens)
+{
+    struct SymFreq syms[L_CODES];
+    unsigned count[32];
+    unsigned long total = 0;
+    int used = 0, i, j;
+
+    for (i = 0; i < n; i++) {
+        if (freq[i]) {
+            syms[used].key = freq[i];
+            syms[used].sym = (unsigned short)i;
+            used++;
+        }
+    }
+    for (i = 0; used < 2; i++) {
+        if (!freq[i]) {
+            syms[used].key = 1;
+            syms[used].sym = (unsigned short)i;
+            used++;
+        }
+    }
+
+    /* Insertion sort: at most 286 symbols, mostly few distinct ones */
+    for (i = 1; i < used; i++) {
+        struct SymFreq s = syms[i];
+        for (j = i; j > 0 && syms[j - 1].key > s.key; j--)
+            syms[j] = syms[j - 1];
+        syms[j] = s;
+    }
+
+    min_redundancy(syms, used);
+
+    /* Limit the lengths: move overlong codes to max_bits, then lengthen
+     * shorter codes until the code is complete again */
+    memset(count, 0, sizeof(count));
+    for (i = 0; i < used; i++)
+        count[syms[i].key < (unsigned)max_bits ? syms[i].key : (unsigned)max_bits]++;
+    for (i = max_bits; i > 0; i--)
+        total += (unsigned long)count[i] << (max_bits - i);
+    while (total != 1UL << max_bits) {
+        count[max_bits]--;
+        for (i = max_bits - 1; i > 0; i--) {
+            if (count[i]) {
+                count[i]--;
+                count[i + 1] += 2;
+                break;
+            }
+        }
+        total--;
+    }
+
+    /* Shortest codes for the most frequent symbols */
+    memset(lens, 0, (size_t)n);
+    for (i = 1, j = used; i <= max_bits; i++) {
+        unsigned k;
+        for (k = count[i]; k > 0; k--)
+            lens[syms[--j].sym] = (unsigned char)i;
+    }
+}
+
+/* ===================== Bit output ===================== */
+
+static void flush_out(struct Deflate *z)
+{
+    if (z->out_used > 0 && !z->failed &&
+        z->sink(z->out, z->out_used, z->userdata) != 0)
+        z->failed = 1;
+    z->total_out += z->out_used;
+    z->out_used = 0;
+}
+
+static void put_byte(struct Deflate *z, unsigned c)
+{
+    z->out[z->out_used++] = (unsigned char)c;
+    if (z->out_used == OUT_BUFSIZE)
+        flush_out(z);
+}
+
+static void put_bits(struct Deflate *z, unsigned value, int len)
+{
+    z->bitbuf |= (unsigned long)value << z->bitcount;
+    z->bitcount += len;
+    while (z->bitcount >= 8) {
+        put_byte(z, (unsigned)(z->bitbuf & 0xFF));
+        z->bitbuf >>= 8;
+        z->bitcount -= 8;
+    }
+}
+
+static void align_bits(struct Deflate *z)
+{
+    if (z->bitcount > 0)
+        put_byte(z, (unsigned)(z->bitbuf & 0xFF));
+    z->bitbuf = 0;
+    z->bitcount = 0;
+}
+
+/* ===================== Blocks ===================== */
+
+static void send_stored(struct Deflate *z, const unsigned char *data,
+                        unsigned long len, int last)
+{
+    do {
+        unsigned n = len > 65535 ? 65535 : (unsigned)len;
+        unsigned i = 0;
+
+        put_bits(z, (last && n == len) ? 1 : 0, 3);
+        align_bits(z);
+        put_byte(z, n & 0xFF);
+        put_byte(z, n >> 8);
+        put_byte(z, ~n & 0xFF);
+        put_byte(z, (~n >> 8) & 0xFF);
+
+        while (i < n) {
+            unsigned room = OUT_BUFSIZE - (unsigned)z->out_used;
+            if (room > n - i)
+                room = n - i;
+            memcpy(z->out + z->out_used, data + i, room);
+            z->out_used += (int)room;
+            i += room;
+            if (z->out_used == OUT_BUFSIZE)
+                flush_out(z);
+        }
+        data += n;
+        len -= n;
+    } while (len > 0);
+}
+
+static void send_symbols(struct Deflate *z,
+                         const unsigned short *lcodes, const unsigned char *llens,
+                         const unsigned short *dcodes, const unsigned char *dlens)
+{
+    unsigned i;
+
+    for (i = 0; i < z->sym_count; i++) {
+        unsigned dist = z->d_buf[i], lc = z->l_buf[i], code;
+
+        if (dist == 0) {
+            put_bits(z, lcodes[lc], llens[lc]);
+            continue;
+        }
+
+        code = length_code[lc];
+        put_bits(z, lcodes[code + 257], llens[code + 257]);
+        if (extra_lbits[code])
+            put_bits(z, lc - base_length[code], extra_lbits[code]);
+
+        dist--;
+        code = D_CODE(dist);
+        put_bits(z, dcodes[code], dlens[code]);
+        if (extra_dbits[code])
+            put_bits(z, dist - base_dist[code], extra_dbits[code]);
+    }
+
+    put_bits(z, lcodes[END_BLOCK], llens[END_BLOCK]);
+}
+
+/* Bits needed for the block's symbols with the given code lengths */
+static unsigned long data_bits(const struct Deflate *z,
+                               const unsigned char *llens, const unsigned char *dlens)
+{
+    unsigned long bits = 0;
+    int i;
+
+    for (i = 0; i < L_CODES; i++)
+        bits += (unsigned long)z->lit_freq[i] * llens[i];
+    for (i = 0; i < 29; i++)
+        bits += (unsigned long)z->lit_freq[257 + i] * extra_lbits[i];
+    for (i = 0; i < D_CODES; i++)
+        bits += (unsigned long)z->dist_freq[i] * (dlens[i] + extra_dbits[i]);
+    return bits;
+}
+
+/* Run-length code a list of code lengths (RFC 1951 3.2.7) */
+static int rle_lengths(const unsigned char *lens, int n,
+                       unsigned char *sym, unsigned char *extra, int count)
+{
+    int i = 0;
+
+    while (i < n) {
+        int cur = lens[i], run = 1;
+
+        while (i + run < n && lens[i + run] == cur)
+            run++;
+        i += run;
+
+        if (cur == 0) {
+            while (run >= 11) {
+                int r = run > 138 ? 138 : run;
+                sym[count] = 18;
+                extra[count++] = (unsigned char)(r - 11);
+                run -= r;
+            }
+            if (run >= 3) {
+                sym[count] = 17;
+                extra[count++] = (unsigned char)(run - 3);
+                run = 0;
+            }
+        } else {
+            sym[count] = (unsigned char)cur;
+            extra[count++] = 0;
+            run--;
+            while (run >= 3) {
+                int r = run > 6 ? 6 : run;
+                sym[count] = 16;
+                extra[count++] = (unsigned char)(r - 3);
+                run -= r;
+            }
+        }
+        while (run-- > 0) {
+            sym[count] = (unsigned char)cur;
+            extra[count++] = 0;
+        }
+    }
+
+    return count;
+}
+
+/* End the current block, choosing the smallest encoding */
+static void flush_block(struct Deflate *z, int last)
+{
+    unsigned char llens[L_CODES], dlens[D_CODES], bllens[BL_CODES];
+    unsigned short lcodes[L_CODES], dcodes[D_CODES], blcodes[BL_CODES];
+    unsigned char rle_sym[L_CODES + D_CODES], rle_extra[L_CODES + D_CODES];
+    unsigned int bl_freq[BL_CODES];
+    unsigned long dyn_bits, fixed_bits, stored_bits = 0;
+    unsigned long stored_len = 0;
+    int hlit, hdist, hclen, nrle, i;
+
+    if (z->block_start >= 0) {
+        stored_len = z->strstart - (unsigned long)z->block_start;
+        stored_bits = (stored_len + 5 * (stored_len / 65535 + 1)) * 8 + 10;
+    }
+
+    if (z->level == 0) {
+        send_stored(z, z->window + z->block_start, stored_len, last);
+        goto done;
+    }
+
+    z->lit_freq[END_BLOCK] = 1;
+    build_lengths(z->lit_freq, L_CODES, MAX_BITS, llens);
+    build_lengths(z->dist_freq, D_CODES, MAX_BITS, dlens);
+
+    for (hlit = L_CODES; hlit > 257 && !llens[hlit - 1]; hlit--)
+        ;
+    for (hdist = D_CODES; hdist > 1 && !dlens[hdist - 1]; hdist--)
+        ;
+    nrle = rle_lengths(llens, hlit, rle_sym, rle_extra, 0);
+    nrle = rle_lengths(dlens, hdist, rle_sym, rle_extra, nrle);
+
+    memset(bl_freq, 0, sizeof(bl_freq));
+    for (i = 0; i < nrle; i++)
+        bl_freq[rle_sym[i]]++;
+    build_lengths(bl_freq, BL_CODES, MAX_BL_BITS, bllens);
+    for (hclen = BL_CODES; hclen > 4 && !bllens[bl_order[hclen - 1]]; hclen--)
+        ;
+
+    dyn_bits = 3 + 14 + 3 * (unsigned long)hclen + data_bits(z, llens, dlens);
+    for (i = 0; i < nrle; i++)
+        dyn_bits += bllens[rle_sym[i]] + extra_blbits[rle_sym[i]];
+    fixed_bits = 3 + data_bits(z, fixed_llens, fixed_dlens);
+
+    if (z->block_start >= 0 && stored_bits <= dyn_bits && stored_bits <= fixed_bits) {
+        send_stored(z, z->window + z->block_start, stored_len, last);
+    } else if (fixed_bits <= dyn_bits) {
+        put_bits(z, (1 << 1) | (last ? 1 : 0), 3);
+        send_symbols(z, fixed_lcodes, fixed_llens, fixed_dcodes, fixed_dlens);
+    } else {
+        gen_codes(llens, L_CODES, lcodes);
+        gen_codes(dlens, D_CODES, dcodes);
+        gen_codes(bllens, BL_CODES, blcodes);
+
+        put_bits(z, (2 << 1) | (last ? 1 : 0), 3);
+        put_bits(z, (unsigned)(hlit - 257), 5);
+        put_bits(z, (unsigned)(hdist - 1), 5);
+        put_bits(z, (unsigned)(hclen - 4), 4);
+        for (i = 0; i < hclen; i++)
+            put_bits(z, bllens[bl_order[i]], 3);
+        for (i = 0; i < nrle; i++) {
+            put_bits(z, blcodes[rle_sym[i]], bllens[rle_sym[i]]);
+            if (rle_sym[i] >= 16)
+                put_bits(z, rle_extra[i], extra_blbits[rle_sym[i]]);
+        }
+        send_symbols(z, lcodes, llens, dcodes, dlens);
+    }
+
+done:
+    memset(z->lit_freq, 0, sizeof(z->lit_freq));
+    memset(z->dist_freq, 0, sizeof(z->dist_freq));
+    z->sym_count = 0;
+    z->block_start = (long)z->strstart;
+}
+
+/* Record a literal (dist 0) or a match; returns non-zero when the
+ * block is full */
+static int tally(struct Deflate *z, unsigned dist, unsigned lc)
+{
+    z->d_buf[z->sym_count] = (unsigned short)dist;
+    z->l_buf[z->sym_count++] = (unsigned char)lc;
+    if (dist == 0) {
+        z->lit_freq[lc]++;
+    } else {
+        dist--;
+        z->lit_freq[length_code[lc] + 257]++;
+        z->dist_freq[D_CODE(dist)]++;
+    }
+    return z->sym_count == LIT_BUFSIZE - 1;
+}
+
+/* ===================== LZ77 ===================== */
+
+/* zlib's hash of the 3 bytes at pos: each byte shifted by 5 bits, so
+ * the small values of pen data (0-15) never collide */
+static unsigned insert_string(struct Deflate *z, unsigned pos)
+{
+    const unsigned char *p = z->window + pos;
+    unsigned h = (((unsigned)p[0] << 10) ^ ((unsigned)p[1] << 5) ^ p[2]) & HASH_MASK;
+    unsigned match = z->head[h];
+
+    z->prev[pos & WMASK] = (unsigned short)match;
+    z->head[h] = (unsigned short)pos;
+    return match;
+}
+
+static unsigned longest_match(struct Deflate *z, unsigned cur_match)
+{
+    const unsigned char *scan = z->window + z->strstart;
+    const unsigned char *strend = scan + MAX_MATCH;
+    unsigned chain = z->max_chain;
+    unsigned best_len = z->prev_length;
+    unsigned nice = z->nice_length;
+    unsigned limit = z->strstart > MAX_DIST ? z->strstart - MAX_DIST : NIL;
+    unsigned char scan_end1 = scan[best_len - 1];
+    unsigned char scan_end = scan[best_len];
+
+    if (z->prev_length >= z->good_length)
+        chain >>= 2;
+    if (nice > z->lookahead)
+        nice = z->lookahead;
+
+    do {
+        const unsigned char *match = z->window + cur_match;
+        const unsigned char *s, *m;
+        unsigned len;
+
+        if (match[best_len] != scan_end || match[best_len - 1] != scan_end1 ||
+            match[0] != scan[0] || match[1] != scan[1])
+            continue;
+
+        s = scan + 2;
+        m = match + 2;
+        while (s < strend && *s == *m) {
+            s++;
+            m++;
+        }
+        len = (unsigned)(s - scan);
+
+        if (len > best_len) {
+            z->match_start = cur_match;
+            best_len = len;
+            if (len >= nice)
+                break;
+            scan_end1 = scan[best_len - 1];
+            scan_end = scan[best_len];
+        }
+    } while ((cur_match = z->prev[cur_match & WMASK]) > limit && --chain != 0);
+
+    return best_len <= z->lookahead ? best_len : z->lookahead;
+}
+
+/* Move the upper half of the window down; hash entries that fall out
+ * of the window become NIL */
+static void slide_window(struct Deflate *z)
+{
+    unsigned i;
+
+    memcpy(z->window, z->window + WSIZE, WSIZE);
+    z->strstart -= WSIZE;
+    z->match_start = z->match_start >= WSIZE ? z->match_start - WSIZE : 0;
+    z->block_start -= (long)WSIZE;
+
+    for (i = 0; i < HASH_SIZE; i++)
+        z->head[i] = (unsigned short)(z->head[i] >= WSIZE ? z->head[i] - WSIZE : NIL);
+    for (i = 0; i < WSIZE; i++)
+        z->prev[i] = (unsigned short)(z->prev[i] >= WSIZE ? z->prev[i] - WSIZE : NIL);
+}
+
+/* Level 0: stored blocks, emitted before their data can slide out */
+static void compress_stored(struct Deflate *z)
+{
+    z->strstart += z->lookahead;
+    z->lookahead = 0;
+    if ((long)z->strstart - z->block_start >= (long)MAX_DIST)
+        flush_block(z, 0);
+}
+
+/* Levels 1-3: take the first match found */
+static void compress_greedy(struct Deflate *z, int flush)
+{
+    for (;;) {
+        unsigned hash_head = NIL;
+
+        if (z->lookahead < MIN_LOOKAHEAD && (!flush || z->lookahead == 0))
+            return;
+
+        if (z->lookahead >= MIN_MATCH)
+            hash_head = insert_string(z, z->strstart);
+
+        z->match_length = MIN_MATCH - 1;
+        if (hash_head != NIL && z->strstart - hash_head <= MAX_DIST) {
+            z->prev_length = MIN_MATCH - 1;
+            z->match_length = longest_match(z, hash_head);
+        }
+
+        if (z->match_length >= MIN_MATCH) {
+            int full = tally(z, z->strstart - z->match_start,
+                             z->match_length - MIN_MATCH);
+
+            z->lookahead -= z->match_length;
+            if (z->match_length <= z->max_lazy && z->lookahead >= MIN_MATCH) {
+                z->match_length--;
+                do {
+                    z->strstart++;
+                    insert_string(z, z->strstart);
+                } while (--z->match_length != 0);
+                z->strstart++;
+            } else {
+                z->strstart += z->match_length;
+                z->match_length = 0;
+            }
+            if (full)
+                flush_block(z, 0);
+        } else {
+            int full = tally(z, 0, z->window[z->strstart]);
+
+            z->lookahead--;
+            z->strstart++;
+            if (full)
+                flush_block(z, 0);
+        }
+    }
+}
+
+/* Levels 4-9: a match is only taken if the next position has no
+ * longer one */
+static void compress_lazy(struct Deflate *z, int flush)
+{
+    for (;;) {
+        unsigned hash_head = NIL, prev_match;
+
+        if (z->lookahead < MIN_LOOKAHEAD && (!flush || z->lookahead == 0))
+            break;
+
+        if (z->lookahead >= MIN_MATCH)
+            hash_head = insert_string(z, z->strstart);
+
+        z->prev_length = z->match_length;
+        prev_match = z->match_start;
+        z->match_length = MIN_MATCH - 1;
+
+        if (hash_head != NIL && z->prev_length < z->max_lazy &&
+            z->strstart - hash_head <= MAX_DIST) {
+            z->match_length = longest_match(z, hash_head);
+            if (z->match_length == MIN_MATCH &&
+                z->strstart - z->match_start > TOO_FAR)
+                z->match_length = MIN_MATCH - 1;
+        }
+
+        if (z->prev_length >= MIN_MATCH && z->match_length <= z->prev_length) {
+            unsigned max_insert = z->strstart + z->lookahead - MIN_MATCH;
+            int full = tally(z, z->strstart - 1 - prev_match,
+                             z->prev_length - MIN_MATCH);
+
+            z->lookahead -= z->prev_length - 1;
+            z->prev_length -= 2;
+            do {
+                if (++z->strstart <= max_insert)
+                    insert_string(z, z->strstart);
+            } while (--z->prev_length != 0);
+            z->match_available = 0;
+            z->match_length = MIN_MATCH - 1;
+            z->strstart++;
+            if (full)
+                flush_block(z, 0);
+        } else if (z->match_available) {
+            if (tally(z, 0, z->window[z->strstart - 1]))
+                flush_block(z, 0);
+            z->strstart++;
+            z->lookahead--;
+        } else {
+            z->match_available = 1;
+            z->strstart++;
+            z->lookahead--;
+        }
+    }
+
+    if (flush && z->match_available) {
+        tally(z, 0, z->window[z->strstart - 1]);
+        z->match_available = 0;
+    }
+}
+
+static void compress(struct Deflate *z, int flush)
+{
+    if (z->level == 0)
+        compress_stored(z);
+    else if (z->level <= 3)
+        compress_greedy(z, flush);
+    else
+        compress_lazy(z, flush);
+}
+
+/* ===================== Adler-32 ===================== */
+
+/* Largest n such that 255n(n+1)/2 + (n+1)(BASE-1) fits in 32 bits:
+ * the sums can go that many bytes before they need reducing, so the
+ * two divisions are done once per 5552 bytes instead of per byte
+ * (a 68020 DIVU.L takes around 80 cycles) */
+#define ADLER_NMAX 5552
+
+#define ADLER_DO1(i)  a += buf[i]; b += a;
+#define ADLER_DO4(i)  ADLER_DO1(i) ADLER_DO1(i + 1) ADLER_DO1(i + 2) ADLER_DO1(i + 3)
+#define ADLER_DO16    ADLER_DO4(0) ADLER_DO4(4) ADLER_DO4(8) ADLER_DO4(12)
+
+static unsigned long adler32_update(unsigned long adler,
+                                    const unsigned char *buf, unsigned long len)
+{
+    unsigned long a = adler & 0xFFFF, b = adler >> 16;
+
+    while (len > 0) {
+        unsigned long n = len < ADLER_NMAX ? len : ADLER_NMAX;
+
+        len -= n;
+        while (n >= 16) {
+            ADLER_DO16
+            buf += 16;
+            n -= 16;
+        }
+        while (n--) {
+            a += *buf++;
+            b += a;
+        }
+        a %= ADLER_BASE;
+        b %= ADLER_BASE;
+    }
+    return ((b << 16) | a) & 0xFFFFFFFFUL;
+}
+
+/* ===================== Stream ===================== */
+
+struct Deflate *deflate_new(int level, DeflateSink sink, void *userdata)
+{
+    struct Deflate *z;
+    unsigned flg;
+
+    if (level < DEFLATE_MIN_LEVEL || level > DEFLATE_MAX_LEVEL)
+        level = DEFLATE_DEFAULT_LEVEL;
+
+    z = malloc(sizeof(*z));
+    if (!z)
+        return NULL;
+    if (!tables_ready)
+        init_tables();
+
+    memset(z, 0, offsetof(struct Deflate, d_buf));
+    memset(z->head, 0, sizeof(z->head));
+    memset(z->prev, 0, sizeof(z->prev));
+    memset(z->window, 0, sizeof(z->window));
+    z->sink = sink;
+    z->userdata = userdata;
+    z->level = level;
+    z->good_length = level_table[level].good;
+    z->max_lazy = level_table[level].lazy;
+    z->nice_length = level_table[level].nice;
+    z->max_chain = level_table[level].chain;
+    z->adler = 1;
+    z->match_length = MIN_MATCH - 1;
+
+    /* zlib header: deflate, 32K window, level hint, check bits */
+    flg = (level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3) << 6;
+    flg += 31 - (0x7800 + flg) % 31;
+    z->out[0] = 0x78;
+    z->out[1] = (unsigned char)flg;
+    z->out_used = 2;
+
+    return z;
+}
+
+int deflate_write(struct Deflate *z, const unsigned char *data, long len)
+{
+    while (len > 0 && !z->failed) {
+        unsigned room;
+
+        if (z->strstart >= WSIZE + MAX_DIST)
+            slide_window(z);
+
+        room = 2 * WSIZE - (z->strstart + z->lookahead);
+        if ((unsigned long)len < room)
+            room = (unsigned)len;
+
+        memcpy(z->window + z->strstart + z->lookahead, data, room);
+        z->adler = adler32_update(z->adler, data, room);
+        z->lookahead += room;
+        data += room;
+        len -= (long)room;
+
+        compress(z, 0);
+    }
+
+    return z->failed ? -1 : 0;
+}
+
+int deflate_finish(struct Deflate *z)
+{
+    compress(z, 1);
+    flush_block(z, 1);
+    align_bits(z);
+
+    put_byte(z, (unsigned)(z->adler >> 24) & 0xFF);
+    put_byte(z, (unsigned)(z->adler >> 16) & 0xFF);
+    put_byte(z, (unsigned)(z->adler >> 8) & 0xFF);
+    put_byte(z, (unsigned)z->adler & 0xFF);
+    flush_out(z);
+
+    return z->failed ? -1 : 0;
+}
+
+long deflate_total_out(const struct Deflate *z)
+{
+    return z->total_out + z->out_used;
+}
+
+void deflate_free(struct Deflate *z)
+{
+    free(z);
+}
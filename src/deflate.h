@@ -0,0 +1,37 @@
+#ifndef AMIGAAI_DEFLATE_H
+#define AMIGAAI_DEFLATE_H
+
+/* Compression levels, as in zlib:
+ *   0     stored blocks only (no compression)
+ *   1-3   greedy matching, short hash chains (68020/68030)
+ *   4-6   lazy matching (68040)
+ *   7-9   lazy matching, long chains (68060, emulators)
+ * Screens with large flat areas compress well even at level 1. */
+#define DEFLATE_MIN_LEVEL     0
+#define DEFLATE_MAX_LEVEL     9
+#define DEFLATE_DEFAULT_LEVEL 3
+
+/* Receives compressed output in pieces of up to a few KB.
+ * Return non-zero to stop. */
+typedef int (*DeflateSink)(const unsigned char *data, long len, void *userdata);
+
+struct Deflate;
+
+/* Start a zlib stream (RFC 1950/1951). The zlib header is written
+ * with the first output. Returns NULL if out of memory (about 200 KB
+ * are needed). */
+struct Deflate *deflate_new(int level, DeflateSink sink, void *userdata);
+
+/* Compress len more bytes. Returns 0, or -1 once the sink has failed. */
+int deflate_write(struct Deflate *z, const unsigned char *data, long len);
+
+/* Compress what is left, end the stream with the Adler-32 checksum and
+ * hand all output to the sink. Returns 0 or -1. */
+int deflate_finish(struct Deflate *z);
+
+/* Compressed bytes produced so far */
+long deflate_total_out(const struct Deflate *z);
+
+void deflate_free(struct Deflate *z);
+
+#endif /* AMIGAAI_DEFLATE_H */
@@ -175,10 +175,141 @@ static int tcp_connect(const char *host, int port)
     return sock;
 }
 
-/* Read all data from SSL connection into a dynamically growing buffer.
+/* Incremental body delivery for http_request_stream() */
+enum { CHUNK_SIZE, CHUNK_DATA, CHUNK_TRAILER, CHUNK_DONE };
+
+struct HttpStream {
+    HttpDataCallback cb;
+    void *userdata;
+    FILE *log;          /* API log, body logged as it arrives */
+    long  body_pos;     /* Offset of the body in the raw buffer, 0 = in headers */
+    long  fed;          /* Raw bytes consumed so far */
+    int   active;       /* 2xx response: deliver body to cb */
+    int   chunked;
+    int   chunk_state;
+    int   chunk_ext;    /* Skipping a chunk extension */
+    long  chunk_left;
+};
+
+static int parse_status_code(const char *response);
+static int is_chunked(const char *response);
+
+/* Remove chunked transfer encoding from newly received bytes and pass
+ * the payload on. State carries over between calls, so chunk headers
+ * may be split across reads. Returns non-zero if the callback aborts. */
+static int stream_dechunk(struct HttpStream *st, const char *p, long len)
+{
+    const char *end = p + len;
+
+    while (p < end && st->chunk_state != CHUNK_DONE) {
+        switch (st->chunk_state) {
+        case CHUNK_SIZE:
+            /* Hex size, optional ";extension", CRLF */
+            for (; p < end && *p != '\n'; p++) {
+                int c = *p;
+                if (st->chunk_ext) continue;
+                if (c >= '0' && c <= '9')
+                    st->chunk_left = st->chunk_left * 16 + (c - '0');
+                else if (c >= 'a' && c <= 'f')
+                    st->chunk_left = st->chunk_left * 16 + (c - 'a' + 10);
+                else if (c >= 'A' && c <= 'F')
+                    st->chunk_left = st->chunk_left * 16 + (c - 'A' + 10);
+                else
+                    st->chunk_ext = 1;
+            }
+            if (p == end) break;
+            p++;
+            st->chunk_ext = 0;
+            st->chunk_state = st->chunk_left ? CHUNK_DATA : CHUNK_DONE;
+            break;
+
+        case CHUNK_DATA: {
+            long n = end - p < st->chunk_left ? end - p : st->chunk_left;
+            if (st->cb(p, n, st->userdata))
+                return 1;
+            p += n;
+            st->chunk_left -= n;
+            if (st->chunk_left == 0)
+                st->chunk_state = CHUNK_TRAILER;
+            break;
+        }
+
+        case CHUNK_TRAILER:
+            /* CRLF after the chunk data */
+            for (; p < end && *p != '\n'; p++)
+                ;
+            if (p == end) break;
+            p++;
+            st->chunk_state = CHUNK_SIZE;
+            st->chunk_left = 0;
+            break;
+        }
+    }
+
+    return 0;
+}
+
+/* Pass newly read bytes of buf[0..total) to the stream callback.
+ * buf must be NUL-terminated at total. Returns non-zero to abort. */
+static int stream_feed(struct HttpStream *st, char *buf, long total)
+{
+    long n;
+
+    if (!st->body_pos) {
+        char *hdr_end = strstr(buf, "\r\n\r\n");
+        if (!hdr_end) return 0;
+
+        st->body_pos = hdr_end + 4 - buf;
+        st->fed = st->body_pos;
+
+        /* Only look at the header block */
+        *hdr_end = '\0';
+        st->active  = parse_status_code(buf) / 100 == 2;
+        st->chunked = is_chunked(buf);
+        *hdr_end = '\r';
+    }
+
+    n = total - st->fed;
+    if (!st->active || n <= 0) return 0;
+
+    st->fed = total;
+    if (st->log)
+        fwrite(buf + total - n, 1, n, st->log);
+    if (st->chunked)
+        return stream_dechunk(st, buf + total - n, n);
+    return st->cb(buf + total - n, n, st->userdata);
+}
+
+/* Why conn_read_all() gave up */
+enum { READ_OK, READ_ABORTED, READ_STREAM_FAILED };
+
+/* Pass what was just read to the stream, if any. Body bytes it has
+ * taken are dropped from buf, so a streamed 2xx response never piles
+ * up in memory: buf keeps only the header block. Returns non-zero if
+ * the stream callback failed. */
+static int stream_take(struct HttpStream *stream, char *buf, long *total)
+{
+    if (!stream) return 0;
+
+    buf[*total] = '\0';
+    if (stream_feed(stream, buf, *total))
+        return 1;
+    if (stream->active) {
+        *total = stream->body_pos;
+        stream->fed = stream->body_pos;
+    }
+    return 0;
+}
+
+/* Read all data from the connection into a dynamically growing buffer.
+ * ssl may be NULL for plain HTTP connections.
  * Uses non-blocking I/O with WaitSelect to allow periodic event
- * processing (GUI updates, abort checking). */
-static char *ssl_read_all(SSL *ssl, int sock, long *out_len, int *aborted)
+ * processing (GUI updates, abort checking). If stream is not NULL,
+ * body data is passed on as it arrives instead of being kept (see
+ * stream_take()). *status is set to READ_ABORTED on a user abort and to
+ * READ_STREAM_FAILED if the stream callback failed. */
+static char *conn_read_all(SSL *ssl, int sock, struct HttpStream *stream,
+                           long *out_len, int *status)
 {
     char *buf;
     long  buf_size = HTTP_INITIAL_BUF_SIZE;
@@ -186,69 +317,90 @@ static char *ssl_read_all(SSL *ssl, int sock, long *out_len, int *aborted)
     int   n;
     long  one = 1;
 
-    if (aborted) *aborted = 0;
+    *status = READ_OK;
 
     buf = malloc(buf_size);
     if (!buf) return NULL;
 
     /* Set socket to non-blocking so SSL_read returns immediately
      * when no data is available */
-    IoctlSocket(sock, FIONBIO, (char *)&one);
+    if (ssl)
+        IoctlSocket(sock, FIONBIO, (char *)&one);
 
     for (;;) {
+        int want_read = 0;
+
         if (total + HTTP_READ_CHUNK_SIZE >= buf_size) {
             char *new_buf;
             buf_size *= 2;
             new_buf = realloc(buf, buf_size);
-            if (!new_buf) { free(buf); return NULL; }
+            if (!new_buf) { free(buf); buf = NULL; break; }
             buf = new_buf;
         }
 
-        n = SSL_read(ssl, buf + total, HTTP_READ_CHUNK_SIZE);
-        if (n > 0) {
-            total += n;
-            continue;
+        if (ssl) {
+            n = SSL_read(ssl, buf + total, HTTP_READ_CHUNK_SIZE);
+            if (n > 0) {
+                total += n;
+                if (stream_take(stream, buf, &total)) goto stream_failed;
+                continue;
+            }
+            {
+                int ssl_err = SSL_get_error(ssl, n);
+                want_read = (ssl_err == SSL_ERROR_WANT_READ ||
+                             ssl_err == SSL_ERROR_WANT_WRITE);
+            }
+            if (!want_read)
+                break;  /* Connection closed or error */
         }
 
+        /* No data yet - check for abort, then wait with timeout */
         {
-            int ssl_err = SSL_get_error(ssl, n);
+            fd_set rfds;
+            struct timeval tv;
 
-            if (ssl_err == SSL_ERROR_WANT_READ ||
-                ssl_err == SSL_ERROR_WANT_WRITE)
+            /* Check abort callback */
+            if (http_event_cb &&
+                http_event_cb(http_event_data))
             {
-                /* No data yet - wait with timeout then check for abort */
-                fd_set rfds;
-                struct timeval tv;
-
-                /* Check abort callback */
-                if (http_event_cb &&
-                    http_event_cb(http_event_data))
-                {
-                    if (aborted) *aborted = 1;
-                    free(buf);
-                    /* Restore blocking mode */
-                    one = 0;
-                    IoctlSocket(sock, FIONBIO, (char *)&one);
-                    return NULL;
-                }
-
-                /* Wait up to 1 second for data */
-                FD_ZERO(&rfds);
-                FD_SET(sock, &rfds);
-                tv.tv_sec  = 1;
-                tv.tv_usec = 0;
-                WaitSelect(sock + 1, &rfds, NULL, NULL, &tv, NULL);
-                continue;
+                *status = READ_ABORTED;
+                free(buf);
+                buf = NULL;
+                break;
             }
 
-            /* Connection closed or error */
-            break;
+            /* Wait up to 1 second for data */
+            FD_ZERO(&rfds);
+            FD_SET(sock, &rfds);
+            tv.tv_sec  = 1;
+            tv.tv_usec = 0;
+            if (WaitSelect(sock + 1, &rfds, NULL, NULL, &tv, NULL) <= 0 ||
+                ssl)
+                continue;
         }
+
+        /* Plain socket is readable: a blocking recv() returns at once */
+        n = recv(sock, buf + total, HTTP_READ_CHUNK_SIZE, 0);
+        if (n <= 0)
+            break;  /* Connection closed or error */
+        total += n;
+        if (stream_take(stream, buf, &total)) goto stream_failed;
+        continue;
+
+    stream_failed:
+        *status = READ_STREAM_FAILED;
+        free(buf);
+        buf = NULL;
+        break;
     }
 
     /* Restore blocking mode */
-    one = 0;
-    IoctlSocket(sock, FIONBIO, (char *)&one);
+    if (ssl) {
+        one = 0;
+        IoctlSocket(sock, FIONBIO, (char *)&one);
+    }
+
+    if (!buf) return NULL;
 
     buf[total] = '\0';
     if (out_len) *out_len = total;
@@ -280,38 +432,26 @@ static const char *find_body(const char *response, long len)
     return NULL;
 }
 
-/* Decode chunked transfer encoding in-place */
+/* Append decoded chunk data at *userdata (a char ** write pointer) */
+static int dechunk_copy(const char *data, long len, void *userdata)
+{
+    char **dst = (char **)userdata;
+    memmove(*dst, data, len);
+    *dst += len;
+    return 0;
+}
+
+/* Decode chunked transfer encoding in-place. Uses the same decoder as
+ * streamed responses; the output never overtakes the input. */
 static long decode_chunked(char *data, long data_len)
 {
-    char *src = data;
+    struct HttpStream st;
     char *dst = data;
-    char *end = data + data_len;
-
-    while (src < end) {
-        long chunk_size;
-        char *line_end;
-
-        /* Read chunk size (hex) */
-        chunk_size = strtol(src, &line_end, 16);
-        if (chunk_size == 0) break;
-
-        /* Skip past \r\n after chunk size */
-        while (line_end < end && (*line_end == '\r' || *line_end == '\n'))
-            line_end++;
 
-        if (line_end + chunk_size > end)
-            chunk_size = end - line_end;
-
-        /* Copy chunk data */
-        if (dst != line_end)
-            memmove(dst, line_end, chunk_size);
-        dst += chunk_size;
-        src = line_end + chunk_size;
-
-        /* Skip trailing \r\n */
-        while (src < end && (*src == '\r' || *src == '\n'))
-            src++;
-    }
+    memset(&st, 0, sizeof(st));
+    st.cb       = dechunk_copy;
+    st.userdata = &dst;
+    stream_dechunk(&st, data, data_len);
 
     *dst = '\0';
     return dst - data;
@@ -326,12 +466,176 @@ static int is_chunked(const char *response)
     return strstr(p, "chunked") != NULL;
 }
 
+/* Open a TLS session on a connected socket.
+ * Falls back to an unverified connection if certificate verification
+ * fails (many Amiga setups lack an up-to-date CA bundle). */
+static SSL *ssl_open(int sock, const char *host)
+{
+    SSL *ssl;
+    int ssl_rc;
+
+    ssl = SSL_new(ssl_ctx);
+    if (!ssl) {
+        printf("ERROR: SSL_new failed\n");
+        return NULL;
+    }
+
+    SSL_set_fd(ssl, sock);
+    SSL_set_tlsext_host_name(ssl, host);
+
+    ssl_rc = SSL_connect(ssl);
+    if (ssl_rc <= 0) {
+        int ssl_err = SSL_get_error(ssl, ssl_rc);
+        unsigned long ossl_err = ERR_get_error();
+        char err_buf[256];
+        ERR_error_string_n(ossl_err, err_buf, sizeof(err_buf));
+        printf("ERROR: SSL handshake failed (ssl_err=%d)\n", ssl_err);
+        printf("  OpenSSL: %s\n", err_buf);
+
+        SSL_free(ssl);
+        ssl = NULL;
+
+        /* If certificate verification failed, retry without verify */
+        if (ssl_err != SSL_ERROR_SSL)
+            return NULL;
+
+        printf("  Retrying without certificate verification...\n");
+
+        /* Create a new session without verification for this connection */
+        SSL_CTX_set_verify(ssl_ctx, SSL_VERIFY_NONE, NULL);
+
+        ssl = SSL_new(ssl_ctx);
+        if (ssl) {
+            SSL_set_fd(ssl, sock);
+            SSL_set_tlsext_host_name(ssl, host);
+            ssl_rc = SSL_connect(ssl);
+            if (ssl_rc <= 0) {
+                ssl_err = SSL_get_error(ssl, ssl_rc);
+                ossl_err = ERR_get_error();
+                ERR_error_string_n(ossl_err, err_buf, sizeof(err_buf));
+                printf("ERROR: SSL retry also failed (ssl_err=%d)\n", ssl_err);
+                printf("  OpenSSL: %s\n", err_buf);
+                SSL_free(ssl);
+                ssl = NULL;
+            } else {
+                printf("  SSL connected (without cert verify)\n");
+            }
+        }
+
+        /* Restore verify for future connections */
+        SSL_CTX_set_verify(ssl_ctx, SSL_VERIFY_PEER, NULL);
+    }
+
+    return ssl;
+}
+
+/* Send a buffer over TLS or the plain socket. Returns 0 on success. */
+static int conn_write(SSL *ssl, int sock, const char *buf, long len)
+{
+    while (len > 0) {
+        int chunk = len > 32768 ? 32768 : (int)len;
+        int n = ssl ? SSL_write(ssl, buf, chunk)
+                    : send(sock, (char *)buf, chunk, 0);
+        if (n <= 0) return -1;
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
 int http_post(const char *host,
               const char *path,
               const char **headers,
               const char *body,
               struct HttpResponse *response)
 {
+    return http_request("POST", host, HTTPS_PORT, 1, path, headers,
+                        body, body ? (long)strlen(body) : 0, response);
+}
+
+int http_request(const char *method,
+                 const char *host,
+                 int port,
+                 int use_tls,
+                 const char *path,
+                 const char **headers,
+                 const char *body,
+                 long body_len,
+                 struct HttpResponse *response)
+{
+    return http_request_stream(method, host, port, use_tls, path, headers,
+                               body, body_len, NULL, NULL, response);
+}
+
+/* A body that is already in memory, for http_request_stream() */
+struct FlatBody {
+    const char *data;
+    long        len;
+};
+
+static int write_flat_body(HttpDataCallback sink, void *sink_data,
+                           void *userdata)
+{
+    struct FlatBody *fb = (struct FlatBody *)userdata;
+    return fb->len > 0 ? sink(fb->data, fb->len, sink_data) : 0;
+}
+
+int http_request_stream(const char *method,
+                        const char *host,
+                        int port,
+                        int use_tls,
+                        const char *path,
+                        const char **headers,
+                        const char *body,
+                        long body_len,
+                        HttpDataCallback data_cb,
+                        void *data_userdata,
+                        struct HttpResponse *response)
+{
+    struct FlatBody fb;
+
+    fb.data = body;
+    fb.len  = body ? body_len : 0;
+
+    return http_request_body(method, host, port, use_tls, path, headers,
+                             body ? write_flat_body : NULL, &fb, fb.len,
+                             data_cb, data_userdata, response);
+}
+
+/* Where http_request_body() sends the body pieces */
+struct BodySink {
+    SSL  *ssl;
+    int   sock;
+    long  sent;
+    FILE *log;
+};
+
+static int body_sink(const char *data, long len, void *userdata)
+{
+    struct BodySink *bs = (struct BodySink *)userdata;
+
+    if (bs->log)
+        fwrite(data, 1, len, bs->log);
+    if (conn_write(bs->ssl, bs->sock, data, len) != 0)
+        return -1;
+    bs->sent += len;
+    return 0;
+}
+
+int http_request_body(const char *method,
+                      const char *host,
+                      int port,
+                      int use_tls,
+                      const char *path,
+                      const char **headers,
+                      HttpBodyWriter body_writer,
+                      void *body_userdata,
+                      long body_len,
+                      HttpDataCallback data_cb,
+                      void *data_userdata,
+                      struct HttpResponse *response)
+{
+    struct HttpStream stream;
     int   sock = -1;
     SSL  *ssl  = NULL;
     char *request = NULL;
@@ -344,16 +648,22 @@ int http_post(const char *host,
 
     memset(response, 0, sizeof(*response));
 
-    /* Build HTTP request */
-    request = malloc(HTTP_MAX_HEADER_SIZE + strlen(body) + 256);
+    if (!body_writer) body_len = 0;
+
+    /* Build HTTP request header block */
+    request = malloc(HTTP_MAX_HEADER_SIZE);
     if (!request) goto done;
 
     request_len = snprintf(request, HTTP_MAX_HEADER_SIZE,
-        "POST %s HTTP/1.1\r\n"
+        "%s %s HTTP/1.1\r\n"
         "Host: %s\r\n"
-        "Content-Length: %ld\r\n"
         "Connection: close\r\n",
-        path, host, (long)strlen(body));
+        method, path, host);
+
+    if (body_writer)
+        request_len += snprintf(request + request_len,
+            HTTP_MAX_HEADER_SIZE - request_len,
+            "Content-Length: %ld\r\n", body_len);
 
     /* Append custom headers */
     if (headers) {
@@ -368,89 +678,80 @@ int http_post(const char *host,
     request_len += snprintf(request + request_len,
         HTTP_MAX_HEADER_SIZE - request_len, "\r\n");
 
-    /* Append body */
-    memcpy(request + request_len, body, strlen(body));
-    request_len += strlen(body);
+    if (request_len >= HTTP_MAX_HEADER_SIZE) {
+        printf("ERROR: HTTP request headers too long\n");
+        goto done;
+    }
 
     /* TCP connect */
-    sock = tcp_connect(host, HTTPS_PORT);
+    sock = tcp_connect(host, port);
     if (sock < 0) goto done;
 
     /* SSL handshake */
-    ssl = SSL_new(ssl_ctx);
-    if (!ssl) {
-        printf("ERROR: SSL_new failed\n");
-        goto done;
-    }
-
-    SSL_set_fd(ssl, sock);
-    SSL_set_tlsext_host_name(ssl, host);
-
-    {
-        int ssl_rc = SSL_connect(ssl);
-        if (ssl_rc <= 0) {
-            int ssl_err = SSL_get_error(ssl, ssl_rc);
-            unsigned long ossl_err = ERR_get_error();
-            char err_buf[256];
-            ERR_error_string_n(ossl_err, err_buf, sizeof(err_buf));
-            printf("ERROR: SSL handshake failed (ssl_err=%d)\n", ssl_err);
-            printf("  OpenSSL: %s\n", err_buf);
-
-            /* If certificate verification failed, retry without verify */
-            if (ssl_err == SSL_ERROR_SSL) {
-                printf("  Retrying without certificate verification...\n");
-                SSL_free(ssl);
-                ssl = NULL;
-
-                /* Create a new context without verification for this connection */
-                SSL_CTX_set_verify(ssl_ctx, SSL_VERIFY_NONE, NULL);
-
-                ssl = SSL_new(ssl_ctx);
-                if (ssl) {
-                    SSL_set_fd(ssl, sock);
-                    SSL_set_tlsext_host_name(ssl, host);
-                    ssl_rc = SSL_connect(ssl);
-                    if (ssl_rc <= 0) {
-                        ssl_err = SSL_get_error(ssl, ssl_rc);
-                        ossl_err = ERR_get_error();
-                        ERR_error_string_n(ossl_err, err_buf, sizeof(err_buf));
-                        printf("ERROR: SSL retry also failed (ssl_err=%d)\n", ssl_err);
-                        printf("  OpenSSL: %s\n", err_buf);
-                        /* Restore verify */
-                        SSL_CTX_set_verify(ssl_ctx, SSL_VERIFY_PEER, NULL);
-                        goto done;
-                    }
-                    printf("  SSL connected (without cert verify)\n");
-                } else {
-                    SSL_CTX_set_verify(ssl_ctx, SSL_VERIFY_PEER, NULL);
-                    goto done;
-                }
-                /* Restore verify for future connections */
-                SSL_CTX_set_verify(ssl_ctx, SSL_VERIFY_PEER, NULL);
-            } else {
-                goto done;
-            }
-        }
+    if (use_tls) {
+        ssl = ssl_open(sock, host);
+        if (!ssl) goto done;
     }
 
-    /* Log outgoing request body */
-    api_log_write("REQUEST", body, 0);
-
-    /* Send request */
-    if (SSL_write(ssl, request, request_len) != request_len) {
-        printf("ERROR: SSL_write failed\n");
+    /* Send request: header block, then the body as the writer
+     * produces it (logged on the way out) */
+    if (conn_write(ssl, sock, request, request_len) != 0) {
+        printf("ERROR: %s failed\n", ssl ? "SSL_write" : "send");
         goto done;
     }
+    if (body_writer) {
+        struct BodySink bs;
+        int wrc;
+
+        bs.ssl  = ssl;
+        bs.sock = sock;
+        bs.sent = 0;
+        bs.log  = api_log_path ? fopen(api_log_path, "a") : NULL;
+        if (bs.log)
+            fputs("==== REQUEST ====\n", bs.log);
+
+        wrc = body_writer(body_sink, &bs, body_userdata);
+
+        if (bs.log) {
+            fputs("\n\n", bs.log);
+            fclose(bs.log);
+        }
+        if (wrc != 0 || bs.sent != body_len) {
+            printf("ERROR: %s failed\n", ssl ? "SSL_write" : "send");
+            goto done;
+        }
+    }
 
-    /* Read response (non-blocking with event callback) */
+    /* Read response (non-blocking with event callback). A streamed
+     * body goes to the log as it arrives, since it is not kept. */
     {
-        int aborted = 0;
-        raw_response = ssl_read_all(ssl, sock, &raw_len, &aborted);
-        if (aborted) {
+        int status;
+
+        memset(&stream, 0, sizeof(stream));
+        stream.cb       = data_cb;
+        stream.userdata = data_userdata;
+        stream.log      = data_cb && api_log_path ?
+                          fopen(api_log_path, "a") : NULL;
+        if (stream.log)
+            fputs("==== RESPONSE (streamed) ====\n", stream.log);
+
+        raw_response = conn_read_all(ssl, sock, data_cb ? &stream : NULL,
+                                     &raw_len, &status);
+
+        if (stream.log) {
+            fputs("\n\n", stream.log);
+            fclose(stream.log);
+        }
+        if (status == READ_ABORTED) {
             printf("  [http] Request aborted by user\n");
             ret = -2;  /* Distinguish abort from error */
             goto done;
         }
+        if (status == READ_STREAM_FAILED) {
+            printf("ERROR: Streamed response could not be processed\n");
+            ret = -3;
+            goto done;
+        }
         if (!raw_response || raw_len == 0) {
             printf("ERROR: Empty response from server\n");
             goto done;
@@ -469,21 +770,21 @@ int http_post(const char *host,
 
     /* Extract body */
     {
-        long body_len = raw_len - (body_start - raw_response);
-        response->body = malloc(body_len + 1);
+        long resp_len = raw_len - (body_start - raw_response);
+        response->body = malloc(resp_len + 1);
         if (!response->body) goto done;
-        memcpy(response->body, body_start, body_len);
-        response->body[body_len] = '\0';
-        response->body_length = body_len;
+        memcpy(response->body, body_start, resp_len);
+        response->body[resp_len] = '\0';
+        response->body_length = resp_len;
 
         /* Handle chunked encoding */
         if (is_chunked(raw_response)) {
-            response->body_length = decode_chunked(response->body, body_len);
+            response->body_length = decode_chunked(response->body, resp_len);
         }
     }
 
     /* Log response body */
-    if (response->body)
+    if (response->body && !stream.active)
         api_log_write("RESPONSE", response->body, response->body_length);
 
     ret = 0;
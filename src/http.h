@@ -6,12 +6,24 @@
 #define HTTP_READ_CHUNK_SIZE  4096
 
 #define HTTPS_PORT 443
+#define HTTP_PORT   80
 
 /* Callback for periodic event processing during long I/O.
  * Called every ~1 second during SSL reads.
  * Return non-zero to abort the request. */
 typedef int (*HttpEventCallback)(void *userdata);
 
+/* Callback receiving the response body while it arrives, with chunked
+ * transfer encoding already removed. Only called for 2xx responses.
+ * Return non-zero to abort the request. */
+typedef int (*HttpDataCallback)(const char *data, long len, void *userdata);
+
+/* Produces a request body by passing it to sink in pieces, in order.
+ * Must produce exactly the body_len announced to http_request_body().
+ * Return non-zero on error (or when sink returned non-zero). */
+typedef int (*HttpBodyWriter)(HttpDataCallback sink, void *sink_data,
+                              void *userdata);
+
 struct HttpResponse {
     int   status_code;
     char *body;           /* Null-terminated response body (caller must free) */
@@ -40,6 +52,56 @@ int http_post(const char *host,
               const char *body,
               struct HttpResponse *response);
 
+/* Perform an HTTP or HTTPS request with an arbitrary method.
+ * method:   "GET", "POST", ...
+ * port:     TCP port (HTTPS_PORT for the real API)
+ * use_tls:  0 = plain HTTP (local stand-in servers), 1 = HTTPS
+ * body:     request body, may be NULL (e.g. for GET)
+ * body_len: length of body in bytes (may contain NUL bytes)
+ * Returns 0 on success, -2 on user abort, -3 if a data callback
+ * (http_request_stream()) failed, other negative on error. */
+int http_request(const char *method,
+                 const char *host,
+                 int port,
+                 int use_tls,
+                 const char *path,
+                 const char **headers,
+                 const char *body,
+                 long body_len,
+                 struct HttpResponse *response);
+
+/* Same as http_request(), but passes body data to data_cb as soon as it
+ * is read (e.g. for server-sent events). A body passed to data_cb (2xx
+ * responses) is not kept: response->body is then empty. Other responses
+ * (errors) still arrive whole in response->body. data_cb may be NULL. */
+int http_request_stream(const char *method,
+                        const char *host,
+                        int port,
+                        int use_tls,
+                        const char *path,
+                        const char **headers,
+                        const char *body,
+                        long body_len,
+                        HttpDataCallback data_cb,
+                        void *data_userdata,
+                        struct HttpResponse *response);
+
+/* Same as http_request_stream(), but the body is not held in memory:
+ * body_writer (may be NULL for no body) is called once the connection
+ * is up and sends body_len bytes straight to the socket. */
+int http_request_body(const char *method,
+                      const char *host,
+                      int port,
+                      int use_tls,
+                      const char *path,
+                      const char **headers,
+                      HttpBodyWriter body_writer,
+                      void *body_userdata,
+                      long body_len,
+                      HttpDataCallback data_cb,
+                      void *data_userdata,
+                      struct HttpResponse *response);
+
 /* Set event callback for non-blocking I/O.
  * The callback is called periodically during SSL reads
  * to allow GUI event processing and abort checking. */
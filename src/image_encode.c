@@ -0,0 +1,324 @@
+/*
+ * image_encode.c - Encode rows from any image source as PNG
+ *
+ * The common path behind picture conversion (png_convert.c) and
+ * screen capture (screen_grab.c): rows come from a reader callback, as
+ * pens with a palette or as RGB, are optionally scaled down
+ * (image_scale.c) and go to the project's PNG encoder (png_encode.c),
+ * which hands the compressed file to a sink, e.g. the chunked memory
+ * buffer below.
+ *
+ * Only a few rows are held at a time. Each source is read twice: once
+ * to find the pens or colours in use, which decides the smallest PNG
+ * format, and once to encode.
+ *
+ * Platform independent, so the whole path can be exercised on the
+ * host (tools/grabsim.c).
+ */
+
+#include "image_encode.h"
+#include "image_scale.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* ===================== Pens ===================== */
+
+/* Pens at their own size: collect the pens in use, then write them
+ * packed with a PLTE of just those */
+static int write_pens(const struct ImageSource *src, int level,
+                      PngSink sink, void *userdata)
+{
+    struct PngPens *pens;
+    struct PngEncoder *enc = NULL;
+    unsigned char plte[256 * 3];
+    unsigned char *row, *packed = NULL;
+    int result = -1;
+    unsigned long y;
+    int p;
+
+    pens = malloc(sizeof(*pens));
+    row = malloc(src->width);
+    if (!pens || !row) goto cleanup;
+
+    png_pens_init(pens);
+    for (y = 0; y < src->height; y++) {
+        if (src->read_row(src->handle, y, row) != 0) goto cleanup;
+        png_pens_mark(pens, row, src->width);
+    }
+    png_pens_compact(pens);
+
+    for (p = 0; p < pens->count; p++)
+        memcpy(plte + p * 3, src->palette + pens->pen[p] * 3, 3);
+
+    packed = malloc((src->width * pens->bit_depth + 7) / 8);
+    if (!packed) goto cleanup;
+
+    enc = png_encoder_new(src->width, src->height, pens->bit_depth,
+                          PNG_COLOR_INDEXED, plte, pens->count,
+                          level, sink, userdata);
+    if (!enc) goto cleanup;
+
+    for (y = 0; y < src->height; y++) {
+        if (src->read_row(src->handle, y, row) != 0) goto cleanup;
+        png_pens_row(pens, row, src->width, packed);
+        if (png_encoder_row(enc, packed) != 0) goto cleanup;
+    }
+
+    result = png_encoder_finish(enc);
+
+cleanup:
+    png_encoder_free(enc);
+    free(packed);
+    free(row);
+    free(pens);
+    return result;
+}
+
+/* ===================== RGB ===================== */
+
+/* Read source row y as RGB (width * 3 bytes). Pens are looked up in the
+ * palette, using the end of the RGB buffer for them. */
+static int read_rgb_row(const struct ImageSource *src, unsigned long y,
+                        unsigned char *rgb)
+{
+    const unsigned char *pen;
+    unsigned long x;
+
+    if (!src->palette)
+        return src->read_row(src->handle, y, rgb);
+
+    pen = rgb + src->width * 2;
+    if (src->read_row(src->handle, y, (unsigned char *)pen) != 0)
+        return -1;
+
+    /* Front to back: pixel x is written to bytes 3x..3x+2, which are
+     * below pen x (at 2w + x) until x is read */
+    for (x = 0; x < src->width; x++, rgb += 3) {
+        const unsigned char *c = src->palette + pen[x] * 3;
+        rgb[0] = c[0];
+        rgb[1] = c[1];
+        rgb[2] = c[2];
+    }
+    return 0;
+}
+
+/* One pass over the (scaled) rows: collect colours, or encode */
+struct RgbPass {
+    struct PngColors  *colors;
+    struct PngEncoder *enc;     /* NULL: collecting colours */
+    int                indexed; /* cleared when over 256 colours */
+    unsigned char     *idx;
+    unsigned long      width;
+};
+
+static int rgb_pass_row(const unsigned char *rgb, void *userdata)
+{
+    struct RgbPass *pass = (struct RgbPass *)userdata;
+
+    if (!pass->enc) {
+        if (png_colors_add(pass->colors, rgb, pass->width) != 0) {
+            pass->indexed = 0;
+            return -1;
+        }
+        return 0;
+    }
+
+    if (pass->indexed) {
+        png_colors_row(pass->colors, rgb, pass->width, pass->idx);
+        return png_encoder_row(pass->enc, pass->idx);
+    }
+    return png_encoder_row(pass->enc, rgb);
+}
+
+/* Feed all source rows through the scaler (if the size differs) to
+ * rgb_pass_row(). Returns 0, or -1 if reading or the pass failed. */
+static int run_pass(const struct ImageSource *src,
+                    unsigned long dst_w, unsigned long dst_h,
+                    struct RgbPass *pass, unsigned char *rgb)
+{
+    struct Scaler *sc = NULL;
+    int rc = 0;
+    unsigned long y;
+
+    if (dst_w != src->width || dst_h != src->height) {
+        sc = scaler_new(src->width, src->height, dst_w, dst_h,
+                        rgb_pass_row, pass);
+        if (!sc) return -1;
+    }
+
+    for (y = 0; y < src->height && rc == 0; y++) {
+        rc = read_rgb_row(src, y, rgb);
+        if (rc == 0)
+            rc = sc ? scaler_row(sc, rgb) : rgb_pass_row(rgb, pass);
+    }
+
+    scaler_free(sc);
+    return rc;
+}
+
+/* Write RGB rows at dst_w x dst_h. The first pass collects colours
+ * until there are more than 256 (usually within a few rows for a
+ * photo); images with fewer become indexed PNGs. */
+static int write_rgb(const struct ImageSource *src,
+                     unsigned long dst_w, unsigned long dst_h,
+                     int level, PngSink sink, void *userdata)
+{
+    struct PngColors *colors;
+    struct RgbPass pass;
+    unsigned char *rgb, *idx;
+    int result = -1;
+
+    memset(&pass, 0, sizeof(pass));
+    colors = malloc(sizeof(*colors));
+    rgb = malloc(src->width * 3);
+    idx = malloc(dst_w);
+    if (!colors || !rgb || !idx) goto cleanup;
+
+    png_colors_init(colors);
+    pass.colors = colors;
+    pass.indexed = 1;
+    pass.idx = idx;
+    pass.width = dst_w;
+
+    if (run_pass(src, dst_w, dst_h, &pass, rgb) != 0 && pass.indexed)
+        goto cleanup;
+
+    if (pass.indexed)
+        pass.enc = png_encoder_new(dst_w, dst_h, colors->bit_depth,
+                                   PNG_COLOR_INDEXED, colors->palette,
+                                   colors->count, level, sink, userdata);
+    else
+        pass.enc = png_encoder_new(dst_w, dst_h, 8, PNG_COLOR_RGB,
+                                   NULL, 0, level, sink, userdata);
+    if (!pass.enc) goto cleanup;
+
+    if (run_pass(src, dst_w, dst_h, &pass, rgb) != 0)
+        goto cleanup;
+
+    result = png_encoder_finish(pass.enc);
+
+cleanup:
+    png_encoder_free(pass.enc);
+    free(idx);
+    free(rgb);
+    free(colors);
+    return result;
+}
+
+int image_encode_png(const struct ImageSource *src,
+                     unsigned long dst_w, unsigned long dst_h,
+                     int level, PngSink sink, void *userdata)
+{
+    if (src->width == 0 || src->height == 0 || dst_w == 0 || dst_h == 0 ||
+        dst_w > src->width || dst_h > src->height)
+        return -1;
+
+    /* Scaled pixels are averages of pen colours, not pens */
+    if (src->palette && dst_w == src->width && dst_h == src->height)
+        return write_pens(src, level, sink, userdata);
+
+    return write_rgb(src, dst_w, dst_h, level, sink, userdata);
+}
+
+/* ===================== HAM ===================== */
+
+void image_ham_row(const unsigned char *pens, unsigned long width,
+                   const unsigned char *palette, int depth,
+                   unsigned char *rgb)
+{
+    int shift = depth - 2;
+    unsigned int mask = (1U << shift) - 1;
+    unsigned char r = palette[0], g = palette[1], b = palette[2];
+    unsigned long x;
+
+    for (x = 0; x < width; x++, rgb += 3) {
+        unsigned int data = pens[x] & mask;
+        unsigned char v;
+
+        /* Widen 4- or 6-bit data to 8 bits */
+        v = (unsigned char)(shift == 4 ? data * 17 : (data << 2) | (data >> 4));
+
+        switch ((pens[x] >> shift) & 3) {
+            case 0:
+                r = palette[data * 3 + 0];
+                g = palette[data * 3 + 1];
+                b = palette[data * 3 + 2];
+                break;
+            case 1: b = v; break;
+            case 2: r = v; break;
+            case 3: g = v; break;
+        }
+        rgb[0] = r;
+        rgb[1] = g;
+        rgb[2] = b;
+    }
+}
+
+/* ===================== Output buffer ===================== */
+
+struct ImageOutChunk {
+    struct ImageOutChunk *next;
+    long                  used;
+    unsigned char         data[IMAGE_OUT_CHUNK];
+};
+
+int image_out_sink(const unsigned char *data, long len, void *userdata)
+{
+    struct ImageOut *out = (struct ImageOut *)userdata;
+
+    if (out->max_len && out->total + len > out->max_len) {
+        out->too_large = 1;
+        return -1;
+    }
+    out->total += len;
+
+    while (len > 0) {
+        struct ImageOutChunk *c = out->tail;
+        long n;
+
+        if (!c || c->used == IMAGE_OUT_CHUNK) {
+            c = malloc(sizeof(*c));
+            if (!c) return -1;
+            c->next = NULL;
+            c->used = 0;
+            if (out->tail) out->tail->next = c;
+            else out->head = c;
+            out->tail = c;
+        }
+
+        n = IMAGE_OUT_CHUNK - c->used;
+        if (n > len) n = len;
+        memcpy(c->data + c->used, data, n);
+        c->used += n;
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+unsigned char *image_out_join(struct ImageOut *out)
+{
+    unsigned char *buf = malloc(out->total > 0 ? out->total : 1);
+    long pos = 0;
+
+    while (out->head) {
+        struct ImageOutChunk *c = out->head;
+        out->head = c->next;
+        if (buf) memcpy(buf + pos, c->data, c->used);
+        pos += c->used;
+        free(c);
+    }
+    out->tail = NULL;
+    return buf;
+}
+
+void image_out_free(struct ImageOut *out)
+{
+    while (out->head) {
+        struct ImageOutChunk *c = out->head;
+        out->head = c->next;
+        free(c);
+    }
+    out->tail = NULL;
+}
@@ -0,0 +1,60 @@
+#ifndef AMIGAAI_IMAGE_ENCODE_H
+#define AMIGAAI_IMAGE_ENCODE_H
+
+#include "png_encode.h"
+
+/* Rows of an image to encode, read on demand top to bottom, usually
+ * twice (once to find the colours, once to encode). */
+struct ImageSource {
+    unsigned long        width, height;
+    const unsigned char *palette;   /* rows are pens (one byte per pixel)
+                                       into these 256 RGB entries;
+                                       NULL: rows are RGB */
+    int  (*read_row)(void *handle, unsigned long y, unsigned char *row);
+    void  *handle;                  /* read_row returns 0 or -1 */
+};
+
+/* Encode src as PNG at dst_w x dst_h (no larger than the source; it is
+ * scaled down with image_scale.c if smaller), at deflate level 0-9.
+ * Pens at full size are written packed, with a PLTE of just the pens
+ * in use. RGB and scaled images are written indexed if they have at
+ * most 256 colours, otherwise as truecolor. Returns 0 or -1. */
+int image_encode_png(const struct ImageSource *src,
+                     unsigned long dst_w, unsigned long dst_h,
+                     int level, PngSink sink, void *userdata);
+
+/* Decode one row of HAM pens (depth 6 or 8) to width RGB pixels. Each
+ * pixel either takes a palette entry or changes one component of the
+ * pixel to its left; a row starts from palette entry 0. */
+void image_ham_row(const unsigned char *pens, unsigned long width,
+                   const unsigned char *palette, int depth,
+                   unsigned char *rgb);
+
+/* ===================== Output buffer ===================== */
+
+/* A PngSink collecting the PNG in memory, in fixed-size chunks joined
+ * at the end. While encoding it needs no more than the output plus one
+ * chunk, and nothing is copied as it grows; the join briefly holds the
+ * chunks and the joined block, about twice the output. Start from a
+ * zeroed ImageOut. */
+#define IMAGE_OUT_CHUNK 32768L
+
+struct ImageOutChunk;
+
+struct ImageOut {
+    struct ImageOutChunk *head, *tail;
+    long                  total;
+    long                  max_len;    /* 0 = no limit */
+    int                   too_large;  /* set when max_len was exceeded */
+};
+
+int image_out_sink(const unsigned char *data, long len, void *userdata);
+
+/* Copy the chunks into one block of out->total bytes (caller frees),
+ * freeing each as it is copied. Returns NULL if out of memory (the
+ * chunks are freed either way). */
+unsigned char *image_out_join(struct ImageOut *out);
+
+void image_out_free(struct ImageOut *out);
+
+#endif /* AMIGAAI_IMAGE_ENCODE_H */
@@ -0,0 +1,55 @@
+#ifndef AMIGAAI_IMAGE_SCALE_H
+#define AMIGAAI_IMAGE_SCALE_H
+
+/* Defaults for images sent to the API: it downscales anything with a
+ * longer edge or more pixels than this itself, so larger images only
+ * cost upload time. */
+#define IMAGE_DEFAULT_MAX_EDGE    1568
+#define IMAGE_DEFAULT_MAX_PIXELS  1150000UL
+
+/* Size of a src_w x src_h image shrunk to fit max_edge (longest side)
+ * and max_pixels (width * height), keeping the aspect ratio. A limit
+ * of 0 means none. Returns 1 if the result is smaller than the source,
+ * 0 if the image fits as it is. */
+int scale_fit(unsigned long src_w, unsigned long src_h,
+              unsigned long max_edge, unsigned long max_pixels,
+              unsigned long *dst_w, unsigned long *dst_h);
+
+/* A region of a width x height image and the size of its image when
+ * the whole is shown at scaled_w x scaled_h */
+struct ScaleRegion {
+    unsigned long x, y, w, h;
+    unsigned long dst_w, dst_h;
+};
+
+/* Clip the region at x, y of w x h pixels to the image (w or h <= 0:
+ * up to the right or bottom edge) and size it for the image scaled to
+ * scaled_w x scaled_h (0: not scaled). Returns 0, or -1 if none of the
+ * region is inside the image. */
+int scale_region(unsigned long width, unsigned long height,
+                 long x, long y, long w, long h,
+                 unsigned long scaled_w, unsigned long scaled_h,
+                 struct ScaleRegion *r);
+
+/* Receives one finished row of dst_w RGB pixels. Return non-zero to
+ * stop. */
+typedef int (*ScaleSink)(const unsigned char *rgb, void *userdata);
+
+struct Scaler;
+
+/* Box (area-averaging) downscaler for RGB rows. Source rows are added
+ * top to bottom; each destination row is passed to the sink as soon as
+ * the source rows it covers are in, so only one row of each is held.
+ * Sizes must be 1..65535 and dst no larger than src.
+ * Returns NULL if out of memory or the sizes are invalid. */
+struct Scaler *scaler_new(unsigned long src_w, unsigned long src_h,
+                          unsigned long dst_w, unsigned long dst_h,
+                          ScaleSink sink, void *userdata);
+
+/* Add one source row of src_w RGB pixels. Returns 0, or the sink's
+ * non-zero result. */
+int scaler_row(struct Scaler *s, const unsigned char *rgb);
+
+void scaler_free(struct Scaler *s);
+
+#endif /* AMIGAAI_IMAGE_SCALE_H */
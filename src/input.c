@@ -136,6 +136,18 @@ int input_mouse_move(int x, int y)
     return rc;
 }
 
+int input_screen_size(int *width, int *height)
+{
+    struct Screen *scr = LockPubScreen(NULL);
+
+    if (!scr)
+        return -1;
+    *width  = scr->Width;
+    *height = scr->Height;
+    UnlockPubScreen(NULL, scr);
+    return 0;
+}
+
 int input_mouse_click(int button, int action)
 {
     struct InputEvent ie;
@@ -11,6 +11,10 @@ void input_close(void);
 /* Move mouse to absolute screen coordinates (pixels). */
 int input_mouse_move(int x, int y);
 
+/* Size of the screen input_mouse_move() positions on (the default
+ * public screen). Returns 0 on success, -1 on failure. */
+int input_screen_size(int *width, int *height);
+
 /* Click or release a mouse button.
  * button: 0=left, 1=right, 2=middle
  * action: 0=click (press+release), 1=press only, 2=release only */
@@ -0,0 +1,349 @@
+/*
+ * json_pull.c - Event-driven JSON parser for AmigaAI
+ *
+ * Reports objects, arrays, keys and scalars one event at a time,
+ * with strings as views into the input, so a caller can pick out a
+ * few fields without building a cJSON tree. The input is parsed in
+ * place; each SSE event is handed over complete, so a token is never
+ * cut off.
+ */
+
+#include "json_pull.h"
+
+#include <string.h>
+
+/* Parser states: what may come next */
+enum {
+    S_VALUE,            /* Any value */
+    S_VALUE_OR_CLOSE,   /* After '[' */
+    S_KEY,              /* After ',' in an object */
+    S_KEY_OR_CLOSE,     /* After '{' */
+    S_COLON,            /* After a key */
+    S_NEXT,             /* After a value: ',' or close */
+    S_DONE              /* Top-level value complete */
+};
+
+void json_pull_init(struct JsonPull *p, const char *text, long len)
+{
+    memset(p, 0, sizeof(*p));
+    p->buf   = text;
+    p->len   = len;
+    p->skip_to = -1;
+}
+
+/* Enter an object or array */
+static int push(struct JsonPull *p, char c)
+{
+    if (p->depth >= JSON_PULL_MAX_DEPTH) return -1;
+    p->stack[p->depth++] = c;
+    p->state = c == '{' ? S_KEY_OR_CLOSE : S_VALUE_OR_CLOSE;
+    return 0;
+}
+
+/* A value has been completed at the current level */
+static void value_done(struct JsonPull *p)
+{
+    p->state = p->depth ? S_NEXT : S_DONE;
+}
+
+/* Scan a string starting at the opening quote. Sets the token and
+ * returns the position after the closing quote, or -1 if the input
+ * ends first. */
+static long scan_string(struct JsonPull *p)
+{
+    const char *b = p->buf;
+    long i = p->pos + 1;
+    int escaped = 0;
+
+    while (i < p->len) {
+        const char *q = memchr(b + i, '"', p->len - i);
+        const char *bs = memchr(b + i, '\\', (q ? q - b : p->len) - i);
+
+        if (bs) {
+            /* Escape before the next quote (\" included): skip it */
+            i = (bs - b) + 2;
+            escaped = 1;
+            continue;
+        }
+        if (!q)
+            break;
+
+        p->str = b + p->pos + 1;
+        p->str_len = (q - b) - (p->pos + 1);
+        p->escaped = escaped;
+        return (q - b) + 1;
+    }
+
+    return -1;
+}
+
+static int is_number_char(char c)
+{
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' ||
+           c == '.' || c == 'e' || c == 'E';
+}
+
+/* Scan a number. Returns the end position, or -1 on a malformed
+ * number. Integers are converted directly; anything
+ * else goes through cJSON's number parser. */
+static long scan_number(struct JsonPull *p)
+{
+    char tmp[64];
+    long i = p->pos, n, k, sign, value = 0;
+
+    while (i < p->len && is_number_char(p->buf[i]))
+        i++;
+
+    n = i - p->pos;
+    if (n == 0 || n >= (long)sizeof(tmp))
+        return -1;
+    memcpy(tmp, p->buf + p->pos, n);
+    tmp[n] = '\0';
+
+    /* Up to 9 digits always fit a long */
+    k = sign = tmp[0] == '-';
+    while (k < n && tmp[k] >= '0' && tmp[k] <= '9' && k - sign < 9)
+        value = value * 10 + (tmp[k++] - '0');
+    if (k == n && n > sign) {
+        p->number = tmp[0] == '-' ? -value : value;
+    } else {
+        const char *end = NULL;
+        cJSON *num = cJSON_ParseWithOpts(tmp, &end, 1);
+        if (!cJSON_IsNumber(num)) {
+            cJSON_Delete(num);
+            return -1;
+        }
+        p->number = num->valuedouble;
+        cJSON_Delete(num);
+    }
+
+    p->str = p->buf + p->pos;
+    p->str_len = n;
+    return i;
+}
+
+/* Match a literal. Returns 1 if matched, 0 if not. */
+static int match_literal(struct JsonPull *p, const char *lit)
+{
+    long n = (long)strlen(lit);
+
+    return p->len - p->pos >= n && memcmp(p->buf + p->pos, lit, n) == 0;
+}
+
+static int next_token(struct JsonPull *p)
+{
+    char c;
+
+    if (p->state == S_DONE)
+        return JSON_PULL_END;
+
+    for (;;) {
+        while (p->pos < p->len &&
+               (p->buf[p->pos] == ' ' || p->buf[p->pos] == '\t' ||
+                p->buf[p->pos] == '\n' || p->buf[p->pos] == '\r'))
+            p->pos++;
+        if (p->pos >= p->len)
+            return JSON_PULL_ERROR;     /* Input ends inside a value */
+
+        c = p->buf[p->pos];
+
+        switch (p->state) {
+        case S_COLON:
+            if (c != ':') return JSON_PULL_ERROR;
+            p->pos++;
+            p->state = S_VALUE;
+            continue;
+
+        case S_NEXT:
+            if (c == ',') {
+                p->pos++;
+                p->state = p->stack[p->depth - 1] == '{' ? S_KEY : S_VALUE;
+                continue;
+            }
+            if (c == '}' || c == ']') {
+                if (c != (p->stack[p->depth - 1] == '{' ? '}' : ']'))
+                    return JSON_PULL_ERROR;
+                p->pos++;
+                p->depth--;
+                value_done(p);
+                return c == '}' ? JSON_PULL_OBJECT_END : JSON_PULL_ARRAY_END;
+            }
+            return JSON_PULL_ERROR;
+
+        case S_KEY_OR_CLOSE:
+        case S_KEY:
+            if (c == '}' && p->state == S_KEY_OR_CLOSE) {
+                p->pos++;
+                p->depth--;
+                value_done(p);
+                return JSON_PULL_OBJECT_END;
+            }
+            if (c != '"') return JSON_PULL_ERROR;
+            {
+                long end = scan_string(p);
+                if (end < 0) return JSON_PULL_ERROR;
+                p->pos = end;
+                p->state = S_COLON;
+                return JSON_PULL_KEY;
+            }
+
+        case S_VALUE_OR_CLOSE:
+            if (c == ']') {
+                p->pos++;
+                p->depth--;
+                value_done(p);
+                return JSON_PULL_ARRAY_END;
+            }
+            /* fall through */
+        case S_VALUE:
+            break;
+        }
+
+        /* A value */
+        if (c == '{' || c == '[') {
+            if (push(p, c) != 0) return JSON_PULL_ERROR;
+            p->pos++;
+            return c == '{' ? JSON_PULL_OBJECT_START : JSON_PULL_ARRAY_START;
+        }
+        if (c == '"') {
+            long end = scan_string(p);
+            if (end < 0) return JSON_PULL_ERROR;
+            p->pos = end;
+            value_done(p);
+            return JSON_PULL_STRING;
+        }
+        if (c == '-' || (c >= '0' && c <= '9')) {
+            long end = scan_number(p);
+            if (end < 0) return JSON_PULL_ERROR;
+            p->pos = end;
+            value_done(p);
+            return JSON_PULL_NUMBER;
+        }
+        {
+            static const char *const lits[] = { "true", "false", "null" };
+            int k;
+            for (k = 0; k < 3; k++) {
+                if (c != lits[k][0]) continue;
+                if (!match_literal(p, lits[k])) return JSON_PULL_ERROR;
+                p->pos += (long)strlen(lits[k]);
+                p->boolean = k == 0;
+                value_done(p);
+                return k == 2 ? JSON_PULL_NULL : JSON_PULL_BOOL;
+            }
+        }
+        return JSON_PULL_ERROR;
+    }
+}
+
+int json_pull_next(struct JsonPull *p)
+{
+    int ev = next_token(p);
+    if (ev == JSON_PULL_ERROR)
+        p->state = S_DONE;      /* Stay failed */
+    return ev;
+}
+
+int json_pull_skip(struct JsonPull *p)
+{
+    int ev;
+
+    /* After a KEY, skip one value at this depth; after a START,
+     * skip until its END brings us back one level. */
+    if (p->skip_to < 0)
+        p->skip_to = p->state == S_COLON ? p->depth : p->depth - 1;
+
+    for (;;) {
+        ev = json_pull_next(p);
+        if (ev == JSON_PULL_ERROR || p->depth == p->skip_to) {
+            p->skip_to = -1;
+            return ev;
+        }
+    }
+}
+
+int json_pull_is(const struct JsonPull *p, const char *s)
+{
+    long n = (long)strlen(s);
+    return !p->escaped && p->str_len == n && memcmp(p->str, s, n) == 0;
+}
+
+static int hex4(const char *s, long left)
+{
+    int v = 0, i;
+    if (left < 4) return -1;
+    for (i = 0; i < 4; i++) {
+        char c = s[i];
+        v <<= 4;
+        if (c >= '0' && c <= '9')      v |= c - '0';
+        else if (c >= 'a' && c <= 'f') v |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') v |= c - 'A' + 10;
+        else return -1;
+    }
+    return v;
+}
+
+long json_pull_string(const struct JsonPull *p, char *dst)
+{
+    const char *s = p->str, *end = p->str + p->str_len;
+    char *d = dst;
+
+    if (!p->escaped) {
+        memcpy(dst, s, p->str_len);
+        dst[p->str_len] = '\0';
+        return p->str_len;
+    }
+
+    while (s < end) {
+        const char *bs = memchr(s, '\\', end - s);
+        long cp;
+
+        if (!bs) bs = end;
+        memcpy(d, s, bs - s);
+        d += bs - s;
+        s = bs;
+        if (s >= end) break;
+
+        s++;
+        if (s >= end) break;
+        switch (*s++) {
+        case 'b': *d++ = '\b'; continue;
+        case 'f': *d++ = '\f'; continue;
+        case 'n': *d++ = '\n'; continue;
+        case 'r': *d++ = '\r'; continue;
+        case 't': *d++ = '\t'; continue;
+        case 'u': break;
+        default:  *d++ = s[-1]; continue;   /* \" \\ \/ */
+        }
+
+        cp = hex4(s, end - s);
+        if (cp < 0) { *d++ = '?'; continue; }
+        s += 4;
+        if (cp >= 0xD800 && cp <= 0xDBFF && end - s >= 6 &&
+            s[0] == '\\' && s[1] == 'u') {
+            long lo = hex4(s + 2, end - s - 2);
+            if (lo >= 0xDC00 && lo <= 0xDFFF) {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                s += 6;
+            }
+        }
+
+        if (cp < 0x80) {
+            *d++ = (char)cp;
+        } else if (cp < 0x800) {
+            *d++ = (char)(0xC0 | (cp >> 6));
+            *d++ = (char)(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            *d++ = (char)(0xE0 | (cp >> 12));
+            *d++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+            *d++ = (char)(0x80 | (cp & 0x3F));
+        } else {
+            *d++ = (char)(0xF0 | (cp >> 18));
+            *d++ = (char)(0x80 | ((cp >> 12) & 0x3F));
+            *d++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+            *d++ = (char)(0x80 | (cp & 0x3F));
+        }
+    }
+
+    *d = '\0';
+    return d - dst;
+}
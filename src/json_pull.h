@@ -0,0 +1,64 @@
+#ifndef AMIGAAI_JSON_PULL_H
+#define AMIGAAI_JSON_PULL_H
+
+#include "cJSON.h"   /* cJSON_number */
+
+#define JSON_PULL_MAX_DEPTH 32
+
+/* Events returned by json_pull_next() */
+enum {
+    JSON_PULL_ERROR = -1,   /* Malformed or incomplete input */
+    JSON_PULL_OBJECT_START = 1,
+    JSON_PULL_OBJECT_END,
+    JSON_PULL_ARRAY_START,
+    JSON_PULL_ARRAY_END,
+    JSON_PULL_KEY,          /* Object key: str/str_len */
+    JSON_PULL_STRING,       /* String value: str/str_len */
+    JSON_PULL_NUMBER,       /* number (str/str_len hold the literal) */
+    JSON_PULL_BOOL,         /* boolean */
+    JSON_PULL_NULL,
+    JSON_PULL_END           /* Top-level value complete */
+};
+
+/* Event-driven (pull) JSON parser. Reports one token per call without
+ * building a cJSON tree, from a complete buffer parsed in place. */
+struct JsonPull {
+    const char *buf;        /* Input */
+    long  len, pos;
+
+    int   depth;            /* Open objects/arrays */
+    char  stack[JSON_PULL_MAX_DEPTH];   /* '{' or '[' per level */
+    int   state;
+    int   skip_to;          /* Target depth of json_pull_skip(), or -1 */
+
+    /* Current token. str points into the input buffer; for strings it
+     * holds the raw contents between the quotes, escapes not decoded. */
+    const char *str;
+    long   str_len;
+    int    escaped;         /* str contains backslash escapes */
+    cJSON_number number;
+    int    boolean;
+};
+
+/* Parse a complete buffer in place (no copy). Nothing to free. */
+void json_pull_init(struct JsonPull *p, const char *text, long len);
+
+/* Return the next event. */
+int json_pull_next(struct JsonPull *p);
+
+/* Skip the value that follows a KEY event, or the rest of the object
+ * or array just started. Returns JSON_PULL_ERROR or the last event of
+ * the skipped value. */
+int json_pull_skip(struct JsonPull *p);
+
+/* Compare the current KEY or STRING with a NUL-terminated string.
+ * Strings containing escapes never match. */
+int json_pull_is(const struct JsonPull *p, const char *s);
+
+/* Decode the current KEY or STRING (escapes resolved, UTF-8) and
+ * store it in dst. dst must have room for str_len + 1 bytes; \u
+ * escapes never grow. Returns the number of bytes written (excluding
+ * the NUL that is always added). */
+long json_pull_string(const struct JsonPull *p, char *dst);
+
+#endif /* AMIGAAI_JSON_PULL_H */
@@ -4,109 +4,264 @@
 #include <stdlib.h>
 #include <string.h>
 
+/* Word-at-a-time ASCII scanning, as in cJSON's string scanner: most
+ * text is plain ASCII, which both conversions only need to copy. */
+typedef unsigned int ascii_word;    /* 32 bits on all our targets */
+#if defined(__GNUC__)
+typedef unsigned int __attribute__((__may_alias__)) ascii_word_alias;
+#else
+typedef unsigned int ascii_word_alias;
+#endif
+
+#define WORD_ONES  0x01010101U
+#define WORD_HIGHS 0x80808080U
+#define IS_WORD_ALIGNED(p) ((((size_t)(p)) & (sizeof(ascii_word) - 1)) == 0)
+
+/* Length of the run of 7-bit characters at s (NUL-terminated).
+ * The last aligned word may extend past the NUL; it never crosses
+ * into another word, so it cannot leave the string's memory block. */
+#if defined(__SANITIZE_ADDRESS__)
+__attribute__((no_sanitize_address))
+#endif
+static size_t ascii_run(const unsigned char *s)
+{
+    const unsigned char *p = s;
+
+    while (!IS_WORD_ALIGNED(p)) {
+        if (*p == 0 || *p >= 0x80)
+            return (size_t)(p - s);
+        p++;
+    }
+    for (;;) {
+        ascii_word w = *(const ascii_word_alias *)p;
+        if ((w | ((w - WORD_ONES) & ~w)) & WORD_HIGHS)
+            break;
+        p += sizeof(ascii_word);
+    }
+    while (*p != 0 && *p < 0x80)
+        p++;
+
+    return (size_t)(p - s);
+}
+
 /* Convert ISO-8859-1 (AmigaOS) to UTF-8 (API).
  * Caller must free() the result. */
 static char *iso8859_to_utf8(const char *src)
 {
-    const unsigned char *s = (const unsigned char *)src;
-    int len = 0, i;
-    char *dst, *d;
+    const unsigned char *s = (const unsigned char *)src, *p;
+    size_t ascii = ascii_run(s), extra = 0;
+    unsigned char *dst, *d;
 
-    /* Calculate output length */
-    for (i = 0; s[i]; i++) {
-        if (s[i] < 0x80)
-            len++;
-        else
-            len += 2;
-    }
+    /* Each byte >= 0x80 becomes two; only the tail needs counting */
+    for (p = s + ascii; *p; p++)
+        extra += *p >> 7;
 
-    dst = malloc(len + 1);
+    dst = malloc((size_t)(p - s) + extra + 1);
     if (!dst) return NULL;
-    d = dst;
 
-    for (i = 0; s[i]; i++) {
-        if (s[i] < 0x80) {
-            *d++ = s[i];
+    memcpy(dst, s, ascii);
+    d = dst + ascii;
+    for (p = s + ascii; *p; p++) {
+        if (*p < 0x80) {
+            *d++ = *p;
         } else {
-            *d++ = 0xC0 | (s[i] >> 6);
-            *d++ = 0x80 | (s[i] & 0x3F);
+            *d++ = 0xC0 | (*p >> 6);
+            *d++ = 0x80 | (*p & 0x3F);
         }
     }
     *d = '\0';
-    return dst;
+    return (char *)dst;
 }
 
-/* Convert UTF-8 (API response) to ISO-8859-1 (AmigaOS).
- * Characters outside ISO-8859-1 are replaced with '?'.
- * Caller must free() the result. */
-char *json_utf8_to_iso8859(const char *src)
+/* Stand-ins for common characters outside Latin-1, sorted by code
+ * point. A replacement is never longer than the character's UTF-8
+ * sequence, so conversion can run in place. */
+static const struct {
+    unsigned short cp;
+    char text[4];
+} translit[] = {
+    { 0x0152, "OE" },  { 0x0153, "oe" },  { 0x0160, "S" },   { 0x0161, "s" },
+    { 0x0178, "Y" },   { 0x017D, "Z" },   { 0x017E, "z" },   { 0x0192, "f" },
+    { 0x02C6, "^" },   { 0x02DC, "~" },
+    { 0x2002, " " },   { 0x2003, " " },   { 0x2009, " " },   { 0x200A, " " },
+    { 0x200B, "" },    { 0x2010, "-" },   { 0x2011, "-" },   { 0x2012, "-" },
+    { 0x2013, "-" },   { 0x2014, "--" },  { 0x2015, "--" },  { 0x2018, "'" },
+    { 0x2019, "'" },   { 0x201A, "," },   { 0x201B, "'" },   { 0x201C, "\"" },
+    { 0x201D, "\"" },  { 0x201E, "\"" },  { 0x2020, "+" },   { 0x2022, "\267" },
+    { 0x2026, "..." }, { 0x202F, " " },   { 0x2032, "'" },   { 0x2033, "\"" },
+    { 0x2039, "<" },   { 0x203A, ">" },   { 0x2044, "/" },   { 0x20AC, "EUR" },
+    { 0x2122, "TM" },  { 0x2190, "<-" },  { 0x2192, "->" },  { 0x2194, "<->" },
+    { 0x21D2, "=>" },  { 0x2212, "-" },   { 0x2248, "~" },   { 0x2260, "!=" },
+    { 0x2264, "<=" },  { 0x2265, ">=" },  { 0x2500, "-" },   { 0x2502, "|" },
+    { 0x2713, "v" },   { 0x2714, "v" },   { 0x2717, "x" },   { 0xFEFF, "" }
+};
+
+static const char *transliterate(unsigned long cp)
+{
+    int lo = 0, hi = (int)(sizeof(translit) / sizeof(translit[0])) - 1;
+
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (translit[mid].cp == cp)
+            return translit[mid].text;
+        if (translit[mid].cp < cp)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+    return NULL;
+}
+
+#define IS_CONT(c) (((c) & 0xC0) == 0x80)
+
+/* Convert UTF-8 at src to ISO-8859-1 at dst, which may be src itself:
+ * the output never gets ahead of the input. Returns the new length. */
+static size_t utf8_to_iso(char *dst, const char *src)
 {
     const unsigned char *s = (const unsigned char *)src;
-    int len = strlen(src);
-    char *dst, *d;
-    int i;
+    unsigned char *d = (unsigned char *)dst;
+
+    for (;;) {
+        size_t n = ascii_run(s);
+        unsigned long cp;
+        const char *t;
+        int len;
+
+        if (d != s)
+            memmove(d, s, n);
+        d += n;
+        s += n;
+        if (!*s) break;
+
+        if ((s[0] & 0xE0) == 0xC0 && IS_CONT(s[1])) {
+            cp = ((unsigned long)(s[0] & 0x1F) << 6) | (s[1] & 0x3F);
+            if (cp < 0x80) cp = '?';        /* overlong */
+            len = 2;
+        } else if ((s[0] & 0xF0) == 0xE0 && IS_CONT(s[1]) && IS_CONT(s[2])) {
+            cp = ((unsigned long)(s[0] & 0x0F) << 12) |
+                 ((unsigned long)(s[1] & 0x3F) << 6) | (s[2] & 0x3F);
+            if (cp < 0x800) cp = '?';       /* overlong */
+            len = 3;
+        } else if ((s[0] & 0xF8) == 0xF0 && IS_CONT(s[1]) && IS_CONT(s[2]) &&
+                   IS_CONT(s[3])) {
+            *d++ = '?';             /* outside the BMP: emoji etc. */
+            s += 4;
+            continue;
+        } else {
+            *d++ = '?';             /* invalid */
+            s++;
+            continue;
+        }
 
-    dst = malloc(len + 1);
-    if (!dst) return NULL;
-    d = dst;
-
-    for (i = 0; s[i]; ) {
-        if (s[i] < 0x80) {
-            *d++ = s[i++];
-        } else if ((s[i] & 0xE0) == 0xC0 && s[i+1]) {
-            /* 2-byte UTF-8: U+0080..U+07FF */
-            unsigned int cp = ((s[i] & 0x1F) << 6) | (s[i+1] & 0x3F);
-            *d++ = (cp <= 0xFF) ? (char)cp : '?';
-            i += 2;
-        } else if ((s[i] & 0xF0) == 0xE0 && s[i+1] && s[i+2]) {
-            *d++ = '?'; /* 3-byte: outside ISO-8859-1 */
-            i += 3;
-        } else if ((s[i] & 0xF8) == 0xF0 && s[i+1] && s[i+2] && s[i+3]) {
-            *d++ = '?'; /* 4-byte: outside ISO-8859-1 */
-            i += 4;
+        s += len;
+        if (cp <= 0xFF) {
+            *d++ = (unsigned char)cp;
+        } else if ((t = transliterate(cp)) != NULL) {
+            while (*t)
+                *d++ = (unsigned char)*t++;
         } else {
-            *d++ = '?'; /* invalid */
-            i++;
+            *d++ = '?';
         }
     }
     *d = '\0';
+    return (size_t)(d - (unsigned char *)dst);
+}
+
+size_t json_utf8_to_iso8859_inplace(char *str)
+{
+    return utf8_to_iso(str, str);
+}
+
+/* Convert UTF-8 (API response) to ISO-8859-1 (AmigaOS).
+ * Caller must free() the result. */
+char *json_utf8_to_iso8859(const char *src)
+{
+    char *dst = malloc(strlen(src) + 1);
+
+    if (dst)
+        utf8_to_iso(dst, src);
     return dst;
 }
 
-char *json_build_request(const char *model,
-                         int max_tokens,
-                         const char *system,
-                         cJSON *messages_array,
-                         cJSON *tools)
+/* Tree building helpers. Keys are always literals, so they are linked
+ * in without a copy (cJSON_AddItemToObjectCS); the history then holds
+ * one allocation per value instead of two per member. */
+
+/* Add a literal value ("type":"image" and the like) by reference */
+static void add_literal(cJSON *obj, const char *name, const char *value)
+{
+    cJSON_AddItemToObjectCS(obj, name, cJSON_CreateStringReference(value));
+}
+
+/* Add a malloc()ed string, which the tree takes over (freed on failure) */
+static void add_owned(cJSON *obj, const char *name, char *value)
+{
+    cJSON_AddItemToObjectCS(obj, name, cJSON_CreateStringOwned(value));
+}
+
+/* Add an ISO-8859-1 string as UTF-8. The converted copy is the one
+ * that goes into the tree. */
+static void add_utf8(cJSON *obj, const char *name, const char *iso)
+{
+    char *utf8 = iso8859_to_utf8(iso);
+
+    if (utf8)
+        add_owned(obj, name, utf8);
+    else
+        cJSON_AddItemToObjectCS(obj, name, cJSON_CreateString(iso));
+}
+
+cJSON *json_build_request_tree(const char *model,
+                              int max_tokens,
+                              const char *system,
+                              cJSON *messages_array,
+                              cJSON *tools,
+                              int stream)
 {
     cJSON *root;
-    char  *json_str;
 
     root = cJSON_CreateObject();
     if (!root) return NULL;
 
-    cJSON_AddStringToObject(root, "model", model);
+    /* The model name outlives the request, so it is referenced too */
+    add_literal(root, "model", model);
     cJSON_AddNumberToObject(root, "max_tokens", max_tokens);
-
-    if (system && system[0]) {
-        char *sys_utf8 = iso8859_to_utf8(system);
-        cJSON_AddStringToObject(root, "system", sys_utf8 ? sys_utf8 : system);
-        free(sys_utf8);
+    if (stream)
+        cJSON_AddBoolToObject(root, "stream", 1);
+
+    if (system && system[0])
+        add_utf8(root, "system", system);
+
+    /* Tools and messages are referenced, not copied: the caller keeps
+     * ownership, and deleting the tree leaves them alone. Tools that
+     * were serialized once up front are spliced in as raw JSON. */
+    if (cJSON_IsRaw(tools))
+        cJSON_AddItemToObjectCS(root, "tools",
+                                cJSON_CreateRawReference(tools->valuestring));
+    else if (tools && cJSON_GetArraySize(tools) > 0)
+        cJSON_AddItemReferenceToObject(root, "tools", tools);
+
+    if (!cJSON_AddItemReferenceToObject(root, "messages", messages_array)) {
+        cJSON_Delete(root);
+        return NULL;
     }
 
-    /* Add tools array if provided */
-    if (tools && cJSON_GetArraySize(tools) > 0) {
-        cJSON *dup = cJSON_Duplicate(tools, 1);
-        if (dup)
-            cJSON_AddItemToObject(root, "tools", dup);
-    }
+    return root;
+}
 
-    /* Add a duplicate of the messages array so the caller keeps ownership */
-    {
-        cJSON *dup = cJSON_Duplicate(messages_array, 1);
-        if (!dup) { cJSON_Delete(root); return NULL; }
-        cJSON_AddItemToObject(root, "messages", dup);
-    }
+char *json_build_request(const char *model,
+                         int max_tokens,
+                         const char *system,
+                         cJSON *messages_array,
+                         cJSON *tools,
+                         int stream)
+{
+    cJSON *root;
+    char  *json_str;
+
+    root = json_build_request_tree(model, max_tokens, system,
+                                   messages_array, tools, stream);
+    if (!root) return NULL;
 
     json_str = cJSON_PrintUnformatted(root);
     cJSON_Delete(root);
@@ -117,17 +272,14 @@ char *json_build_request(const char *model,
 cJSON *json_make_message(const char *role, const char *content)
 {
     cJSON *msg;
-    char *utf8;
 
     msg = cJSON_CreateObject();
     if (!msg) return NULL;
 
-    cJSON_AddStringToObject(msg, "role", role);
+    add_literal(msg, "role", role);
 
     /* Convert ISO-8859-1 content to UTF-8 for the API */
-    utf8 = iso8859_to_utf8(content);
-    cJSON_AddStringToObject(msg, "content", utf8 ? utf8 : content);
-    free(utf8);
+    add_utf8(msg, "content", content);
 
     return msg;
 }
@@ -139,8 +291,8 @@ cJSON *json_make_content_message(const char *role, cJSON *content_array)
     msg = cJSON_CreateObject();
     if (!msg) return NULL;
 
-    cJSON_AddStringToObject(msg, "role", role);
-    cJSON_AddItemToObject(msg, "content", content_array);
+    add_literal(msg, "role", role);
+    cJSON_AddItemToObjectCS(msg, "content", content_array);
 
     return msg;
 }
@@ -152,109 +304,127 @@ cJSON *json_make_tool_result(const char *tool_use_id,
     cJSON *block = cJSON_CreateObject();
     if (!block) return NULL;
 
-    cJSON_AddStringToObject(block, "type", "tool_result");
-    cJSON_AddStringToObject(block, "tool_use_id", tool_use_id);
+    add_literal(block, "type", "tool_result");
+    cJSON_AddItemToObjectCS(block, "tool_use_id",
+                            cJSON_CreateString(tool_use_id));
     /* Convert tool result from ISO-8859-1 to UTF-8 */
-    {
-        char *utf8 = result ? iso8859_to_utf8(result) : NULL;
-        cJSON_AddStringToObject(block, "content", utf8 ? utf8 : (result ? result : ""));
-        free(utf8);
-    }
+    add_utf8(block, "content", result ? result : "");
 
     if (is_error)
-        cJSON_AddTrueToObject(block, "is_error");
+        cJSON_AddItemToObjectCS(block, "is_error", cJSON_CreateTrue());
 
     return block;
 }
 
+/* Build an image content block with either inline data or a reference
+ * to a file uploaded through the Files API. image is consumed: it
+ * becomes the "data" blob (base64 when serialized), or is freed. */
+static cJSON *make_image_block(unsigned char *image, long image_len,
+                               const char *file_id,
+                               const char *media_type)
+{
+    cJSON *img, *source;
+
+    img = cJSON_CreateObject();
+    source = img ? cJSON_CreateObject() : NULL;
+    if (!source) {
+        cJSON_Delete(img);
+        free(image);
+        return NULL;
+    }
+
+    add_literal(img, "type", "image");
+    if (file_id) {
+        add_literal(source, "type", "file");
+        cJSON_AddItemToObjectCS(source, "file_id", cJSON_CreateString(file_id));
+        free(image);
+    } else {
+        add_literal(source, "type", "base64");
+        add_literal(source, "media_type",
+                    media_type ? media_type : "image/png");
+        cJSON_AddItemToObjectCS(source, "data",
+                                cJSON_CreateBlobOwned(image, (size_t)image_len));
+    }
+    cJSON_AddItemToObjectCS(img, "source", source);
+
+    return img;
+}
+
 cJSON *json_make_tool_result_with_image(const char *tool_use_id,
-                                         const char *image_base64,
+                                         unsigned char *image,
+                                         long image_len,
+                                         const char *file_id,
                                          const char *media_type,
                                          const char *alt_text)
 {
-    cJSON *block, *content, *img, *source, *text;
+    cJSON *block, *content, *img, *text;
 
     block = cJSON_CreateObject();
-    if (!block) return NULL;
-
-    cJSON_AddStringToObject(block, "type", "tool_result");
-    cJSON_AddStringToObject(block, "tool_use_id", tool_use_id);
+    content = block ? cJSON_CreateArray() : NULL;
+    if (!content) {
+        cJSON_Delete(block);
+        free(image);
+        return NULL;
+    }
 
-    content = cJSON_CreateArray();
-    if (!content) { cJSON_Delete(block); return NULL; }
+    add_literal(block, "type", "tool_result");
+    cJSON_AddItemToObjectCS(block, "tool_use_id",
+                            cJSON_CreateString(tool_use_id));
 
     /* Image block */
-    img = cJSON_CreateObject();
-    if (img) {
-        cJSON_AddStringToObject(img, "type", "image");
-        source = cJSON_CreateObject();
-        if (source) {
-            cJSON_AddStringToObject(source, "type", "base64");
-            cJSON_AddStringToObject(source, "media_type",
-                                    media_type ? media_type : "image/png");
-            cJSON_AddStringToObject(source, "data", image_base64);
-            cJSON_AddItemToObject(img, "source", source);
-        }
+    img = make_image_block(image, image_len, file_id, media_type);
+    if (img)
         cJSON_AddItemToArray(content, img);
-    }
 
     /* Text block */
     if (alt_text) {
         text = cJSON_CreateObject();
         if (text) {
-            cJSON_AddStringToObject(text, "type", "text");
-            cJSON_AddStringToObject(text, "text", alt_text);
+            add_literal(text, "type", "text");
+            cJSON_AddItemToObjectCS(text, "text", cJSON_CreateString(alt_text));
             cJSON_AddItemToArray(content, text);
         }
     }
 
-    cJSON_AddItemToObject(block, "content", content);
+    cJSON_AddItemToObjectCS(block, "content", content);
 
     return block;
 }
 
-cJSON *json_make_user_image_message(const char *image_base64,
+cJSON *json_make_user_image_message(unsigned char *image,
+                                     long image_len,
+                                     const char *file_id,
                                      const char *media_type,
                                      const char *text)
 {
-    cJSON *msg, *content, *img, *source, *txt;
+    cJSON *msg, *content, *img, *txt;
 
     msg = cJSON_CreateObject();
-    if (!msg) return NULL;
-
-    cJSON_AddStringToObject(msg, "role", "user");
+    content = msg ? cJSON_CreateArray() : NULL;
+    if (!content) {
+        cJSON_Delete(msg);
+        free(image);
+        return NULL;
+    }
 
-    content = cJSON_CreateArray();
-    if (!content) { cJSON_Delete(msg); return NULL; }
+    add_literal(msg, "role", "user");
 
     /* Image block */
-    img = cJSON_CreateObject();
-    if (img) {
-        cJSON_AddStringToObject(img, "type", "image");
-        source = cJSON_CreateObject();
-        if (source) {
-            cJSON_AddStringToObject(source, "type", "base64");
-            cJSON_AddStringToObject(source, "media_type",
-                                    media_type ? media_type : "image/png");
-            cJSON_AddStringToObject(source, "data", image_base64);
-            cJSON_AddItemToObject(img, "source", source);
-        }
+    img = make_image_block(image, image_len, file_id, media_type);
+    if (img)
         cJSON_AddItemToArray(content, img);
-    }
 
     /* Text block */
     if (text) {
-        char *utf8 = iso8859_to_utf8(text);
         txt = cJSON_CreateObject();
         if (txt) {
-            cJSON_AddStringToObject(txt, "type", "text");
-            cJSON_AddStringToObject(txt, "text", utf8 ? utf8 : text);
+            add_literal(txt, "type", "text");
+            add_utf8(txt, "text", text);
             cJSON_AddItemToArray(content, txt);
         }
-        free(utf8);
     }
 
-    cJSON_AddItemToObject(msg, "content", content);
+    cJSON_AddItemToObjectCS(msg, "content", content);
     return msg;
 }
 
@@ -322,22 +492,56 @@ char *json_parse_response(const char *json_str, char **error_msg)
     }
 
     /* Convert UTF-8 response to ISO-8859-1 for AmigaOS display */
-    {
-        char *iso = json_utf8_to_iso8859(result);
-        if (iso) { free(result); result = iso; }
-    }
+    json_utf8_to_iso8859_inplace(result);
 
     cJSON_Delete(root);
     return result;
 }
 
+/* Concatenate all text blocks of a content array (newline-separated)
+ * and convert the result to ISO-8859-1.
+ * Returns newly allocated string or NULL if there is no text. */
+static char *content_text(cJSON *content)
+{
+    int i, count = cJSON_GetArraySize(content);
+    char *buf = NULL;
+    int buf_len = 0, buf_cap = 0;
+
+    for (i = 0; i < count; i++) {
+        cJSON *item = cJSON_GetArrayItem(content, i);
+        cJSON *type = cJSON_GetObjectItemCaseSensitive(item, "type");
+        if (type && cJSON_IsString(type) &&
+            strcmp(type->valuestring, "text") == 0)
+        {
+            cJSON *text_obj = cJSON_GetObjectItemCaseSensitive(item, "text");
+            if (text_obj && cJSON_IsString(text_obj)) {
+                int tlen = strlen(text_obj->valuestring);
+                int needed = buf_len + tlen + 2;
+                if (needed > buf_cap) {
+                    buf_cap = needed + 256;
+                    buf = realloc(buf, buf_cap);
+                }
+                if (buf) {
+                    if (buf_len > 0) buf[buf_len++] = '\n';
+                    memcpy(buf + buf_len, text_obj->valuestring, tlen);
+                    buf_len += tlen;
+                    buf[buf_len] = '\0';
+                }
+            }
+        }
+    }
+    /* Convert UTF-8 response to ISO-8859-1 for AmigaOS display */
+    if (buf)
+        json_utf8_to_iso8859_inplace(buf);
+    return buf;
+}
+
 cJSON *json_parse_full_response(const char *json_str,
                                 char **stop_reason,
                                 char **text_out,
                                 char **error_msg)
 {
-    cJSON *root, *err_obj, *content, *sr_obj;
-    cJSON *result_content = NULL;
+    cJSON *root, *content;
 
     if (stop_reason) *stop_reason = NULL;
     if (text_out) *text_out = NULL;
@@ -349,8 +553,27 @@ cJSON *json_parse_full_response(const char *json_str,
         return NULL;
     }
 
+    content = json_take_response(root, stop_reason, text_out,
+                                 NULL, NULL, error_msg);
+    cJSON_Delete(root);
+    return content;
+}
+
+cJSON *json_take_response(cJSON *message,
+                          char **stop_reason,
+                          char **text_out,
+                          int *input_tokens,
+                          int *output_tokens,
+                          char **error_msg)
+{
+    cJSON *err_obj, *content, *sr_obj, *usage, *val;
+
+    if (stop_reason) *stop_reason = NULL;
+    if (text_out) *text_out = NULL;
+    if (error_msg) *error_msg = NULL;
+
     /* Check for error response */
-    err_obj = cJSON_GetObjectItemCaseSensitive(root, "error");
+    err_obj = cJSON_GetObjectItemCaseSensitive(message, "error");
     if (err_obj) {
         cJSON *msg_obj = cJSON_GetObjectItemCaseSensitive(err_obj, "message");
         if (error_msg) {
@@ -359,65 +582,115 @@ cJSON *json_parse_full_response(const char *json_str,
             else
                 *error_msg = strdup("Unknown API error");
         }
-        cJSON_Delete(root);
         return NULL;
     }
 
-    /* Extract stop_reason */
-    sr_obj = cJSON_GetObjectItemCaseSensitive(root, "stop_reason");
-    if (sr_obj && cJSON_IsString(sr_obj) && stop_reason)
-        *stop_reason = strdup(sr_obj->valuestring);
-
     /* Extract content array */
-    content = cJSON_GetObjectItemCaseSensitive(root, "content");
+    content = cJSON_GetObjectItemCaseSensitive(message, "content");
     if (!content || !cJSON_IsArray(content)) {
         if (error_msg) *error_msg = strdup("No content in response");
-        cJSON_Delete(root);
         return NULL;
     }
 
+    /* Extract stop_reason */
+    sr_obj = cJSON_GetObjectItemCaseSensitive(message, "stop_reason");
+    if (sr_obj && cJSON_IsString(sr_obj) && stop_reason)
+        *stop_reason = strdup(sr_obj->valuestring);
+
+    /* Extract token usage */
+    usage = cJSON_GetObjectItemCaseSensitive(message, "usage");
+    val = cJSON_GetObjectItemCaseSensitive(usage, "input_tokens");
+    if (input_tokens && cJSON_IsNumber(val))
+        *input_tokens = (int)val->valuedouble;
+    val = cJSON_GetObjectItemCaseSensitive(usage, "output_tokens");
+    if (output_tokens && cJSON_IsNumber(val))
+        *output_tokens = (int)val->valuedouble;
+
     /* Extract all text blocks concatenated */
-    if (text_out) {
-        int i, count = cJSON_GetArraySize(content);
-        char *buf = NULL;
-        int buf_len = 0, buf_cap = 0;
+    if (text_out)
+        *text_out = content_text(content);
 
-        for (i = 0; i < count; i++) {
-            cJSON *item = cJSON_GetArrayItem(content, i);
-            cJSON *type = cJSON_GetObjectItemCaseSensitive(item, "type");
-            if (type && cJSON_IsString(type) &&
-                strcmp(type->valuestring, "text") == 0)
-            {
-                cJSON *text_obj = cJSON_GetObjectItemCaseSensitive(item, "text");
-                if (text_obj && cJSON_IsString(text_obj)) {
-                    int tlen = strlen(text_obj->valuestring);
-                    int needed = buf_len + tlen + 2;
-                    if (needed > buf_cap) {
-                        buf_cap = needed + 256;
-                        buf = realloc(buf, buf_cap);
-                    }
-                    if (buf) {
-                        if (buf_len > 0) buf[buf_len++] = '\n';
-                        memcpy(buf + buf_len, text_obj->valuestring, tlen);
-                        buf_len += tlen;
-                        buf[buf_len] = '\0';
-                    }
-                }
-            }
-        }
-        /* Convert UTF-8 response to ISO-8859-1 for AmigaOS display */
-        if (buf) {
-            char *iso = json_utf8_to_iso8859(buf);
-            if (iso) { free(buf); buf = iso; }
-        }
-        *text_out = buf;
+    /* Hand the content array to the caller without copying */
+    return cJSON_DetachItemViaPointer(message, content);
+}
+
+cJSON *json_make_batch_entry(const char *custom_id,
+                             const char *model,
+                             int max_tokens,
+                             const char *system,
+                             const char *prompt)
+{
+    cJSON *entry, *params, *messages, *msg;
+
+    entry = cJSON_CreateObject();
+    if (!entry) return NULL;
+
+    cJSON_AddStringToObject(entry, "custom_id", custom_id);
+
+    params = cJSON_AddObjectToObject(entry, "params");
+    messages = cJSON_CreateArray();
+    msg = json_make_message("user", prompt);
+    if (!params || !messages || !msg) {
+        cJSON_Delete(msg);
+        cJSON_Delete(messages);
+        cJSON_Delete(entry);
+        return NULL;
+    }
+
+    cJSON_AddStringToObject(params, "model", model);
+    cJSON_AddNumberToObject(params, "max_tokens", max_tokens);
+
+    if (system && system[0])
+        add_utf8(params, "system", system);
+
+    cJSON_AddItemToArray(messages, msg);
+    cJSON_AddItemToObject(params, "messages", messages);
+
+    return entry;
+}
+
+char *json_parse_batch_result(const char *line,
+                              char **custom_id,
+                              char **result_type)
+{
+    cJSON *root, *id_obj, *result, *type_obj;
+    char *text = NULL;
+
+    *custom_id = NULL;
+    *result_type = NULL;
+
+    root = cJSON_Parse(line);
+    if (!root) return NULL;
+
+    id_obj = cJSON_GetObjectItemCaseSensitive(root, "custom_id");
+    result = cJSON_GetObjectItemCaseSensitive(root, "result");
+    type_obj = cJSON_GetObjectItemCaseSensitive(result, "type");
+
+    if (!cJSON_IsString(id_obj) || !cJSON_IsString(type_obj)) {
+        cJSON_Delete(root);
+        return NULL;
     }
 
-    /* Duplicate content array so caller owns it */
-    result_content = cJSON_Duplicate(content, 1);
+    *custom_id = strdup(id_obj->valuestring);
+    *result_type = strdup(type_obj->valuestring);
+
+    if (strcmp(type_obj->valuestring, "succeeded") == 0) {
+        cJSON *message = cJSON_GetObjectItemCaseSensitive(result, "message");
+        text = content_text(cJSON_GetObjectItemCaseSensitive(message, "content"));
+        if (!text) text = strdup("");
+    } else {
+        /* errored: {"error":{"type":...,"error":{"message":...}}} */
+        cJSON *err = cJSON_GetObjectItemCaseSensitive(result, "error");
+        cJSON *inner = cJSON_GetObjectItemCaseSensitive(err, "error");
+        cJSON *msg_obj = cJSON_GetObjectItemCaseSensitive(
+                             inner ? inner : err, "message");
+        if (cJSON_IsString(msg_obj))
+            text = json_utf8_to_iso8859(msg_obj->valuestring);
+        if (!text) text = strdup(type_obj->valuestring);
+    }
 
     cJSON_Delete(root);
-    return result_content;
+    return text;
 }
 
 int json_parse_usage(const char *json_str, int *input_tokens, int *output_tokens)
@@ -450,8 +723,9 @@ int json_parse_usage(const char *json_str, int *input_tokens, int *output_tokens
 }
 
 /* Recursively convert all string values in a cJSON tree from UTF-8 to
- * ISO-8859-1.  Modifies the tree in-place by replacing valuestring
- * pointers.  Use on tool input objects before passing to AmigaOS. */
+ * ISO-8859-1.  Strings the tree owns are converted in place; borrowed
+ * ones (references) are replaced by converted copies.  Use on tool
+ * input objects before passing to AmigaOS. */
 void json_convert_strings_to_iso8859(cJSON *obj)
 {
     cJSON *child;
@@ -459,10 +733,14 @@ void json_convert_strings_to_iso8859(cJSON *obj)
     if (!obj) return;
 
     if (cJSON_IsString(obj) && obj->valuestring) {
-        char *iso = json_utf8_to_iso8859(obj->valuestring);
-        if (iso) {
-            cJSON_free(obj->valuestring);
-            obj->valuestring = iso;
+        if (!(obj->type & cJSON_IsReference)) {
+            json_utf8_to_iso8859_inplace(obj->valuestring);
+        } else {
+            char *iso = json_utf8_to_iso8859(obj->valuestring);
+            if (iso) {
+                obj->valuestring = iso;
+                obj->type &= ~cJSON_IsReference;
+            }
         }
     }
 
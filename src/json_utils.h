@@ -5,13 +5,27 @@
 
 /* Build the JSON request body for the Claude Messages API.
  * messages_array is a cJSON array containing the conversation.
- * system may be NULL. tools may be NULL (no tool use).
+ * system may be NULL. tools may be NULL (no tool use), an array of
+ * tool definitions, or a raw item holding that array pre-serialized.
+ * stream non-zero requests a server-sent event response.
  * Returns a newly allocated JSON string (caller must free). */
 char *json_build_request(const char *model,
                          int max_tokens,
                          const char *system,
                          cJSON *messages_array,
-                         cJSON *tools);
+                         cJSON *tools,
+                         int stream);
+
+/* Same request as a cJSON tree, for serializing with json_write().
+ * model, messages_array and tools are referenced, not copied: they must stay
+ * unchanged while the tree is in use (caller must cJSON_Delete the
+ * tree, which leaves them alone). */
+cJSON *json_build_request_tree(const char *model,
+                               int max_tokens,
+                               const char *system,
+                               cJSON *messages_array,
+                               cJSON *tools,
+                               int stream);
 
 /* Parse a Claude API response and extract the assistant's text reply.
  * Returns a newly allocated string (caller must free()) or NULL on error.
@@ -19,7 +33,7 @@ char *json_build_request(const char *model,
 char *json_parse_response(const char *json_str, char **error_msg);
 
 /* Parse full response: return the content array and stop_reason.
- * Returns a duplicated cJSON content array (caller must cJSON_Delete).
+ * Returns the cJSON content array (caller must cJSON_Delete).
  * Sets *stop_reason to "end_turn", "tool_use", etc. (caller must free).
  * Also extracts any text blocks into *text_out (caller must free, may be NULL). */
 cJSON *json_parse_full_response(const char *json_str,
@@ -27,11 +41,24 @@ cJSON *json_parse_full_response(const char *json_str,
                                 char **text_out,
                                 char **error_msg);
 
-/* Create a message object {"role":"...", "content":"..."} */
+/* Same for an already parsed response message, also extracting usage.
+ * The content array is detached from message, not copied; the caller
+ * owns it and still deletes message. input_tokens/output_tokens (may be
+ * NULL) are left unchanged if the message has no usage. */
+cJSON *json_take_response(cJSON *message,
+                          char **stop_reason,
+                          char **text_out,
+                          int *input_tokens,
+                          int *output_tokens,
+                          char **error_msg);
+
+/* Create a message object {"role":"...", "content":"..."}
+ * role is referenced, not copied: pass a string literal. */
 cJSON *json_make_message(const char *role, const char *content);
 
 /* Create a message with a content array: {"role":"...", "content":[...]}
- * content_array is consumed (added to message, not duplicated). */
+ * content_array is consumed (added to message, not duplicated).
+ * role is referenced, not copied: pass a string literal. */
 cJSON *json_make_content_message(const char *role, cJSON *content_array);
 
 /* Build a tool_result content block.
@@ -40,13 +67,20 @@ cJSON *json_make_tool_result(const char *tool_use_id,
                              const char *result,
                              int is_error);
 
-/* Build a tool_result with an image content block (base64-encoded).
+/* Build a tool_result with an image content block.
  * Returns: {"type":"tool_result", "tool_use_id":"...", "content":[
  *   {"type":"image", "source":{"type":"base64","media_type":"...","data":"..."}},
  *   {"type":"text", "text":"..."}
- * ]} */
+ * ]}
+ * If file_id is not NULL, the image references an uploaded file instead:
+ *   "source":{"type":"file","file_id":"..."}.
+ * image (malloc()ed, image_len bytes) is consumed in every case: it
+ * becomes the "data" member as a binary blob, which is base64-encoded
+ * only when the tree is serialized, or it is freed. */
 cJSON *json_make_tool_result_with_image(const char *tool_use_id,
-                                         const char *image_base64,
+                                         unsigned char *image,
+                                         long image_len,
+                                         const char *file_id,
                                          const char *media_type,
                                          const char *alt_text);
 
@@ -54,18 +88,48 @@ cJSON *json_make_tool_result_with_image(const char *tool_use_id,
  * Returns: {"role":"user", "content":[
  *   {"type":"image", "source":{"type":"base64","media_type":"...","data":"..."}},
  *   {"type":"text", "text":"..."}
- * ]} */
-cJSON *json_make_user_image_message(const char *image_base64,
+ * ]}
+ * file_id and image work as for json_make_tool_result_with_image(). */
+cJSON *json_make_user_image_message(unsigned char *image,
+                                     long image_len,
+                                     const char *file_id,
                                      const char *media_type,
                                      const char *text);
 
+/* Build one entry of a Message Batches request:
+ * {"custom_id":"...", "params":{"model":"...","max_tokens":N,
+ *   "system":"...","messages":[{"role":"user","content":"..."}]}}
+ * system may be NULL. system and prompt are ISO-8859-1 and are
+ * converted to UTF-8. Returns a new cJSON object or NULL. */
+cJSON *json_make_batch_entry(const char *custom_id,
+                             const char *model,
+                             int max_tokens,
+                             const char *system,
+                             const char *prompt);
+
+/* Parse one line of a Message Batches results file (JSONL).
+ * Sets *custom_id and *result_type ("succeeded", "errored", ...),
+ * both newly allocated (caller must free).
+ * Returns the concatenated text of a succeeded result, or the error
+ * message otherwise, converted to ISO-8859-1 (caller must free).
+ * Returns NULL if the line cannot be parsed. */
+char *json_parse_batch_result(const char *line,
+                              char **custom_id,
+                              char **result_type);
+
 /* Parse usage info from response. Returns 0 on success. */
 int json_parse_usage(const char *json_str, int *input_tokens, int *output_tokens);
 
-/* Convert a UTF-8 string to ISO-8859-1. Characters outside Latin-1 become '?'.
+/* Convert a UTF-8 string to ISO-8859-1. Common typographic characters
+ * outside Latin-1 (smart quotes, dashes, ellipsis, arrows...) become
+ * ASCII look-alikes, anything else becomes '?'.
  * Returns newly allocated string (caller must free) or NULL on alloc failure. */
 char *json_utf8_to_iso8859(const char *src);
 
+/* Same conversion in place (the result is never longer than the input).
+ * Returns the new length. */
+size_t json_utf8_to_iso8859_inplace(char *str);
+
 /* Convert all string values in a cJSON object tree from UTF-8 to ISO-8859-1.
  * Modifies the cJSON tree in-place. Use on tool input before passing to AmigaOS. */
 void json_convert_strings_to_iso8859(cJSON *obj);
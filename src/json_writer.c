@@ -0,0 +1,261 @@
+/*
+ * json_writer.c - Streaming JSON serializer for AmigaAI
+ *
+ * Walks a cJSON tree and emits the same text as cJSON_PrintUnformatted(),
+ * but through a fixed buffer that is drained by a callback. A request
+ * carrying megabytes of base64 image data is then sent with constant
+ * memory, without cJSON's realloc-doubling print buffer and without a
+ * second copy of the whole document.
+ */
+
+#include "json_writer.h"
+#include "base64.h"
+
+#include <stdio.h>
+#include <string.h>
+#ifndef CJSON_NO_FLOAT
+#include <float.h>
+#include <math.h>
+#endif
+
+struct JsonWriter {
+    JsonSink sink;
+    void    *userdata;
+    long     total;
+    int      used;
+    int      failed;
+    char     buf[JSON_WRITER_BUF_SIZE];
+};
+
+static void flush(struct JsonWriter *w)
+{
+    if (w->used > 0 && !w->failed &&
+        w->sink(w->buf, w->used, w->userdata) != 0)
+        w->failed = 1;
+    w->used = 0;
+}
+
+static void put(struct JsonWriter *w, const char *data, long len)
+{
+    w->total += len;
+
+    /* Long runs (image data) go to the sink without copying */
+    if (len >= JSON_WRITER_BUF_SIZE) {
+        flush(w);
+        if (!w->failed && w->sink(data, len, w->userdata) != 0)
+            w->failed = 1;
+        return;
+    }
+
+    while (len > 0) {
+        long n = JSON_WRITER_BUF_SIZE - w->used;
+        if (n > len) n = len;
+        memcpy(w->buf + w->used, data, n);
+        w->used += (int)n;
+        data += n;
+        len -= n;
+        if (w->used == JSON_WRITER_BUF_SIZE)
+            flush(w);
+    }
+}
+
+static void put_char(struct JsonWriter *w, char c)
+{
+    if (w->used == JSON_WRITER_BUF_SIZE)
+        flush(w);
+    w->buf[w->used++] = c;
+    w->total++;
+}
+
+/* Binary string (image data): base64-encoded straight into the buffer,
+ * a few kilobytes at a time */
+static void put_blob(struct JsonWriter *w, const unsigned char *data, long len)
+{
+    put_char(w, '"');
+    while (len > 0) {
+        long room = (JSON_WRITER_BUF_SIZE - w->used) / 4 * 3;
+        long n = len < room ? len : room;
+        size_t out;
+
+        if (n < 3 && n < len) {
+            flush(w);
+            continue;
+        }
+        if (n < len)
+            n -= n % 3;     /* only the last piece may be padded */
+        out = base64_encode_block(data, (size_t)n, w->buf + w->used);
+        w->used += (int)out;
+        w->total += (long)out;
+        data += n;
+        len -= n;
+        if (w->used == JSON_WRITER_BUF_SIZE)
+            flush(w);
+    }
+    put_char(w, '"');
+}
+
+/* Same escaping as cJSON's print_string_ptr() */
+static void put_string(struct JsonWriter *w, const char *s)
+{
+    const unsigned char *p = (const unsigned char *)s;
+    const unsigned char *run;
+
+    put_char(w, '"');
+    if (!p) {
+        put_char(w, '"');
+        return;
+    }
+
+    for (;;) {
+        char esc[8];
+
+        run = p;
+        while (*p > 31 && *p != '"' && *p != '\\')
+            p++;
+        if (p > run)
+            put(w, (const char *)run, (long)(p - run));
+        if (!*p) break;
+
+        esc[0] = '\\';
+        switch (*p) {
+        case '"':  esc[1] = '"';  break;
+        case '\\': esc[1] = '\\'; break;
+        case '\b': esc[1] = 'b';  break;
+        case '\f': esc[1] = 'f';  break;
+        case '\n': esc[1] = 'n';  break;
+        case '\r': esc[1] = 'r';  break;
+        case '\t': esc[1] = 't';  break;
+        default:
+            sprintf(esc + 1, "u%04x", *p);
+            put(w, esc, 6);
+            p++;
+            continue;
+        }
+        put(w, esc, 2);
+        p++;
+    }
+
+    put_char(w, '"');
+}
+
+/* Same formatting as cJSON's print_number(): integers without any
+ * floating point, everything else through printf */
+static int put_number(struct JsonWriter *w, const cJSON *item)
+{
+    char num[26];
+    int len = 0;
+#ifdef CJSON_NO_FLOAT
+    long v = item->valuedouble;
+#else
+    double d = item->valuedouble;
+    long v = item->valueint;
+
+    if (d != (double)item->valueint) {
+        double test = 0.0, max;
+        int i;
+
+        if (d - d != 0.0) {         /* NaN or infinity */
+            put(w, "null", 4);
+            return 0;
+        }
+        len = sprintf(num, "%1.15g", d);
+        max = fabs(d);
+        if (sscanf(num, "%lg", &test) != 1 ||
+            fabs(test - d) > (fabs(test) > max ? fabs(test) : max) * DBL_EPSILON)
+            len = sprintf(num, "%1.17g", d);
+        if (len < 0 || len > (int)sizeof(num) - 1)
+            return -1;
+
+        /* Locale-independent decimal point */
+        for (i = 0; i < len; i++)
+            if (num[i] == ',')
+                num[i] = '.';
+
+        put(w, num, len);
+        return 0;
+    }
+#endif
+
+    {
+        char digits[20];
+        unsigned long n = v < 0 ? 0UL - (unsigned long)v : (unsigned long)v;
+        int count = 0;
+
+        do {
+            digits[count++] = (char)('0' + n % 10);
+            n /= 10;
+        } while (n);
+        if (v < 0)
+            num[len++] = '-';
+        while (count > 0)
+            num[len++] = digits[--count];
+    }
+
+    put(w, num, len);
+    return 0;
+}
+
+static int write_value(struct JsonWriter *w, const cJSON *item)
+{
+    const cJSON *child;
+
+    if (!item || w->failed)
+        return -1;
+
+    switch (item->type & 0xFF) {
+    case cJSON_NULL:   put(w, "null", 4);  return 0;
+    case cJSON_False:  put(w, "false", 5); return 0;
+    case cJSON_True:   put(w, "true", 4);  return 0;
+    case cJSON_Number: return put_number(w, item);
+    case cJSON_String:
+        if (item->type & cJSON_StringIsBlob)
+            put_blob(w, (const unsigned char *)item->valuestring, item->valueint);
+        else
+            put_string(w, item->valuestring);
+        return 0;
+
+    case cJSON_Raw:
+        if (!item->valuestring) return -1;
+        put(w, item->valuestring, (long)strlen(item->valuestring));
+        return 0;
+
+    case cJSON_Array:
+        put_char(w, '[');
+        for (child = item->child; child; child = child->next) {
+            if (write_value(w, child) != 0) return -1;
+            if (child->next) put_char(w, ',');
+        }
+        put_char(w, ']');
+        return 0;
+
+    case cJSON_Object:
+        put_char(w, '{');
+        for (child = item->child; child; child = child->next) {
+            put_string(w, child->string);
+            put_char(w, ':');
+            if (write_value(w, child) != 0) return -1;
+            if (child->next) put_char(w, ',');
+        }
+        put_char(w, '}');
+        return 0;
+    }
+
+    return -1;
+}
+
+long json_write(const cJSON *item, JsonSink sink, void *userdata)
+{
+    struct JsonWriter w;
+
+    w.sink     = sink;
+    w.userdata = userdata;
+    w.total    = 0;
+    w.used     = 0;
+    w.failed   = 0;
+
+    if (write_value(&w, item) != 0)
+        return -1;
+    flush(&w);
+
+    return w.failed ? -1 : w.total;
+}
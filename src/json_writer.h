@@ -0,0 +1,20 @@
+#ifndef AMIGAAI_JSON_WRITER_H
+#define AMIGAAI_JSON_WRITER_H
+
+#include "cJSON.h"
+
+#define JSON_WRITER_BUF_SIZE 4096
+
+/* Receives serialized JSON in pieces of at most JSON_WRITER_BUF_SIZE
+ * bytes (longer string runs are passed through directly).
+ * Same signature as HttpDataCallback. Return non-zero to stop. */
+typedef int (*JsonSink)(const char *data, long len, void *userdata);
+
+/* Serialize item like cJSON_PrintUnformatted() (byte for byte), but
+ * through a small fixed buffer that is handed to sink whenever it
+ * fills, instead of rendering the whole document into one growing
+ * string. Returns the number of bytes produced, or -1 if the sink
+ * stopped or the tree contains an invalid item. */
+long json_write(const cJSON *item, JsonSink sink, void *userdata);
+
+#endif /* AMIGAAI_JSON_WRITER_H */
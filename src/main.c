@@ -24,8 +24,9 @@
 #include "memory.h"
 #include "tools.h"
 #include "dt_identify.h"
-#include "base64.h"
 #include "png_convert.h"
+#include "image_scale.h"
+#include "bitmap_read.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -408,8 +409,10 @@ static void handle_send(void)
 
     /* /ports - list all public Exec message ports */
     if (strcasecmp(input, "/ports") == 0) {
-        int is_error = 0, has_image = 0;
-        char *result = tool_execute("list_ports", NULL, &is_error, &has_image);
+        int is_error = 0;
+        long image_len = 0;
+        char *result = tool_execute("list_ports", NULL, &is_error, &image_len,
+                                    NULL);
         gui_add_line(&app_gui, GetString(MSG_CMD_PORTS_TITLE));
         if (result) {
             gui_add_text(&app_gui, NULL, result);
@@ -427,7 +430,8 @@ static void handle_send(void)
         while (*cmd == ' ') cmd++;
         if (*cmd) {
             cJSON *inp = cJSON_CreateObject();
-            int is_error = 0, has_image = 0;
+            int is_error = 0;
+            long image_len = 0;
             char *result;
             char line[256];
 
@@ -436,7 +440,8 @@ static void handle_send(void)
             gui_add_line(&app_gui, line);
             gui_set_status(&app_gui, GetString(MSG_STATUS_EXECUTING));
 
-            result = tool_execute("shell_command", inp, &is_error, &has_image);
+            result = tool_execute("shell_command", inp, &is_error,
+                                  &image_len, NULL);
             cJSON_Delete(inp);
 
             if (result) {
@@ -460,7 +465,8 @@ static void handle_send(void)
             const char *cmd;
             const char *sp = strchr(args, ' ');
             cJSON *inp;
-            int is_error = 0, has_image = 0;
+            int is_error = 0;
+            long image_len = 0;
             char *result;
             char line[256];
 
@@ -486,7 +492,8 @@ static void handle_send(void)
             gui_add_line(&app_gui, line);
             gui_set_status(&app_gui, GetString(MSG_STATUS_AREXX_SENDING));
 
-            result = tool_execute("arexx_command", inp, &is_error, &has_image);
+            result = tool_execute("arexx_command", inp, &is_error,
+                                  &image_len, NULL);
             cJSON_Delete(inp);
 
             if (result) {
@@ -507,7 +514,8 @@ static void handle_send(void)
         while (*path == ' ') path++;
         if (*path) {
             cJSON *inp = cJSON_CreateObject();
-            int is_error = 0, has_image = 0;
+            int is_error = 0;
+            long image_len = 0;
             char *result;
             char line[256];
 
@@ -515,7 +523,8 @@ static void handle_send(void)
             snprintf(line, sizeof(line), GetString(MSG_CMD_READ), path);
             gui_add_line(&app_gui, line);
 
-            result = tool_execute("read_file", inp, &is_error, &has_image);
+            result = tool_execute("read_file", inp, &is_error,
+                                  &image_len, NULL);
             cJSON_Delete(inp);
 
             if (result) {
@@ -538,7 +547,8 @@ static void handle_send(void)
             const char *sp = strchr(args, ' ');
             char path[256];
             cJSON *inp;
-            int is_error = 0, has_image = 0;
+            int is_error = 0;
+            long image_len = 0;
             char *result;
 
             if (!sp) {
@@ -557,7 +567,8 @@ static void handle_send(void)
             cJSON_AddStringToObject(inp, "path", path);
             cJSON_AddStringToObject(inp, "content", sp + 1);
 
-            result = tool_execute("write_file", inp, &is_error, &has_image);
+            result = tool_execute("write_file", inp, &is_error,
+                                  &image_len, NULL);
             cJSON_Delete(inp);
 
             if (result) {
@@ -1203,6 +1214,9 @@ static void insert_path_at_cursor(const char *path)
     }
 }
 
+/* Largest image file sent to the API */
+#define IMAGE_MAX_BYTES (4L * 1024L * 1024L)
+
 static void handle_dropped_file(const char *path, int insert_path)
 {
     char dt_name[64], group[32];
@@ -1233,14 +1247,14 @@ static void handle_dropped_file(const char *path, int insert_path)
     }
 
     if (strcmp(group, "picture") == 0) {
-        /* Image file — read, base64 encode, send to Claude */
+        /* Image file — read and send to Claude */
         FILE *f;
-        char *fdata, *b64, *reply, *error_msg = NULL;
-        long fsize;
+        char *fdata = NULL, *reply, *error_msg = NULL;
+        long fsize = 0;
         char text[320];
         const char *media;
-        const char *read_path = path;
-        int converted = 0;
+        unsigned long pic_w, pic_h, fit_w, fit_h;
+        int rc;
 
         /* Check if format is natively supported by Claude API */
         if (strcasecmp(dt_name, "JPEG") == 0 || strcasecmp(dt_name, "JFIF") == 0) {
@@ -1252,61 +1266,72 @@ static void handle_dropped_file(const char *path, int insert_path)
         } else {
             /* ILBM, BMP, PCX, TIFF, etc. — convert to PNG via DataTypes */
             gui_set_status(&app_gui, "Converting image...");
-            if (png_convert_file(path, "T:aai_dtconv.png") != 0) {
-                snprintf(status_buf, sizeof(status_buf),
-                         "Cannot convert: %s", filename);
+            rc = png_convert_mem(path, app_config.png_level,
+                                 app_config.image_max_edge,
+                                 app_config.image_max_pixels,
+                                 IMAGE_MAX_BYTES,
+                                 (unsigned char **)&fdata, &fsize);
+            if (rc != 0) {
+                if (rc == -2)
+                    snprintf(status_buf, sizeof(status_buf),
+                             "Image too large (max 4MB)");
+                else
+                    snprintf(status_buf, sizeof(status_buf),
+                             "Cannot convert: %s", filename);
                 gui_set_status(&app_gui, status_buf);
                 return;
             }
-            read_path = "T:aai_dtconv.png";
             media = "image/png";
-            converted = 1;
-        }
-
-        f = fopen(read_path, "rb");
-        if (!f) {
-            if (converted) DeleteFile((CONST_STRPTR)"T:aai_dtconv.png");
-            snprintf(status_buf, sizeof(status_buf), "Cannot open: %s", filename);
-            gui_set_status(&app_gui, status_buf);
-            return;
         }
 
-        fseek(f, 0, SEEK_END);
-        fsize = ftell(f);
-        fseek(f, 0, SEEK_SET);
-
-        if (fsize <= 0 || fsize > 4L * 1024L * 1024L) {
-            fclose(f);
-            if (converted) DeleteFile((CONST_STRPTR)"T:aai_dtconv.png");
-            gui_set_status(&app_gui, "Image too large (max 4MB)");
-            return;
+        /* PNG and GIF beyond the size limits are scaled down (to PNG).
+         * JPEG is sent as it is: a photo would grow as PNG. If scaling
+         * fails, the file is sent unchanged. */
+        if (!fdata && strcmp(media, "image/jpeg") != 0 &&
+            png_picture_size(path, &pic_w, &pic_h) == 0 &&
+            scale_fit(pic_w, pic_h, app_config.image_max_edge,
+                      app_config.image_max_pixels, &fit_w, &fit_h)) {
+            gui_set_status(&app_gui, "Scaling image...");
+            if (png_convert_mem(path, app_config.png_level,
+                                app_config.image_max_edge,
+                                app_config.image_max_pixels,
+                                IMAGE_MAX_BYTES,
+                                (unsigned char **)&fdata, &fsize) == 0)
+                media = "image/png";
         }
 
-        fdata = malloc(fsize);
         if (!fdata) {
-            fclose(f);
-            if (converted) DeleteFile((CONST_STRPTR)"T:aai_dtconv.png");
-            gui_set_status(&app_gui, "Out of memory");
-            return;
-        }
+            f = fopen(path, "rb");
+            if (!f) {
+                snprintf(status_buf, sizeof(status_buf), "Cannot open: %s", filename);
+                gui_set_status(&app_gui, status_buf);
+                return;
+            }
 
-        if ((long)fread(fdata, 1, fsize, f) != fsize) {
-            free(fdata);
-            fclose(f);
-            if (converted) DeleteFile((CONST_STRPTR)"T:aai_dtconv.png");
-            gui_set_status(&app_gui, "Read error");
-            return;
-        }
-        fclose(f);
+            fseek(f, 0, SEEK_END);
+            fsize = ftell(f);
+            fseek(f, 0, SEEK_SET);
 
-        if (converted) DeleteFile((CONST_STRPTR)"T:aai_dtconv.png");
+            if (fsize <= 0 || fsize > IMAGE_MAX_BYTES) {
+                fclose(f);
+                gui_set_status(&app_gui, "Image too large (max 4MB)");
+                return;
+            }
 
-        b64 = base64_encode((const unsigned char *)fdata, (size_t)fsize, NULL);
-        free(fdata);
+            fdata = malloc(fsize);
+            if (!fdata) {
+                fclose(f);
+                gui_set_status(&app_gui, "Out of memory");
+                return;
+            }
 
-        if (!b64) {
-            gui_set_status(&app_gui, "Out of memory encoding image");
-            return;
+            if ((long)fread(fdata, 1, fsize, f) != fsize) {
+                free(fdata);
+                fclose(f);
+                gui_set_status(&app_gui, "Read error");
+                return;
+            }
+            fclose(f);
         }
 
         snprintf(text, sizeof(text), "User dropped image: %s", path);
@@ -1317,8 +1342,9 @@ static void handle_dropped_file(const char *path, int insert_path)
         gui_set_status(&app_gui, "Sending image...");
         gui_set_busy(&app_gui, 1);
 
-        reply = claude_send_image(&app_claude, b64, media, text, &error_msg);
-        free(b64);
+        /* fdata now belongs to the conversation */
+        reply = claude_send_image(&app_claude, (unsigned char *)fdata, fsize,
+                                  media, text, &error_msg);
 
         gui_set_busy(&app_gui, 0);
 
@@ -1667,6 +1693,9 @@ int main(int argc, char *argv[])
     claude_set_tool_callback(&app_claude, tool_status_cb, NULL);
     http_set_event_callback(http_poll_cb, NULL);
     tools_set_poll_callback(http_poll_cb, NULL);
+    tools_set_image_limits(app_config.image_max_edge,
+                           app_config.image_max_pixels,
+                           app_config.png_level);
     dbg_step(10, "Claude OK");
 
     /* Initialize DataTypes for drag & drop file identification */
@@ -1804,7 +1833,8 @@ int main(int argc, char *argv[])
     claude_cleanup(&app_claude);
     http_cleanup();
     dt_cleanup();
-    png_convert_cleanup();
+    tools_forget_screen();
+    bitmap_read_cleanup();
     locale_close();
     close_libraries();
     cleanup_search_path();
@@ -1,14 +1,25 @@
 #ifndef AMIGAAI_PNG_CONVERT_H
 #define AMIGAAI_PNG_CONVERT_H
 
-/* Convert any DataTypes-loadable picture to PNG.
- * Uses DataTypes to load the image, ReadPixelArray8 for planar→chunky,
- * and a minimal PNG encoder with stored (uncompressed) deflate.
+/* Convert any DataTypes-loadable picture to PNG in memory.
+ * Uses DataTypes to load the image, ReadPixelArray8 for planar→chunky
+ * (PDTM_READPIXELARRAY for HAM and truecolor pictures), and the
+ * project's PNG encoder at the given deflate level (0-9).
+ * Pictures whose longest edge exceeds max_edge or that have more than
+ * max_pixels pixels are scaled down to fit (0 = no limit).
+ * The picture is read a row at a time and no temporary file is used.
+ * On success *png holds the PNG (*png_len bytes, caller frees).
  * Requires dt_init() to have been called (datatypes.library open).
- * Returns 0 on success, -1 on error. */
-int png_convert_file(const char *input_path, const char *output_path);
+ * Returns 0 on success, -1 on error, or -2 if the PNG would be larger
+ * than max_len bytes (0 = no limit). */
+int png_convert_mem(const char *input_path, int level,
+                    unsigned long max_edge, unsigned long max_pixels,
+                    long max_len, unsigned char **png, long *png_len);
 
-/* Close graphics.library opened by png_convert_file(). */
-void png_convert_cleanup(void);
+/* Width and height from the header of a PNG or GIF file, to check
+ * against the size limits without loading it.
+ * Returns 0 on success, -1 for other formats or read errors. */
+int png_picture_size(const char *path, unsigned long *width,
+                     unsigned long *height);
 
 #endif /* AMIGAAI_PNG_CONVERT_H */
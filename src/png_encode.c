@@ -0,0 +1,496 @@
+/*
+ * png_encode.c - PNG writer for AmigaAI
+ *
+ * Takes an image one row at a time and hands the PNG file to a sink
+ * callback as it is produced, so only the compressor's window is held
+ * in memory, not the image. Each row is filtered (the filter type is
+ * chosen per row), compressed with deflate.c, and each piece of
+ * compressed output becomes one IDAT chunk.
+ *
+ * Platform independent: the DataTypes side lives in png_convert.c.
+ */
+
+#include "png_encode.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct PngEncoder {
+    PngSink         sink;
+    void           *userdata;
+    struct Deflate *z;
+    unsigned long   height;
+    unsigned long   rows;           /* rows added so far */
+    unsigned long   row_bytes;
+    int             bpp;            /* bytes per pixel, at least 1 */
+    int             filters;        /* PNG_FILTERS_* */
+    int             failed;
+    unsigned char  *prev;           /* previous row, zeros for the first */
+    unsigned char  *cand[5];        /* filter type byte + filtered row */
+};
+
+/* ===================== CRC-32 ===================== */
+
+/* Slicing-by-4: crc_table[k][n] is the CRC of byte n followed by k
+ * zero bytes, so four input bytes are folded in with four independent
+ * lookups instead of four dependent ones. The bytes are combined one
+ * at a time, so this works the same on big- and little-endian CPUs. */
+static unsigned long crc_table[4][256];
+static int           crc_table_ready = 0;
+
+static void crc32_init(void)
+{
+    unsigned long c;
+    int n, k;
+    for (n = 0; n < 256; n++) {
+        c = (unsigned long)n;
+        for (k = 0; k < 8; k++) {
+            if (c & 1)
+                c = 0xEDB88320UL ^ (c >> 1);
+            else
+                c = c >> 1;
+        }
+        crc_table[0][n] = c;
+    }
+    for (n = 0; n < 256; n++) {
+        c = crc_table[0][n];
+        for (k = 1; k < 4; k++) {
+            c = crc_table[0][c & 0xFF] ^ (c >> 8);
+            crc_table[k][n] = c;
+        }
+    }
+    crc_table_ready = 1;
+}
+
+unsigned long png_crc32(unsigned long crc, const unsigned char *buf,
+                        unsigned long len)
+{
+    if (!crc_table_ready) crc32_init();
+    crc = (crc ^ 0xFFFFFFFFUL) & 0xFFFFFFFFUL;
+
+    while (len >= 4) {
+        crc ^= (unsigned long)buf[0] | ((unsigned long)buf[1] << 8) |
+               ((unsigned long)buf[2] << 16) | ((unsigned long)buf[3] << 24);
+        crc = crc_table[3][crc & 0xFF] ^
+              crc_table[2][(crc >> 8) & 0xFF] ^
+              crc_table[1][(crc >> 16) & 0xFF] ^
+              crc_table[0][crc >> 24];
+        buf += 4;
+        len -= 4;
+    }
+    while (len--)
+        crc = crc_table[0][(crc ^ *buf++) & 0xFF] ^ (crc >> 8);
+
+    return (crc ^ 0xFFFFFFFFUL) & 0xFFFFFFFFUL;
+}
+
+/* ===================== Chunks ===================== */
+
+static void put_be32(unsigned char *p, unsigned long v)
+{
+    p[0] = (v >> 24) & 0xFF;
+    p[1] = (v >> 16) & 0xFF;
+    p[2] = (v >>  8) & 0xFF;
+    p[3] =  v        & 0xFF;
+}
+
+/* Write a PNG chunk: 4-byte length, 4-byte type, data, 4-byte CRC */
+static int write_chunk(struct PngEncoder *enc, const char type[4],
+                       const unsigned char *data, unsigned long length)
+{
+    unsigned char hdr[8];
+    unsigned long crc;
+
+    if (enc->failed)
+        return -1;
+
+    put_be32(hdr, length);
+    memcpy(hdr + 4, type, 4);
+    crc = png_crc32(0, hdr + 4, 4);
+    if (enc->sink(hdr, 8, enc->userdata) != 0)
+        goto fail;
+
+    if (length > 0) {
+        crc = png_crc32(crc, data, length);
+        if (enc->sink(data, (long)length, enc->userdata) != 0)
+            goto fail;
+    }
+
+    put_be32(hdr, crc);
+    if (enc->sink(hdr, 4, enc->userdata) != 0)
+        goto fail;
+
+    return 0;
+
+fail:
+    enc->failed = 1;
+    return -1;
+}
+
+/* Compressed image data: one IDAT chunk per piece */
+static int idat_sink(const unsigned char *data, long len, void *userdata)
+{
+    return write_chunk((struct PngEncoder *)userdata, "IDAT",
+                       data, (unsigned long)len);
+}
+
+/* ===================== Filters ===================== */
+
+enum { FILTER_NONE, FILTER_SUB, FILTER_UP, FILTER_AVERAGE, FILTER_PAETH };
+
+static unsigned char paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = p > a ? p - a : a - p;
+    int pb = p > b ? p - b : b - p;
+    int pc = p > c ? p - c : c - p;
+
+    if (pa <= pb && pa <= pc) return (unsigned char)a;
+    if (pb <= pc) return (unsigned char)b;
+    return (unsigned char)c;
+}
+
+/* Filter row with the given type into out (after the type byte).
+ * Returns the sum of the output bytes taken as signed values, giving
+ * up early once it exceeds limit. */
+static unsigned long filter_row(int type, const unsigned char *row,
+                                const unsigned char *prev, unsigned long n,
+                                int bpp, unsigned char *out, unsigned long limit)
+{
+    unsigned long i, sum = 0;
+    unsigned char v;
+
+    out[0] = (unsigned char)type;
+    out++;
+
+#define FILTERED(expr) \
+    v = (unsigned char)(expr); \
+    out[i] = v; \
+    sum += v < 128 ? v : 256 - v;
+
+    switch (type) {
+    case FILTER_NONE:
+        for (i = 0; i < n; i++) {
+            FILTERED(row[i]);
+        }
+        break;
+    case FILTER_SUB:
+        for (i = 0; i < (unsigned long)bpp; i++) {
+            FILTERED(row[i]);
+        }
+        for (; i < n; i++) {
+            FILTERED(row[i] - row[i - bpp]);
+            if (sum > limit) break;
+        }
+        break;
+    case FILTER_UP:
+        for (i = 0; i < n; i++) {
+            FILTERED(row[i] - prev[i]);
+            if (sum > limit) break;
+        }
+        break;
+    case FILTER_AVERAGE:
+        for (i = 0; i < (unsigned long)bpp; i++) {
+            FILTERED(row[i] - (prev[i] >> 1));
+        }
+        for (; i < n; i++) {
+            FILTERED(row[i] - ((row[i - bpp] + prev[i]) >> 1));
+            if (sum > limit) break;
+        }
+        break;
+    case FILTER_PAETH:
+        for (i = 0; i < (unsigned long)bpp; i++) {
+            FILTERED(row[i] - prev[i]);
+        }
+        for (; i < n; i++) {
+            FILTERED(row[i] - paeth(row[i - bpp], prev[i], prev[i - bpp]));
+            if (sum > limit) break;
+        }
+        break;
+    }
+#undef FILTERED
+
+    return sum;
+}
+
+/* ===================== Encoder ===================== */
+
+struct PngEncoder *png_encoder_new(unsigned long width, unsigned long height,
+                                   int bit_depth, int color_type,
+                                   const unsigned char *palette, int ncolors,
+                                   int level, PngSink sink, void *userdata)
+{
+    static const unsigned char png_sig[8] = {
+        0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A
+    };
+    struct PngEncoder *enc;
+    unsigned char ihdr[13];
+    int channels = color_type == PNG_COLOR_RGB ? 3 : 1;
+    int i;
+
+    if (width == 0 || height == 0)
+        return NULL;
+
+    enc = calloc(1, sizeof(*enc));
+    if (!enc)
+        return NULL;
+
+    enc->sink = sink;
+    enc->userdata = userdata;
+    enc->height = height;
+    enc->row_bytes = (width * (unsigned long)bit_depth * channels + 7) / 8;
+    enc->bpp = bit_depth * channels >= 8 ? bit_depth * channels / 8 : 1;
+    enc->filters = level <= 0 ? PNG_FILTERS_NONE :
+                   level <= 3 ? PNG_FILTERS_FAST : PNG_FILTERS_ALL;
+
+    /* Pen numbers of a few colours have no meaningful differences;
+     * unfiltered rows compress better there */
+    if (color_type == PNG_COLOR_INDEXED && (bit_depth < 8 || ncolors <= 16))
+        enc->filters = PNG_FILTERS_NONE;
+
+    enc->prev = calloc(1, enc->row_bytes);
+    enc->cand[0] = malloc(5 * (enc->row_bytes + 1));
+    enc->z = deflate_new(level, idat_sink, enc);
+    if (!enc->prev || !enc->cand[0] || !enc->z) {
+        png_encoder_free(enc);
+        return NULL;
+    }
+    for (i = 1; i < 5; i++)
+        enc->cand[i] = enc->cand[i - 1] + enc->row_bytes + 1;
+
+    if (sink(png_sig, 8, userdata) != 0)
+        goto fail;
+
+    put_be32(ihdr + 0, width);
+    put_be32(ihdr + 4, height);
+    ihdr[8]  = (unsigned char)bit_depth;
+    ihdr[9]  = (unsigned char)color_type;
+    ihdr[10] = 0;  /* compression method */
+    ihdr[11] = 0;  /* filter method */
+    ihdr[12] = 0;  /* interlace method */
+    if (write_chunk(enc, "IHDR", ihdr, 13) != 0)
+        goto fail;
+
+    if (color_type == PNG_COLOR_INDEXED &&
+        write_chunk(enc, "PLTE", palette, (unsigned long)ncolors * 3) != 0)
+        goto fail;
+
+    return enc;
+
+fail:
+    png_encoder_free(enc);
+    return NULL;
+}
+
+void png_encoder_set_filters(struct PngEncoder *enc, int filters)
+{
+    enc->filters = filters;
+}
+
+/* Pick the filter whose output has the smallest sum of absolute
+ * values (the usual heuristic: small values compress best) */
+int png_encoder_row(struct PngEncoder *enc, const unsigned char *row)
+{
+    unsigned long n = enc->row_bytes, best_sum;
+    int type, ntypes, best = FILTER_NONE;
+
+    if (enc->failed || enc->rows >= enc->height)
+        return -1;
+
+    ntypes = enc->filters == PNG_FILTERS_ALL ? 5 :
+             enc->filters == PNG_FILTERS_FAST ? 3 : 1;
+
+    best_sum = filter_row(FILTER_NONE, row, enc->prev, n, enc->bpp,
+                          enc->cand[FILTER_NONE], 0);
+    for (type = FILTER_SUB; type < ntypes; type++) {
+        unsigned long sum = filter_row(type, row, enc->prev, n, enc->bpp,
+                                       enc->cand[type], best_sum);
+        if (sum < best_sum) {
+            best_sum = sum;
+            best = type;
+        }
+    }
+
+    if (deflate_write(enc->z, enc->cand[best], (long)n + 1) != 0)
+        return -1;
+
+    memcpy(enc->prev, row, n);
+    enc->rows++;
+    return 0;
+}
+
+int png_encoder_finish(struct PngEncoder *enc)
+{
+    if (enc->failed || enc->rows != enc->height)
+        return -1;
+
+    if (deflate_finish(enc->z) != 0)
+        return -1;
+
+    return write_chunk(enc, "IEND", NULL, 0);
+}
+
+void png_encoder_free(struct PngEncoder *enc)
+{
+    if (!enc)
+        return;
+    deflate_free(enc->z);
+    free(enc->cand[0]);
+    free(enc->prev);
+    free(enc);
+}
+
+/* ===================== Indexed pens ===================== */
+
+/* Smallest PNG bit depth for an indexed image of count colours */
+static int index_depth(int count)
+{
+    return count <= 2 ? 1 : count <= 4 ? 2 : count <= 16 ? 4 : 8;
+}
+
+/* Pack width one-byte indices at depth bits each, in place: the packed
+ * byte for pixel x never lies after x. Leftmost pixel in the high
+ * bits; the last byte is zero-padded. */
+static void pack_indices(unsigned char *buf, unsigned long width, int depth)
+{
+    const unsigned char *in = buf;
+    unsigned long x = 0;
+
+    if (depth == 8)
+        return;
+
+    while (x < width) {
+        unsigned v = 0;
+        int bits;
+
+        for (bits = 0; bits < 8; bits += depth) {
+            v <<= depth;
+            if (x < width)
+                v |= in[x++];
+        }
+        *buf++ = (unsigned char)v;
+    }
+}
+
+void png_pens_init(struct PngPens *pp)
+{
+    memset(pp, 0, sizeof(*pp));
+}
+
+void png_pens_mark(struct PngPens *pp, const unsigned char *pens, unsigned long n)
+{
+    unsigned long i;
+
+    for (i = 0; i < n; i++)
+        pp->map[pens[i]] = 1;
+}
+
+void png_pens_compact(struct PngPens *pp)
+{
+    int p;
+
+    pp->count = 0;
+    for (p = 0; p < 256; p++) {
+        if (pp->map[p]) {
+            pp->pen[pp->count] = (unsigned char)p;
+            pp->map[p] = (unsigned char)pp->count++;
+        }
+    }
+    if (pp->count == 0)         /* nothing marked: keep pen 0 */
+        pp->count = 1;
+
+    pp->bit_depth = index_depth(pp->count);
+}
+
+void png_pens_row(const struct PngPens *pp, const unsigned char *pens,
+                  unsigned long width, unsigned char *out)
+{
+    int depth = pp->bit_depth;
+    unsigned long x = 0;
+
+    if (depth == 8) {
+        for (; x < width; x++)
+            out[x] = pp->map[pens[x]];
+        return;
+    }
+
+    /* Leftmost pixel in the high bits; the last byte is zero-padded */
+    while (x < width) {
+        unsigned v = 0;
+        int bits;
+
+        for (bits = 0; bits < 8; bits += depth) {
+            v <<= depth;
+            if (x < width)
+                v |= pp->map[pens[x++]];
+        }
+        *out++ = (unsigned char)v;
+    }
+}
+
+/* ===================== Truecolour to indexed ===================== */
+
+/* Fibonacci hashing of the 24-bit colour into PNG_COLORS_HASH slots */
+#define COLOR_SLOT(key) \
+    ((unsigned)(((key) * 2654435761UL) & 0xFFFFFFFFUL) >> (32 - PNG_COLORS_HASH_BITS))
+
+void png_colors_init(struct PngColors *pc)
+{
+    memset(pc, 0, sizeof(*pc));
+    pc->bit_depth = 1;
+}
+
+int png_colors_add(struct PngColors *pc, const unsigned char *rgb,
+                   unsigned long width)
+{
+    unsigned long x, last = 0;
+
+    for (x = 0; x < width; x++, rgb += 3) {
+        unsigned long key = 0x1000000UL | ((unsigned long)rgb[0] << 16) |
+                            ((unsigned long)rgb[1] << 8) | rgb[2];
+        unsigned slot;
+
+        if (key == last)
+            continue;
+        last = key;
+
+        slot = COLOR_SLOT(key);
+        while (pc->key[slot] && pc->key[slot] != key)
+            slot = (slot + 1) & (PNG_COLORS_HASH - 1);
+        if (pc->key[slot])
+            continue;
+
+        if (pc->count == 256)
+            return -1;
+        pc->key[slot] = key;
+        pc->index[slot] = (unsigned char)pc->count;
+        memcpy(pc->palette + pc->count * 3, rgb, 3);
+        pc->count++;
+    }
+
+    pc->bit_depth = index_depth(pc->count);
+    return 0;
+}
+
+void png_colors_row(const struct PngColors *pc, const unsigned char *rgb,
+                    unsigned long width, unsigned char *out)
+{
+    unsigned long x, last = 0;
+    unsigned char idx = 0;
+
+    for (x = 0; x < width; x++, rgb += 3) {
+        unsigned long key = 0x1000000UL | ((unsigned long)rgb[0] << 16) |
+                            ((unsigned long)rgb[1] << 8) | rgb[2];
+
+        if (key != last) {
+            unsigned slot = COLOR_SLOT(key);
+            while (pc->key[slot] && pc->key[slot] != key)
+                slot = (slot + 1) & (PNG_COLORS_HASH - 1);
+            idx = pc->key[slot] ? pc->index[slot] : 0;
+            last = key;
+        }
+        out[x] = idx;
+    }
+
+    pack_indices(out, width, pc->bit_depth);
+}
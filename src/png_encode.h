@@ -0,0 +1,101 @@
+#ifndef AMIGAAI_PNG_ENCODE_H
+#define AMIGAAI_PNG_ENCODE_H
+
+#include "deflate.h"
+
+/* PNG colour types */
+#define PNG_COLOR_GREY    0
+#define PNG_COLOR_RGB     2
+#define PNG_COLOR_INDEXED 3
+
+/* Row filters tried per row: None only; None, Sub and Up (cheap, for
+ * slow CPUs); or all five. By default this follows the deflate level:
+ * NONE at level 0, FAST at 1-3, ALL above, except that indexed images
+ * with up to 16 colours are never filtered. */
+#define PNG_FILTERS_NONE  0
+#define PNG_FILTERS_FAST  1
+#define PNG_FILTERS_ALL   2
+
+/* Receives the PNG file in pieces. Return non-zero to stop.
+ * Same signature as DeflateSink. */
+typedef DeflateSink PngSink;
+
+struct PngEncoder;
+
+/* CRC-32 as used in PNG chunks: continue crc (0 to start) over len
+ * bytes of buf. Also a cheap checksum for detecting changed pixels. */
+unsigned long png_crc32(unsigned long crc, const unsigned char *buf,
+                        unsigned long len);
+
+/* Start a PNG image and write its header (and PLTE for indexed
+ * images: ncolors RGB triplets). Rows are then added top to bottom
+ * with png_encoder_row(). level is a deflate level (0-9).
+ * Returns NULL if out of memory or the sink fails. */
+struct PngEncoder *png_encoder_new(unsigned long width, unsigned long height,
+                                   int bit_depth, int color_type,
+                                   const unsigned char *palette, int ncolors,
+                                   int level, PngSink sink, void *userdata);
+
+/* Override the row filters (PNG_FILTERS_*) */
+void png_encoder_set_filters(struct PngEncoder *enc, int filters);
+
+/* Add one row of packed pixels (width * bit_depth * channels bits,
+ * rounded up to whole bytes). Returns 0 or -1. */
+int png_encoder_row(struct PngEncoder *enc, const unsigned char *row);
+
+/* Write the remaining image data and IEND. Returns 0, or -1 if the
+ * sink failed or fewer rows than the height were added. */
+int png_encoder_finish(struct PngEncoder *enc);
+
+void png_encoder_free(struct PngEncoder *enc);
+
+/* Pens actually used by an indexed image, renumbered 0..count-1 so
+ * the PLTE chunk only holds those and rows can be packed at the
+ * smallest bit depth (1, 2, 4 or 8). Mark all pixels first, then
+ * compact, then convert each row with png_pens_row(). */
+struct PngPens {
+    int           count;        /* pens in use */
+    int           bit_depth;
+    unsigned char map[256];     /* pen -> PNG index (mark flags before compacting) */
+    unsigned char pen[256];     /* PNG index -> pen */
+};
+
+void png_pens_init(struct PngPens *pp);
+void png_pens_mark(struct PngPens *pp, const unsigned char *pens, unsigned long n);
+void png_pens_compact(struct PngPens *pp);
+
+/* Renumber and pack one row of width pens (one per byte) into out,
+ * which needs (width * bit_depth + 7) / 8 bytes */
+void png_pens_row(const struct PngPens *pp, const unsigned char *pens,
+                  unsigned long width, unsigned char *out);
+
+/* Colours of a truecolour image that has at most 256 of them (RTG
+ * screens, HAM pictures of few colours), so it can be written as an
+ * indexed PNG without loss, which is always smaller than RGB. Add all
+ * rows first, then convert each row with png_colors_row(). */
+#define PNG_COLORS_HASH_BITS 10
+#define PNG_COLORS_HASH      (1 << PNG_COLORS_HASH_BITS)
+
+struct PngColors {
+    int           count;                    /* colours so far */
+    int           bit_depth;                /* 1, 2, 4 or 8 for count */
+    unsigned char palette[256 * 3];         /* PLTE, in order of appearance */
+    unsigned long key[PNG_COLORS_HASH];     /* 0x1RRGGBB, 0 = free slot */
+    unsigned char index[PNG_COLORS_HASH];
+};
+
+void png_colors_init(struct PngColors *pc);
+
+/* Add the colours of one row of width RGB pixels. Returns -1 once the
+ * image has more than 256 colours. */
+int png_colors_add(struct PngColors *pc, const unsigned char *rgb,
+                   unsigned long width);
+
+/* Convert one row of added colours to palette indices packed at
+ * bit_depth. out needs width bytes (the packed row is shorter).
+ * Colours that were not added (a screen that changed between passes)
+ * become index 0. */
+void png_colors_row(const struct PngColors *pc, const unsigned char *rgb,
+                    unsigned long width, unsigned char *out);
+
+#endif /* AMIGAAI_PNG_ENCODE_H */
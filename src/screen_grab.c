@@ -0,0 +1,308 @@
+/*
+ * screen_grab.c - Screenshots straight from the screen's bitmap
+ *
+ * Reads the default public screen a row at a time (bitmap_read.c) and
+ * encodes it with the project's PNG encoder (image_encode.c) into
+ * memory. Pens are looked up in the screen's ColorMap; EHB and HAM
+ * screens (as the display database describes their mode) are converted
+ * to the colours actually displayed by screen_rows.c, and truecolor
+ * RTG screens are read as RGB. A region, and a scaled-down size, are
+ * handled on the way, so only the pixels sent are encoded.
+ *
+ * With change detection (tile_hash.c) the region is read once more
+ * beforehand, without encoding, to checksum its tiles; an unchanged
+ * screen then costs that one read instead of a PNG and its upload.
+ *
+ * The screen stays locked (not frozen) while it is read; windows that
+ * redraw in between may show up half-drawn, as with any grabber.
+ */
+
+#include "screen_grab.h"
+#include "bitmap_read.h"
+#include "image_encode.h"
+#include "image_scale.h"
+#include "png_encode.h"
+#include "screen_rows.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <exec/types.h>
+#include <intuition/screens.h>
+#include <graphics/gfx.h>
+#include <graphics/view.h>
+#include <graphics/modeid.h>
+#include <graphics/displayinfo.h>
+#include <proto/exec.h>
+#include <proto/intuition.h>
+#include <proto/graphics.h>
+
+extern struct GfxBase *GfxBase_bm;  /* from bitmap_read.c */
+
+#define GfxBase GfxBase_bm
+
+/* ===================== Screen rows ===================== */
+
+/* screen_rows.c rows, read from a bitmap */
+struct GrabRows {
+    struct ScreenRows   rows;
+    struct BitmapReader br;
+};
+
+static const unsigned char *grab_pens(void *handle, unsigned long y)
+{
+    return bitmap_reader_pens((struct BitmapReader *)handle, (UWORD)y);
+}
+
+static int grab_rgb(void *handle, unsigned long y, unsigned char *rgb)
+{
+    return bitmap_reader_rgb((struct BitmapReader *)handle, (UWORD)y, rgb);
+}
+
+/* Set gr up to read the region x, y, w pixels wide of bm as kind
+ * (palette filled in). Returns 0 or -1; free gr either way. */
+static int grab_rows_init(struct GrabRows *gr, struct BitMap *bm,
+                          UBYTE depth, int kind, ULONG x, ULONG y, ULONG w)
+{
+    if (screen_rows_init(&gr->rows, kind, depth, x, w) != 0)
+        return -1;
+    gr->rows.src_pens = grab_pens;
+    gr->rows.src_rgb = grab_rgb;
+    gr->rows.handle = &gr->br;
+    return bitmap_reader_init(&gr->br, bm, depth,
+                              (UWORD)gr->rows.src_left, (UWORD)y,
+                              (UWORD)gr->rows.src_width);
+}
+
+static void grab_rows_free(struct GrabRows *gr)
+{
+    bitmap_reader_free(&gr->br);
+    screen_rows_free(&gr->rows);
+}
+
+/* HAM and EHB from the display database. The mode ID bits that stand
+ * for them on native modes mean other things on RTG modes. */
+static void mode_properties(ULONG mode_id, int *ham, int *ehb)
+{
+    struct DisplayInfo di;
+
+    *ham = 0;
+    *ehb = 0;
+    if (mode_id == INVALID_ID ||
+        GetDisplayInfoData(NULL, (UBYTE *)&di, sizeof(di), DTAG_DISP,
+                           mode_id) == 0)
+        return;
+    *ham = (di.PropertyFlags & DIPF_IS_HAM) != 0;
+    *ehb = (di.PropertyFlags & DIPF_IS_EXTRAHALFBRITE) != 0;
+}
+
+/* First ncolors entries of the screen's palette */
+static void read_palette(struct ViewPort *vp, int ncolors, UBYTE *palette)
+{
+    struct ColorMap *cm = vp->ColorMap;
+    ULONG c[3];
+    int p;
+
+    memset(palette, 0, 256 * 3);
+    if (!cm) return;
+    if (ncolors > cm->Count) ncolors = cm->Count;
+
+    for (p = 0; p < ncolors; p++) {
+        GetRGB32(cm, p, 1, c);
+        palette[p * 3 + 0] = (UBYTE)(c[0] >> 24);
+        palette[p * 3 + 1] = (UBYTE)(c[1] >> 24);
+        palette[p * 3 + 2] = (UBYTE)(c[2] >> 24);
+    }
+}
+
+/* ===================== Changes ===================== */
+
+/* Checksum of what the pixels read mean: screen format, scale and
+ * palette. Any change makes the whole screen count as changed. */
+static ULONG screen_format(struct Screen *scr, ULONG depth, ULONG mode_id,
+                           const struct ScreenGrab *g, const UBYTE *palette)
+{
+    ULONG info[6];
+
+    info[0] = scr->Width;
+    info[1] = scr->Height;
+    info[2] = depth;
+    info[3] = mode_id;
+    info[4] = g->scaled_w;
+    info[5] = g->scaled_h;
+    return png_crc32(png_crc32(0, (const UBYTE *)info, sizeof(info)),
+                     palette, 256 * 3);
+}
+
+/* Hash the tiles of x, y, w x h, read as format: pens, or RGB. HAM
+ * rows are hashed decoded (x is 0), as one changed pen changes the
+ * colours up to the next palette pixel on its right. */
+static int hash_tiles(struct TileHash *th, struct BitMap *bm, UBYTE depth,
+                      const struct ScreenRows *format,
+                      ULONG x, ULONG y, ULONG w, ULONG h)
+{
+    struct GrabRows *gr;
+    UBYTE *pixels = NULL;
+    int bpp = screen_rows_bpp(format);
+    int rc = -1;
+    ULONG row;
+
+    gr = calloc(1, sizeof(*gr));
+    if (!gr) return -1;
+    memcpy(gr->rows.palette, format->palette, sizeof(gr->rows.palette));
+
+    if (grab_rows_init(gr, bm, depth, format->kind, x, y, w) != 0)
+        goto cleanup;
+    pixels = malloc(w * bpp);
+    if (!pixels) goto cleanup;
+
+    for (row = 0; row < h; row++) {
+        if (screen_rows_read(&gr->rows, row, pixels) != 0)
+            goto cleanup;
+        tile_hash_row(th, y + row, x, w, pixels, bpp);
+    }
+    rc = 0;
+
+cleanup:
+    grab_rows_free(gr);
+    free(gr);
+    free(pixels);
+    return rc;
+}
+
+/* Hash the tiles under the region r and find what changed in it.
+ * Returns 1 and narrows r to the changed tiles with delta, 0 if none
+ * changed, -1 on error. */
+static int find_changes(struct ScreenGrab *g, struct Screen *scr,
+                        struct BitMap *bm, UBYTE depth, ULONG format,
+                        const struct ScreenRows *rows, struct ScaleRegion *r)
+{
+    ULONG x0, y0, x1, y1, cx, cy, cw, ch;
+
+    if (tile_hash_start(g->tiles, scr->Width, scr->Height, format) != 0)
+        return -1;
+
+    /* Whole tiles; HAM rows from the left edge, as pixels depend on
+     * those to their left */
+    x0 = rows->kind == SCREEN_HAM ? 0 : r->x / TILE_SIZE * TILE_SIZE;
+    y0 = r->y / TILE_SIZE * TILE_SIZE;
+    x1 = (r->x + r->w + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE;
+    y1 = (r->y + r->h + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE;
+    if (x1 > (ULONG)scr->Width)  x1 = scr->Width;
+    if (y1 > (ULONG)scr->Height) y1 = scr->Height;
+
+    if (hash_tiles(g->tiles, bm, depth, rows, x0, y0, x1 - x0, y1 - y0) != 0) {
+        tile_hash_forget(g->tiles);
+        return -1;
+    }
+
+    if (!tile_hash_changed(g->tiles, r->x, r->y, r->w, r->h,
+                           &cx, &cy, &cw, &ch))
+        return 0;
+
+    if (g->delta)
+        scale_region(scr->Width, scr->Height, cx, cy, cw, ch,
+                     g->scaled_w, g->scaled_h, r);
+    return 1;
+}
+
+/* ===================== Capture ===================== */
+
+int screen_grab_png(struct ScreenGrab *g, unsigned char **png, long *png_len)
+{
+    struct Screen *scr;
+    struct BitMap *bm;
+    struct GrabRows *rows;
+    struct ImageSource src;
+    struct ImageOut out;
+    struct ScaleRegion r;
+    ULONG mode_id, depth;
+    int ham = 0, ehb = 0, kind;
+    int result = -1;
+
+    *png = NULL;
+    *png_len = 0;
+
+    if (bitmap_read_open() != 0) return -1;
+
+    rows = calloc(1, sizeof(*rows));
+    if (!rows) return -1;
+    memset(&out, 0, sizeof(out));
+
+    scr = LockPubScreen(NULL);
+    if (!scr) {
+        free(rows);
+        return -1;
+    }
+
+    bm = scr->RastPort.BitMap;
+    depth = GetBitMapAttr(bm, BMA_DEPTH);
+    mode_id = GetVPModeID(&scr->ViewPort);
+
+    if (scale_region(scr->Width, scr->Height, g->x, g->y, g->w, g->h,
+                     g->scaled_w, g->scaled_h, &r) != 0)
+        goto cleanup;
+
+    /* Without cybergraphics a deep bitmap can't be read */
+    if (depth <= 8)
+        mode_properties(mode_id, &ham, &ehb);
+    kind = screen_rows_kind(depth, depth > 8 && bitmap_is_truecolor(bm),
+                            ham, ehb);
+    if (kind < 0)
+        goto cleanup;
+
+    if (kind == SCREEN_RGB)
+        depth = 8;
+    else if (kind == SCREEN_HAM)
+        read_palette(&scr->ViewPort, depth >= 8 ? 64 : 16,
+                     rows->rows.palette);
+    else if (kind == SCREEN_EHB)
+        read_palette(&scr->ViewPort, 32, rows->rows.palette);
+    else
+        read_palette(&scr->ViewPort, 1 << depth, rows->rows.palette);
+    rows->rows.kind = kind;
+
+    g->changed = 1;
+    if (g->tiles) {
+        ULONG format = screen_format(scr, depth, mode_id, g,
+                                     rows->rows.palette);
+
+        g->changed = find_changes(g, scr, bm, (UBYTE)depth, format,
+                                  &rows->rows, &r);
+        if (g->changed < 0) goto cleanup;
+        if (g->changed == 0 && !g->force) {
+            result = 1;
+            goto cleanup;
+        }
+    }
+
+    if (grab_rows_init(rows, bm, (UBYTE)depth, kind, r.x, r.y, r.w) != 0)
+        goto cleanup;
+
+    memset(&src, 0, sizeof(src));
+    src.width = r.w;
+    src.height = r.h;
+    src.palette = screen_rows_bpp(&rows->rows) == 1 ? rows->rows.palette
+                                                    : NULL;
+    src.read_row = screen_rows_read;
+    src.handle = &rows->rows;
+
+    result = image_encode_png(&src, r.dst_w, r.dst_h, g->level,
+                              image_out_sink, &out);
+    g->sent = r;
+
+cleanup:
+    UnlockPubScreen(NULL, scr);
+    grab_rows_free(rows);
+    free(rows);
+
+    if (result != 0) {
+        image_out_free(&out);
+        return result;
+    }
+
+    *png = image_out_join(&out);
+    if (!*png) return -1;
+    *png_len = out.total;
+    return 0;
+}
@@ -0,0 +1,37 @@
+#ifndef AMIGAAI_SCREEN_GRAB_H
+#define AMIGAAI_SCREEN_GRAB_H
+
+#include "image_scale.h"
+#include "tile_hash.h"
+
+/* A screenshot to take with screen_grab_png() */
+struct ScreenGrab {
+    long               x, y, w, h;  /* region in screen pixels; w or
+                                       h <= 0: up to the right or bottom
+                                       edge */
+    unsigned long      scaled_w;    /* size the whole screen is shown */
+    unsigned long      scaled_h;    /* at (0 = not scaled) */
+    int                level;       /* deflate level (0-9) */
+    struct TileHash   *tiles;       /* NULL: no change detection */
+    int                delta;       /* only the changed part */
+    int                force;       /* capture even if unchanged */
+    struct ScaleRegion sent;        /* out: area captured, image size */
+    int                changed;     /* out: 0 if sent though unchanged */
+};
+
+/* Capture the default public screen (the one input_mouse_move()
+ * positions on) as PNG in memory, read straight from its bitmap: no
+ * external tool and no temporary file. The region is clipped to the
+ * screen and shrunk by the same factor as the whole screen.
+ * With tiles, the region is first checked against what was sent
+ * before: if none of it changed, nothing is captured (unless force);
+ * with delta, only the bounding box of the changed tiles is. The
+ * caller marks g->sent as sent (tile_hash_sent()) once the image is
+ * on its way.
+ * Planar, EHB, HAM, 8-bit and truecolor RTG screens are supported.
+ * On success *png holds the PNG (*png_len bytes, caller frees).
+ * Returns 0 on success, 1 if unchanged (no PNG), -1 on error. */
+int screen_grab_png(struct ScreenGrab *g, unsigned char **png,
+                    long *png_len);
+
+#endif /* AMIGAAI_SCREEN_GRAB_H */
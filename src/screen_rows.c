@@ -0,0 +1,86 @@
+/*
+ * screen_rows.c - Screen rows as the pixels sent
+ *
+ * Decides from a screen's depth and display mode what its pixels are
+ * (pens, EHB, HAM or RGB), which part of each row has to be read for a
+ * region, and turns the rows read into pens or RGB. Kept apart from
+ * the bitmap reading in screen_grab.c, so that tools/grabsim.c runs
+ * the same code on synthetic screens.
+ */
+
+#include "screen_rows.h"
+#include "image_encode.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+int screen_rows_kind(unsigned depth, int truecolor, int ham, int ehb)
+{
+    if (truecolor)
+        return SCREEN_RGB;
+    if (depth > 8)
+        return -1;
+    if (ham)
+        return SCREEN_HAM;
+    if (ehb)
+        return SCREEN_EHB;
+    return SCREEN_PENS;
+}
+
+int screen_rows_init(struct ScreenRows *rows, int kind, unsigned depth,
+                     unsigned long x, unsigned long w)
+{
+    int p;
+
+    rows->kind = kind;
+    rows->ham_depth = depth >= 8 ? 8 : 6;
+    rows->width = w;
+    rows->src_left = x;
+    rows->src_width = w;
+    rows->ham_rgb = NULL;
+
+    if (kind == SCREEN_EHB) {
+        for (p = 32 * 3; p < 64 * 3; p++)
+            rows->palette[p] = rows->palette[p - 32 * 3] >> 1;
+    } else if (kind == SCREEN_HAM) {
+        rows->src_left = 0;
+        rows->src_width = x + w;
+        rows->ham_rgb = malloc(rows->src_width * 3);
+        if (!rows->ham_rgb) return -1;
+    }
+    return 0;
+}
+
+int screen_rows_bpp(const struct ScreenRows *rows)
+{
+    return (rows->kind == SCREEN_HAM || rows->kind == SCREEN_RGB) ? 3 : 1;
+}
+
+int screen_rows_read(void *handle, unsigned long y, unsigned char *row)
+{
+    struct ScreenRows *rows = (struct ScreenRows *)handle;
+    const unsigned char *pens;
+
+    if (rows->kind == SCREEN_RGB)
+        return rows->src_rgb(rows->handle, y, row);
+
+    pens = rows->src_pens(rows->handle, y);
+    if (!pens) return -1;
+
+    if (rows->kind == SCREEN_HAM) {
+        /* Decoded from the left edge; the region is its right end */
+        image_ham_row(pens, rows->src_width, rows->palette,
+                      rows->ham_depth, rows->ham_rgb);
+        memcpy(row, rows->ham_rgb + (rows->src_width - rows->width) * 3,
+               rows->width * 3);
+    } else {
+        memcpy(row, pens, rows->width);
+    }
+    return 0;
+}
+
+void screen_rows_free(struct ScreenRows *rows)
+{
+    free(rows->ham_rgb);
+    rows->ham_rgb = NULL;
+}
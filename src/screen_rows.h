@@ -0,0 +1,54 @@
+#ifndef AMIGAAI_SCREEN_ROWS_H
+#define AMIGAAI_SCREEN_ROWS_H
+
+/* What the pixels of a screen are, and so how its rows are read */
+#define SCREEN_PENS  0      /* pens into the palette (planar, 8-bit RTG) */
+#define SCREEN_EHB   1      /* pens; 32-63 show 0-31 at half brightness */
+#define SCREEN_HAM   2      /* HAM6/HAM8 pens, decoded to RGB */
+#define SCREEN_RGB   3      /* truecolor RTG, read as RGB */
+
+/* Rows of a screen region as the pixels sent, for image_encode.c and
+ * the tile checksums (tile_hash.c). The screen itself is read through
+ * the source callbacks, from src_left on, src_width pixels wide:
+ * src_pens returns a row as pens (valid until the next call, NULL on
+ * error), src_rgb reads one of a truecolor screen as RGB (0 or -1).
+ * Shared by screen_grab.c and tools/grabsim.c. */
+struct ScreenRows {
+    int            kind;            /* SCREEN_* */
+    int            ham_depth;       /* 6 or 8 */
+    unsigned char  palette[256 * 3];
+    unsigned long  width;           /* of the region */
+    unsigned long  src_left;        /* HAM rows are read from the left */
+    unsigned long  src_width;       /* edge, as each pixel depends on the
+                                       one to its left */
+    const unsigned char *(*src_pens)(void *handle, unsigned long y);
+    int          (*src_rgb)(void *handle, unsigned long y,
+                            unsigned char *rgb);
+    void          *handle;
+    unsigned char *ham_rgb;         /* src_width * 3 */
+};
+
+/* Kind of rows of a screen with depth planes, from whether its bitmap
+ * is truecolor and from its display mode's HAM and extra halfbrite
+ * properties, which only exist for planar screens of up to 8 planes.
+ * Returns SCREEN_*, or -1 for a deep bitmap that is not truecolor
+ * (it can't be read). */
+int screen_rows_kind(unsigned depth, int truecolor, int ham, int ehb);
+
+/* Set rows up to read a region of a screen with depth planes as kind,
+ * from x on, w pixels wide, and set src_left and src_width. The caller
+ * fills in the palette first (EHB: pens 0-31) and then the source.
+ * Returns 0, or -1 if out of memory; free rows either way. */
+int screen_rows_init(struct ScreenRows *rows, int kind, unsigned depth,
+                     unsigned long x, unsigned long w);
+
+/* Bytes per pixel of the rows read: 1 (pens) or 3 (RGB) */
+int screen_rows_bpp(const struct ScreenRows *rows);
+
+/* ImageSource read_row, with rows as the handle: row y as pens or RGB
+ * (width pixels). Returns 0 or -1. */
+int screen_rows_read(void *handle, unsigned long y, unsigned char *row);
+
+void screen_rows_free(struct ScreenRows *rows);
+
+#endif /* AMIGAAI_SCREEN_ROWS_H */
@@ -0,0 +1,281 @@
+/*
+ * sse.c - Server-sent event handling for streamed Messages API responses
+ *
+ * Splits the event stream into events, applies each event to a message
+ * object and hands finished tool_use blocks to a callback while the rest
+ * of the response is still arriving. The frequent content_block_delta
+ * events are read with the pull parser instead of a full cJSON parse.
+ * The rebuilt message has the same shape as a parsed non-streamed
+ * response, so the normal response handling, caching and history code
+ * works on it unchanged.
+ */
+
+#include "sse.h"
+#include "json_pull.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Make room for n more bytes plus a NUL in a growing buffer */
+static int buf_reserve(char **buf, long *len, long *cap, long n)
+{
+    if (*len + n + 1 > *cap) {
+        long new_cap = *cap ? *cap : 256;
+        char *b;
+        while (*len + n + 1 > new_cap)
+            new_cap *= 2;
+        b = realloc(*buf, new_cap);
+        if (!b) return -1;
+        *buf = b;
+        *cap = new_cap;
+    }
+    return 0;
+}
+
+/* Append len bytes to a growing NUL-terminated buffer */
+static int buf_append(char **buf, long *len, long *cap,
+                      const char *data, long n)
+{
+    if (buf_reserve(buf, len, cap, n) != 0) return -1;
+    memcpy(*buf + *len, data, n);
+    *len += n;
+    (*buf)[*len] = '\0';
+    return 0;
+}
+
+void sse_init(struct SseStream *st, SseToolCallback tool_cb, void *userdata)
+{
+    memset(st, 0, sizeof(*st));
+    st->tool_cb      = tool_cb;
+    st->tool_cb_data = userdata;
+}
+
+void sse_free(struct SseStream *st)
+{
+    free(st->line);
+    free(st->data);
+    free(st->block);
+    cJSON_Delete(st->message);
+    memset(st, 0, sizeof(*st));
+}
+
+/* Set obj[key] to item, replacing any old value */
+static void set_item(cJSON *obj, const char *key, cJSON *item)
+{
+    if (!item) return;
+    if (cJSON_GetObjectItemCaseSensitive(obj, key))
+        cJSON_ReplaceItemInObjectCaseSensitive(obj, key, item);
+    else
+        cJSON_AddItemToObject(obj, key, item);
+}
+
+/* content_block_stop: store the accumulated text or tool input */
+static void finish_block(struct SseStream *st, cJSON *block)
+{
+    cJSON *type = cJSON_GetObjectItemCaseSensitive(block, "type");
+    const char *text = st->block ? st->block : "";
+
+    if (!cJSON_IsString(type)) return;
+
+    if (strcmp(type->valuestring, "text") == 0) {
+        set_item(block, "text", cJSON_CreateString(text));
+    } else if (strcmp(type->valuestring, "tool_use") == 0) {
+        cJSON *input = text[0] ? cJSON_Parse(text) : cJSON_CreateObject();
+        if (!input) {
+            st->failed = 1;
+            return;
+        }
+        set_item(block, "input", input);
+        if (st->tool_cb)
+            st->tool_cb(block, st->tool_cb_data);
+    }
+
+    st->block_len = 0;
+    if (st->block) st->block[0] = '\0';
+}
+
+/* content_block_delta events make up almost all of a stream. Take the
+ * text or partial_json piece straight out of the payload into the
+ * block buffer, without building a tree for every few characters.
+ * Returns 0 if the payload is something else (or unexpected), to be
+ * handled by handle_event(). */
+static int handle_delta(struct SseStream *st, const char *json, long len)
+{
+    struct JsonPull p, piece;
+    int ev, is_delta = 0, have_piece = 0;
+
+    json_pull_init(&p, json, len);
+    if (json_pull_next(&p) != JSON_PULL_OBJECT_START)
+        return 0;
+
+    while ((ev = json_pull_next(&p)) == JSON_PULL_KEY) {
+        if (json_pull_is(&p, "type")) {
+            if (json_pull_next(&p) != JSON_PULL_STRING ||
+                !json_pull_is(&p, "content_block_delta"))
+                return 0;
+            is_delta = 1;
+        } else if (json_pull_is(&p, "delta")) {
+            if (json_pull_next(&p) != JSON_PULL_OBJECT_START)
+                return 0;
+            while ((ev = json_pull_next(&p)) == JSON_PULL_KEY) {
+                if (json_pull_is(&p, "text") || json_pull_is(&p, "partial_json")) {
+                    if (json_pull_next(&p) != JSON_PULL_STRING)
+                        return 0;
+                    piece = p;
+                    have_piece = 1;
+                } else if (json_pull_skip(&p) == JSON_PULL_ERROR) {
+                    return 0;
+                }
+            }
+            if (ev != JSON_PULL_OBJECT_END)
+                return 0;
+        } else if (json_pull_skip(&p) == JSON_PULL_ERROR) {
+            return 0;
+        }
+    }
+    if (ev != JSON_PULL_OBJECT_END || !is_delta)
+        return 0;
+
+    if (!st->message || !have_piece)
+        return 1;   /* Nothing to add */
+
+    if (buf_reserve(&st->block, &st->block_len, &st->block_cap,
+                    piece.str_len) != 0) {
+        st->failed = 1;
+        return 1;
+    }
+    st->block_len += json_pull_string(&piece, st->block + st->block_len);
+    return 1;
+}
+
+/* Apply one event ("data:" payload) to the message */
+static void handle_event(struct SseStream *st, const char *json, long len)
+{
+    cJSON *ev, *type, *content;
+    const char *t;
+
+    if (handle_delta(st, json, len))
+        return;
+
+    ev = cJSON_Parse(json);
+    type = cJSON_GetObjectItemCaseSensitive(ev, "type");
+    if (!cJSON_IsString(type)) {
+        cJSON_Delete(ev);
+        return;   /* Not JSON or no type: ignore */
+    }
+    t = type->valuestring;
+
+    if (strcmp(t, "message_start") == 0) {
+        cJSON_Delete(st->message);
+        st->message = cJSON_DetachItemFromObjectCaseSensitive(ev, "message");
+        if (!st->message) st->failed = 1;
+    } else if (strcmp(t, "error") == 0) {
+        /* Keep the error object itself as the response body */
+        cJSON_Delete(st->message);
+        st->message = ev;
+        ev = NULL;
+        st->error = 1;
+        st->done = 1;
+    } else if (!st->message) {
+        /* ping etc. before message_start */
+    } else if (strcmp(t, "content_block_start") == 0) {
+        cJSON *block = cJSON_DetachItemFromObjectCaseSensitive(ev, "content_block");
+        content = cJSON_GetObjectItemCaseSensitive(st->message, "content");
+        if (!content) {
+            content = cJSON_AddArrayToObject(st->message, "content");
+        }
+        if (block && content)
+            cJSON_AddItemToArray(content, block);
+        else
+            st->failed = 1;
+        st->block_len = 0;
+        if (st->block) st->block[0] = '\0';
+    } else if (strcmp(t, "content_block_stop") == 0) {
+        cJSON *index = cJSON_GetObjectItemCaseSensitive(ev, "index");
+        content = cJSON_GetObjectItemCaseSensitive(st->message, "content");
+        if (cJSON_IsNumber(index))
+            finish_block(st, cJSON_GetArrayItem(content, index->valueint));
+    } else if (strcmp(t, "message_delta") == 0) {
+        cJSON *delta = cJSON_GetObjectItemCaseSensitive(ev, "delta");
+        cJSON *usage = cJSON_GetObjectItemCaseSensitive(ev, "usage");
+        cJSON *item;
+
+        cJSON_ArrayForEach(item, delta)
+            set_item(st->message, item->string, cJSON_Duplicate(item, 1));
+
+        if (usage) {
+            cJSON *msg_usage = cJSON_GetObjectItemCaseSensitive(st->message, "usage");
+            if (!msg_usage)
+                msg_usage = cJSON_AddObjectToObject(st->message, "usage");
+            cJSON_ArrayForEach(item, usage)
+                set_item(msg_usage, item->string, cJSON_Duplicate(item, 1));
+        }
+    } else if (strcmp(t, "message_stop") == 0) {
+        st->done = 1;
+    }
+
+    cJSON_Delete(ev);
+}
+
+/* Process one complete line of the event stream */
+static void handle_line(struct SseStream *st, char *line, long len)
+{
+    if (len > 0 && line[len - 1] == '\r')
+        line[--len] = '\0';
+
+    if (len == 0) {
+        /* Blank line: dispatch the event */
+        if (st->data_len > 0)
+            handle_event(st, st->data, st->data_len);
+        st->data_len = 0;
+        if (st->data) st->data[0] = '\0';
+        return;
+    }
+
+    if (strncmp(line, "data:", 5) == 0) {
+        const char *v = line + 5;
+        if (*v == ' ') v++;
+        if ((st->data_len > 0 &&
+             buf_append(&st->data, &st->data_len, &st->data_cap, "\n", 1) != 0) ||
+            buf_append(&st->data, &st->data_len, &st->data_cap,
+                       v, len - (v - line)) != 0)
+            st->failed = 1;
+    }
+    /* "event:", "id:", "retry:" and comments are not needed:
+     * the data payload carries its own "type". */
+}
+
+int sse_feed(const char *data, long len, void *userdata)
+{
+    struct SseStream *st = (struct SseStream *)userdata;
+    const char *end = data + len;
+
+    while (data < end && !st->failed) {
+        const char *nl = memchr(data, '\n', end - data);
+        long n = (nl ? nl : end) - data;
+
+        if (buf_append(&st->line, &st->line_len, &st->line_cap, data, n) != 0) {
+            st->failed = 1;
+            break;
+        }
+        if (!nl) break;
+
+        handle_line(st, st->line, st->line_len);
+        st->line_len = 0;
+        data = nl + 1;
+    }
+
+    return st->failed;
+}
+
+cJSON *sse_finish(struct SseStream *st)
+{
+    cJSON *message;
+
+    if (st->failed || !st->done || !st->message)
+        return NULL;
+
+    message = st->message;
+    st->message = NULL;
+    return message;
+}
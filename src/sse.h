@@ -0,0 +1,45 @@
+#ifndef AMIGAAI_SSE_H
+#define AMIGAAI_SSE_H
+
+#include "cJSON.h"
+
+/* Called when a tool_use block of the streamed message is complete,
+ * i.e. its input JSON has been fully received. The block belongs to
+ * the stream and must not be modified or kept. */
+typedef void (*SseToolCallback)(cJSON *block, void *userdata);
+
+/* Rebuilds a Messages API response from its server-sent event stream
+ * ("stream": true). */
+struct SseStream {
+    char  *line;          /* Current, incomplete SSE line */
+    long   line_len, line_cap;
+    char  *data;          /* "data:" payload of the current event */
+    long   data_len, data_cap;
+    char  *block;         /* Text / input JSON of the open content block */
+    long   block_len, block_cap;
+    cJSON *message;       /* Message rebuilt so far */
+    int    done;          /* message_stop or error received */
+    int    error;         /* Stream carried an error event */
+    int    failed;        /* Out of memory or malformed event */
+
+    SseToolCallback tool_cb;
+    void           *tool_cb_data;
+};
+
+/* Initialize a stream. tool_cb may be NULL. */
+void sse_init(struct SseStream *st, SseToolCallback tool_cb, void *userdata);
+
+/* Feed raw event stream data (any split). Matches HttpDataCallback,
+ * with the SseStream as userdata. Returns non-zero on fatal error. */
+int sse_feed(const char *data, long len, void *userdata);
+
+/* Take the complete response message, shaped like a parsed
+ * non-streamed response (or the API error object if the stream
+ * reported an error). Caller must cJSON_Delete.
+ * Returns NULL if the stream ended early or was malformed. */
+cJSON *sse_finish(struct SseStream *st);
+
+/* Free stream resources. */
+void sse_free(struct SseStream *st);
+
+#endif /* AMIGAAI_SSE_H */
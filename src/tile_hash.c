@@ -0,0 +1,201 @@
+/*
+ * tile_hash.c - Screen change detection in tiles
+ *
+ * Agent loops take a screenshot after nearly every click, and most of
+ * them show the same screen, or the same screen with one small area
+ * changed. The screen is divided into 32 x 32 pixel tiles, each with a
+ * CRC-32 of its pixels (png_encode.c's table-driven CRC: no multiplies,
+ * which are slow on a 68020/030). Comparing those with the checksums of
+ * what was last sent tells whether to send nothing, the bounding box of
+ * the changed tiles, or all of it.
+ *
+ * Platform independent.
+ */
+
+#include "tile_hash.h"
+#include "png_encode.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Checksum as stored: never 0, which marks a tile not sent yet */
+#define TILE_SUM(h) ((h) ? (h) : 1UL)
+
+int tile_hash_start(struct TileHash *th, unsigned long width,
+                    unsigned long height, unsigned long format)
+{
+    unsigned long cols = (width + TILE_SIZE - 1) / TILE_SIZE;
+    unsigned long rows = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+    if (!th->now || cols != th->cols || rows != th->rows) {
+        tile_hash_free(th);
+        th->now  = calloc(cols * rows, sizeof(*th->now));
+        th->sent = calloc(cols * rows, sizeof(*th->sent));
+        th->part = calloc(cols * rows, 4);
+        if (!th->now || !th->sent || !th->part) {
+            tile_hash_free(th);
+            return -1;
+        }
+        th->cols = cols;
+        th->rows = rows;
+    } else if (width != th->width || height != th->height ||
+               format != th->format) {
+        tile_hash_forget(th);
+    }
+
+    th->width = width;
+    th->height = height;
+    th->format = format;
+    return 0;
+}
+
+void tile_hash_row(struct TileHash *th, unsigned long y, unsigned long x0,
+                   unsigned long n, const unsigned char *row, int bpp)
+{
+    unsigned long *h = th->now + (y / TILE_SIZE) * th->cols + x0 / TILE_SIZE;
+    int first = (y % TILE_SIZE) == 0;
+
+    while (n > 0) {
+        unsigned long len = n < TILE_SIZE ? n : TILE_SIZE;
+
+        if (first) *h = 0;
+        *h = png_crc32(*h, row, len * bpp);
+        row += len * bpp;
+        n -= len;
+        h++;
+    }
+}
+
+/* Tiles touched by x, y, w x h: columns c0..c1, rows r0..r1 */
+static void tile_span(const struct TileHash *th,
+                      unsigned long x, unsigned long y,
+                      unsigned long w, unsigned long h,
+                      unsigned long *c0, unsigned long *c1,
+                      unsigned long *r0, unsigned long *r1)
+{
+    *c0 = x / TILE_SIZE;
+    *c1 = (x + w - 1) / TILE_SIZE;
+    *r0 = y / TILE_SIZE;
+    *r1 = (y + h - 1) / TILE_SIZE;
+    if (*c1 >= th->cols) *c1 = th->cols - 1;
+    if (*r1 >= th->rows) *r1 = th->rows - 1;
+}
+
+/* Part of tile c, r inside x, y, w x h, relative to the tile, in
+ * box[4] (left, top, right, bottom) */
+static void tile_part(const struct TileHash *th, unsigned long c,
+                      unsigned long r, unsigned long x, unsigned long y,
+                      unsigned long w, unsigned long h, unsigned char *box)
+{
+    unsigned long left = c * TILE_SIZE, right = left + TILE_SIZE;
+    unsigned long top = r * TILE_SIZE, bottom = top + TILE_SIZE;
+
+    if (left < x) left = x;
+    if (top < y) top = y;
+    if (right > x + w) right = x + w;
+    if (bottom > y + h) bottom = y + h;
+    if (right > th->width) right = th->width;
+    if (bottom > th->height) bottom = th->height;
+
+    box[0] = (unsigned char)(left - c * TILE_SIZE);
+    box[1] = (unsigned char)(top - r * TILE_SIZE);
+    box[2] = (unsigned char)(right - c * TILE_SIZE);
+    box[3] = (unsigned char)(bottom - r * TILE_SIZE);
+}
+
+/* Whether box lies within outer */
+static int box_within(const unsigned char *box, const unsigned char *outer)
+{
+    return box[0] >= outer[0] && box[1] >= outer[1] &&
+           box[2] <= outer[2] && box[3] <= outer[3];
+}
+
+int tile_hash_changed(const struct TileHash *th,
+                      unsigned long x, unsigned long y,
+                      unsigned long w, unsigned long h,
+                      unsigned long *cx, unsigned long *cy,
+                      unsigned long *cw, unsigned long *ch)
+{
+    unsigned long c0, c1, r0, r1, c, r;
+    unsigned long minc = ~0UL, maxc = 0, minr = ~0UL, maxr = 0;
+    unsigned long x1, y1;
+
+    if (!th->now || w == 0 || h == 0)
+        return 0;
+
+    tile_span(th, x, y, w, h, &c0, &c1, &r0, &r1);
+    for (r = r0; r <= r1; r++) {
+        const unsigned long *now = th->now + r * th->cols;
+        const unsigned long *sent = th->sent + r * th->cols;
+
+        for (c = c0; c <= c1; c++) {
+            unsigned char box[4];
+
+            tile_part(th, c, r, x, y, w, h, box);
+            if (sent[c] == TILE_SUM(now[c]) &&
+                box_within(box, th->part + (r * th->cols + c) * 4))
+                continue;
+            if (c < minc) minc = c;
+            if (c > maxc) maxc = c;
+            if (r < minr) minr = r;
+            if (r > maxr) maxr = r;
+        }
+    }
+    if (minc == ~0UL)
+        return 0;
+
+    /* Tiles to pixels, clipped to the region */
+    *cx = minc * TILE_SIZE > x ? minc * TILE_SIZE : x;
+    *cy = minr * TILE_SIZE > y ? minr * TILE_SIZE : y;
+    x1 = (maxc + 1) * TILE_SIZE;
+    y1 = (maxr + 1) * TILE_SIZE;
+    if (x1 > x + w) x1 = x + w;
+    if (y1 > y + h) y1 = y + h;
+    *cw = x1 - *cx;
+    *ch = y1 - *cy;
+    return 1;
+}
+
+void tile_hash_sent(struct TileHash *th, unsigned long x, unsigned long y,
+                    unsigned long w, unsigned long h)
+{
+    unsigned long c0, c1, r0, r1, c, r;
+
+    if (!th->now || w == 0 || h == 0)
+        return;
+
+    tile_span(th, x, y, w, h, &c0, &c1, &r0, &r1);
+    for (r = r0; r <= r1; r++) {
+        for (c = c0; c <= c1; c++) {
+            unsigned long i = r * th->cols + c;
+            unsigned char *part = th->part + i * 4;
+            unsigned char box[4];
+
+            /* An unchanged tile keeps a larger part sent before */
+            tile_part(th, c, r, x, y, w, h, box);
+            if (th->sent[i] == TILE_SUM(th->now[i]) && box_within(box, part))
+                continue;
+            th->sent[i] = TILE_SUM(th->now[i]);
+            memcpy(part, box, 4);
+        }
+    }
+}
+
+void tile_hash_forget(struct TileHash *th)
+{
+    if (th->sent)
+        memset(th->sent, 0, th->cols * th->rows * sizeof(*th->sent));
+    if (th->part)
+        memset(th->part, 0, th->cols * th->rows * 4);
+}
+
+void tile_hash_free(struct TileHash *th)
+{
+    free(th->now);
+    free(th->sent);
+    free(th->part);
+    th->now = NULL;
+    th->sent = NULL;
+    th->part = NULL;
+    th->cols = th->rows = 0;
+}
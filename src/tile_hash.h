@@ -0,0 +1,54 @@
+#ifndef AMIGAAI_TILE_HASH_H
+#define AMIGAAI_TILE_HASH_H
+
+/* Side of a tile in pixels */
+#define TILE_SIZE 32
+
+/* Per-tile checksums of a screen, to tell what changed since it was
+ * last sent. Each tile keeps the checksum of its pixels now and as
+ * they were when last sent (0 = not sent yet). Start from a zeroed
+ * TileHash. */
+struct TileHash {
+    unsigned long  width, height;   /* pixels */
+    unsigned long  cols, rows;      /* tiles */
+    unsigned long  format;          /* anything else the pixels depend on
+                                       (palette, depth, scale) */
+    unsigned long *now;
+    unsigned long *sent;
+    unsigned char *part;            /* part of each tile sent: left, top,
+                                       right, bottom within it */
+};
+
+/* Prepare for hashing a width x height image whose rows also depend on
+ * format (e.g. a checksum of the palette). A different size or format
+ * forgets what was sent. Returns 0, or -1 if out of memory. */
+int tile_hash_start(struct TileHash *th, unsigned long width,
+                    unsigned long height, unsigned long format);
+
+/* Hash image row y from pixel x0 (a multiple of TILE_SIZE) on, n pixels
+ * of bpp bytes each. The rows of a tile must be added top to bottom,
+ * starting with its first. */
+void tile_hash_row(struct TileHash *th, unsigned long y, unsigned long x0,
+                   unsigned long n, const unsigned char *row, int bpp);
+
+/* Bounding box, clipped to the region x, y, w x h, of the tiles in the
+ * region that changed since they were sent (or were never sent), in
+ * *cx, *cy, *cw, *ch. Only tiles hashed since tile_hash_start() may
+ * be in the region. Returns 1 if any changed, 0 if none. */
+int tile_hash_changed(const struct TileHash *th,
+                      unsigned long x, unsigned long y,
+                      unsigned long w, unsigned long h,
+                      unsigned long *cx, unsigned long *cy,
+                      unsigned long *cw, unsigned long *ch);
+
+/* Mark the tiles under x, y, w x h as sent. A tile only partly inside
+ * counts as unchanged afterwards only for the part of it that was sent. */
+void tile_hash_sent(struct TileHash *th, unsigned long x, unsigned long y,
+                    unsigned long w, unsigned long h);
+
+/* Forget what was sent (e.g. when the conversation is cleared) */
+void tile_hash_forget(struct TileHash *th);
+
+void tile_hash_free(struct TileHash *th);
+
+#endif /* AMIGAAI_TILE_HASH_H */
@@ -11,6 +11,9 @@
 #include "dt_identify.h"
 #include "input.h"
 #include "base64.h"
+#include "image_scale.h"
+#include "screen_grab.h"
+#include "tile_hash.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -261,6 +264,8 @@ cJSON *tools_build_json(void)
         cJSON *props = cJSON_CreateObject();
         cJSON *path_prop = cJSON_CreateObject();
         cJSON *content_prop = cJSON_CreateObject();
+        cJSON *enc_prop = cJSON_CreateObject();
+        cJSON *enc_enum = cJSON_CreateArray();
         cJSON *req = cJSON_CreateArray();
 
         cJSON_AddStringToObject(tool, "name", "write_file");
@@ -278,6 +283,15 @@ cJSON *tools_build_json(void)
             "Content to write to the file");
         cJSON_AddItemToObject(props, "content", content_prop);
 
+        cJSON_AddStringToObject(enc_prop, "type", "string");
+        cJSON_AddStringToObject(enc_prop, "description",
+            "How content is encoded: text, or base64 for binary data. "
+            "Default: text");
+        cJSON_AddItemToArray(enc_enum, cJSON_CreateString("text"));
+        cJSON_AddItemToArray(enc_enum, cJSON_CreateString("base64"));
+        cJSON_AddItemToObject(enc_prop, "enum", enc_enum);
+        cJSON_AddItemToObject(props, "encoding", enc_prop);
+
         cJSON_AddStringToObject(schema, "type", "object");
         cJSON_AddItemToObject(schema, "properties", props);
         cJSON_AddItemToArray(req, cJSON_CreateString("path"));
@@ -375,7 +389,9 @@ cJSON *tools_build_json(void)
         cJSON_AddStringToObject(tool, "description",
             "Move the mouse pointer to absolute screen coordinates (pixels). "
             "Top-left corner is 0,0. Typical Workbench screen: "
-            "640x256 (PAL) or 640x200 (NTSC), higher with RTG.");
+            "640x256 (PAL) or 640x200 (NTSC), higher with RTG. "
+            "Large screens are scaled down in screenshots; give "
+            "coordinates as seen in the screenshot image.");
 
         cJSON_AddStringToObject(x_prop, "type", "integer");
         cJSON_AddStringToObject(x_prop, "description", "X coordinate in pixels");
@@ -516,12 +532,22 @@ cJSON *tools_build_json(void)
         cJSON *y_prop = cJSON_CreateObject();
         cJSON *w_prop = cJSON_CreateObject();
         cJSON *h_prop = cJSON_CreateObject();
+        cJSON *s_prop = cJSON_CreateObject();
+        cJSON *d_prop = cJSON_CreateObject();
+        cJSON *f_prop = cJSON_CreateObject();
 
         cJSON_AddStringToObject(tool, "name", "screenshot");
         cJSON_AddStringToObject(tool, "description",
-            "Capture a screenshot of the Amiga screen using sgrab. "
-            "Returns the image as PNG. Omit all parameters for a full "
-            "screen capture, or specify x/y/w/h to capture a region.");
+            "Capture a screenshot of the Amiga screen (the default "
+            "public screen, normally Workbench). Returns the image as "
+            "PNG. Omit all parameters for a full screen capture, or "
+            "specify x/y/w/h to capture a region. Large screens are "
+            "scaled down; the region is given in the coordinates of "
+            "the scaled full-screen image. scale shrinks screenshots "
+            "further and stays in effect for later screenshots and "
+            "mouse_move. If nothing in the region changed since the "
+            "last screenshot, no image is sent; with delta, only the "
+            "changed area is sent, with its position.");
 
         cJSON_AddStringToObject(x_prop, "type", "integer");
         cJSON_AddStringToObject(x_prop, "description",
@@ -543,6 +569,21 @@ cJSON *tools_build_json(void)
             "Height of capture region (pixels)");
         cJSON_AddItemToObject(props, "h", h_prop);
 
+        cJSON_AddStringToObject(s_prop, "type", "integer");
+        cJSON_AddStringToObject(s_prop, "description",
+            "Scale in percent (10-100), e.g. 50 for a quick overview");
+        cJSON_AddItemToObject(props, "scale", s_prop);
+
+        cJSON_AddStringToObject(d_prop, "type", "boolean");
+        cJSON_AddStringToObject(d_prop, "description",
+            "Send only the area that changed since the last screenshot");
+        cJSON_AddItemToObject(props, "delta", d_prop);
+
+        cJSON_AddStringToObject(f_prop, "type", "boolean");
+        cJSON_AddStringToObject(f_prop, "description",
+            "Send the image even if nothing changed");
+        cJSON_AddItemToObject(props, "force", f_prop);
+
         cJSON_AddStringToObject(schema, "type", "object");
         cJSON_AddItemToObject(schema, "properties", props);
         /* No required params — all optional */
@@ -1112,15 +1153,45 @@ static char *tool_exec_read_file(cJSON *input, int *is_error)
     return result;
 }
 
+/* Decode base64 content straight into the file, a piece at a time,
+ * so binary data never needs a second full-size buffer.
+ * Returns the number of bytes written, -1 on bad input, -2 on a
+ * write error. */
+static long write_base64(FILE *f, const char *text, size_t len)
+{
+    struct Base64Decoder dec;
+    unsigned char buf[BASE64_DECODED_MAX(1024)];
+    long total = 0;
+
+    base64_decode_init(&dec);
+    while (len > 0) {
+        size_t n = len < 1024 ? len : 1024;
+        long out = base64_decode_update(&dec, text, n, buf);
+
+        if (out < 0)
+            return -1;
+        if (out > 0 && fwrite(buf, 1, (size_t)out, f) != (size_t)out)
+            return -2;
+        total += out;
+        text += n;
+        len -= n;
+    }
+
+    return base64_decode_final(&dec) == 0 ? total : -1;
+}
+
 /* Write content to a file */
 static char *tool_exec_write_file(cJSON *input, int *is_error)
 {
-    cJSON *path_json, *content_json;
+    cJSON *path_json, *content_json, *enc_json;
     const char *path, *content;
+    int binary = 0;
+    long written;
     FILE *f;
 
     path_json    = cJSON_GetObjectItemCaseSensitive(input, "path");
     content_json = cJSON_GetObjectItemCaseSensitive(input, "content");
+    enc_json     = cJSON_GetObjectItemCaseSensitive(input, "encoding");
 
     if (!path_json || !cJSON_IsString(path_json) || !path_json->valuestring[0]) {
         *is_error = 1;
@@ -1130,13 +1201,22 @@ static char *tool_exec_write_file(cJSON *input, int *is_error)
         *is_error = 1;
         return strdup("Missing 'content' parameter");
     }
+    if (enc_json && cJSON_IsString(enc_json)) {
+        if (strcmp(enc_json->valuestring, "base64") == 0) {
+            binary = 1;
+        } else if (strcmp(enc_json->valuestring, "text") != 0) {
+            *is_error = 1;
+            return strdup("Unknown 'encoding' (use text or base64)");
+        }
+    }
 
     path    = path_json->valuestring;
     content = content_json->valuestring;
 
-    printf("  [tool] write_file: %s (%d bytes)\n", path, (int)strlen(content));
+    printf("  [tool] write_file: %s (%d %s)\n", path, (int)strlen(content),
+           binary ? "base64 chars" : "bytes");
 
-    f = fopen(path, "w");
+    f = fopen(path, binary ? "wb" : "w");
     if (!f) {
         *is_error = 1;
         {
@@ -1146,13 +1226,26 @@ static char *tool_exec_write_file(cJSON *input, int *is_error)
         }
     }
 
-    fputs(content, f);
+    if (binary) {
+        written = write_base64(f, content, strlen(content));
+    } else {
+        fputs(content, f);
+        written = (long)strlen(content);
+    }
     fclose(f);
 
+    if (written < 0) {
+        char buf[256];
+        *is_error = 1;
+        snprintf(buf, sizeof(buf), written == -1 ?
+                 "Invalid base64 content, %s is incomplete" :
+                 "Write error on %s", path);
+        return strdup(buf);
+    }
+
     {
         char buf[256];
-        snprintf(buf, sizeof(buf), "Wrote %d bytes to %s",
-                 (int)strlen(content), path);
+        snprintf(buf, sizeof(buf), "Wrote %ld bytes to %s", written, path);
         return strdup(buf);
     }
 }
@@ -1309,6 +1402,76 @@ static char *tool_exec_identify(cJSON *input, int *is_error)
     }
 }
 
+/* ===================== Screen coordinates ===================== */
+
+static unsigned long image_max_edge   = IMAGE_DEFAULT_MAX_EDGE;
+static unsigned long image_max_pixels = IMAGE_DEFAULT_MAX_PIXELS;
+static int           image_png_level  = 3;
+
+/* Screen size and the size of a full screenshot as sent (smaller for
+ * screens beyond the image limits, or with a scale below 100%).
+ * Claude's coordinates refer to the screenshot; they are scaled back
+ * with these. Updated with each screenshot, so equal (no scaling)
+ * before the first. */
+static long shot_screen_w = 1, shot_screen_h = 1;
+static long shot_image_w  = 1, shot_image_h  = 1;
+
+/* Screenshot scale in percent, set by the tool's scale parameter and
+ * kept for later screenshots */
+#define SHOT_SCALE_MIN 10
+static int shot_scale_pct = 100;
+
+/* Tiles of the screen as last sent to Claude */
+static struct TileHash shot_tiles;
+
+void tools_forget_screen(void)
+{
+    tile_hash_free(&shot_tiles);
+}
+
+void tools_set_image_limits(unsigned long max_edge, unsigned long max_pixels,
+                            int png_level)
+{
+    image_max_edge = max_edge;
+    image_max_pixels = max_pixels;
+    image_png_level = png_level;
+}
+
+/* Screenshot image coordinate (or size) to screen pixels */
+static int screen_x(int x)
+{
+    return (int)(((long)x * shot_screen_w + shot_image_w / 2) / shot_image_w);
+}
+
+static int screen_y(int y)
+{
+    return (int)(((long)y * shot_screen_h + shot_image_h / 2) / shot_image_h);
+}
+
+/* Take the scale of screenshots from the current screen size, the
+ * image limits and the scale percentage */
+static void update_shot_scale(void)
+{
+    int w, h;
+    unsigned long iw, ih;
+
+    if (input_screen_size(&w, &h) != 0 || w <= 0 || h <= 0)
+        return;
+
+    scale_fit((unsigned long)w, (unsigned long)h,
+              image_max_edge, image_max_pixels, &iw, &ih);
+    if (shot_scale_pct < 100) {
+        iw = (iw * shot_scale_pct + 50) / 100;
+        ih = (ih * shot_scale_pct + 50) / 100;
+        if (iw == 0) iw = 1;
+        if (ih == 0) ih = 1;
+    }
+    shot_screen_w = w;
+    shot_screen_h = h;
+    shot_image_w = (long)iw;
+    shot_image_h = (long)ih;
+}
+
 /* ===================== Input tools ===================== */
 
 static char *tool_exec_mouse_move(cJSON *input, int *is_error)
@@ -1322,7 +1485,8 @@ static char *tool_exec_mouse_move(cJSON *input, int *is_error)
         return strdup("Missing or invalid x/y parameter");
     }
 
-    if (input_mouse_move(x_json->valueint, y_json->valueint) != 0) {
+    if (input_mouse_move(screen_x(x_json->valueint),
+                         screen_y(y_json->valueint)) != 0) {
         *is_error = 1;
         return strdup("Failed to move mouse");
     }
@@ -1403,98 +1567,100 @@ static char *tool_exec_type_text(cJSON *input, int *is_error)
 
 /* ===================== Screenshot ===================== */
 
-#define SCREENSHOT_FILE "T:aai_shot.png"
-
-static char *tool_exec_screenshot(cJSON *input, int *is_error, int *has_image)
+static char *tool_exec_screenshot(cJSON *input, int *is_error, long *image_len,
+                                  char **caption)
 {
-    char cmd[256];
-    int pos;
-    FILE *fp;
-    long fsize;
-    unsigned char *fdata;
-    char *b64;
-    cJSON *xj, *yj, *wj, *hj;
+    cJSON *xj, *yj, *wj, *hj, *sj;
+    struct ScreenGrab g;
+    unsigned char *png;
+    long png_len;
+    char text[160];
+    int rc;
+
+    sj = cJSON_GetObjectItemCaseSensitive(input, "scale");
+    if (sj && cJSON_IsNumber(sj)) {
+        if (sj->valueint < SHOT_SCALE_MIN || sj->valueint > 100) {
+            *is_error = 1;
+            return strdup("Invalid scale: use 10 to 100 (percent)");
+        }
+        shot_scale_pct = sj->valueint;
+    }
 
-    /* Build sgrab command */
-    pos = snprintf(cmd, sizeof(cmd), "sgrab FILE %s PNG NOBEEP", SCREENSHOT_FILE);
+    update_shot_scale();
 
+    memset(&g, 0, sizeof(g));
+
+    /* The region is given in screenshot image coordinates */
     xj = cJSON_GetObjectItemCaseSensitive(input, "x");
     yj = cJSON_GetObjectItemCaseSensitive(input, "y");
     wj = cJSON_GetObjectItemCaseSensitive(input, "w");
     hj = cJSON_GetObjectItemCaseSensitive(input, "h");
-
-    if (xj && cJSON_IsNumber(xj))
-        pos += snprintf(cmd + pos, sizeof(cmd) - pos, " X %d", xj->valueint);
-    if (yj && cJSON_IsNumber(yj))
-        pos += snprintf(cmd + pos, sizeof(cmd) - pos, " Y %d", yj->valueint);
-    if (wj && cJSON_IsNumber(wj))
-        pos += snprintf(cmd + pos, sizeof(cmd) - pos, " W %d", wj->valueint);
-    if (hj && cJSON_IsNumber(hj))
-        pos += snprintf(cmd + pos, sizeof(cmd) - pos, " H %d", hj->valueint);
-
-    /* Execute sgrab */
-    if (SystemTagList(cmd, NULL) != 0) {
-        *is_error = 1;
-        return strdup("sgrab command failed. Is sgrab installed in the path?");
-    }
-
-    /* Read the PNG file */
-    fp = fopen(SCREENSHOT_FILE, "rb");
-    if (!fp) {
-        *is_error = 1;
-        return strdup("Failed to open screenshot file");
-    }
-
-    fseek(fp, 0, SEEK_END);
-    fsize = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-
-    if (fsize <= 0) {
-        fclose(fp);
-        DeleteFile((CONST_STRPTR)SCREENSHOT_FILE);
+    if (xj && cJSON_IsNumber(xj)) g.x = screen_x(xj->valueint);
+    if (yj && cJSON_IsNumber(yj)) g.y = screen_y(yj->valueint);
+    if (wj && cJSON_IsNumber(wj)) g.w = screen_x(wj->valueint);
+    if (hj && cJSON_IsNumber(hj)) g.h = screen_y(hj->valueint);
+
+    /* A region keeps the scale of the full screen */
+    g.scaled_w = (unsigned long)shot_image_w;
+    g.scaled_h = (unsigned long)shot_image_h;
+    g.level = image_png_level;
+    g.tiles = &shot_tiles;
+    g.delta = cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(input, "delta"));
+    g.force = cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(input, "force"));
+
+    rc = screen_grab_png(&g, &png, &png_len);
+    if (rc == 1)
+        return strdup("Screen unchanged since the last screenshot "
+                      "(no image sent)");
+    if (rc != 0) {
         *is_error = 1;
-        return strdup("Screenshot file is empty");
-    }
-
-    fdata = (unsigned char *)malloc(fsize);
-    if (!fdata) {
-        fclose(fp);
-        DeleteFile((CONST_STRPTR)SCREENSHOT_FILE);
-        *is_error = 1;
-        return strdup("Out of memory reading screenshot");
-    }
-
-    if (fread(fdata, 1, fsize, fp) != (size_t)fsize) {
-        free(fdata);
-        fclose(fp);
-        DeleteFile((CONST_STRPTR)SCREENSHOT_FILE);
-        *is_error = 1;
-        return strdup("Failed to read screenshot file");
-    }
-    fclose(fp);
-
-    /* Delete temp file */
-    DeleteFile((CONST_STRPTR)SCREENSHOT_FILE);
-
-    /* Base64-encode */
-    b64 = base64_encode(fdata, (size_t)fsize, NULL);
-    free(fdata);
-
-    if (!b64) {
-        *is_error = 1;
-        return strdup("Out of memory encoding screenshot");
-    }
-
-    *has_image = 1;
-    return b64;
+        return strdup("Failed to capture the screen (region outside "
+                      "the screen, or out of memory)");
+    }
+
+    /* Where a delta goes, in the coordinates of the full screenshot */
+    if (!g.changed)
+        strcpy(text, "Screenshot captured (unchanged since the last one)");
+    else if (g.delta)
+        snprintf(text, sizeof(text),
+                 "Changed area only, at x=%ld y=%ld w=%lu h=%lu; the rest "
+                 "is unchanged since the last screenshot",
+                 ((long)g.sent.x * shot_image_w + shot_screen_w / 2) /
+                     shot_screen_w,
+                 ((long)g.sent.y * shot_image_h + shot_screen_h / 2) /
+                     shot_screen_h,
+                 g.sent.dst_w, g.sent.dst_h);
+    else
+        strcpy(text, "Screenshot captured");
+    if (caption)
+        *caption = strdup(text);
+
+    /* From here Claude is taken to have seen the area; claude.c calls
+     * tools_forget_screen() if the result never reaches the conversation */
+    tile_hash_sent(&shot_tiles, g.sent.x, g.sent.y, g.sent.w, g.sent.h);
+
+    /* The PNG bytes go into the conversation as they are; they are
+     * base64-encoded only while a request is being written */
+    *image_len = png_len;
+    return (char *)png;
 }
 
 /* ===================== Dispatcher ===================== */
 
-char *tool_execute(const char *name, cJSON *input, int *is_error, int *has_image)
+int tool_is_read_only(const char *name)
+{
+    return strcmp(name, "read_file") == 0 ||
+           strcmp(name, "identify_file") == 0 ||
+           strcmp(name, "list_ports") == 0 ||
+           strcmp(name, "screenshot") == 0;
+}
+
+char *tool_execute(const char *name, cJSON *input, int *is_error,
+                   long *image_len, char **caption)
 {
     *is_error = 0;
-    *has_image = 0;
+    *image_len = 0;
+    if (caption) *caption = NULL;
 
     /* Convert all UTF-8 strings in tool input to ISO-8859-1 for AmigaOS */
     if (input)
@@ -1531,7 +1697,7 @@ char *tool_execute(const char *name, cJSON *input, int *is_error, int *has_image
         return tool_exec_type_text(input, is_error);
 
     if (strcmp(name, "screenshot") == 0)
-        return tool_exec_screenshot(input, is_error, has_image);
+        return tool_exec_screenshot(input, is_error, image_len, caption);
 
     *is_error = 1;
     {
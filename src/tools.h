@@ -13,8 +13,15 @@ cJSON *tools_build_json(void);
 /* Execute a tool by name with the given input object.
  * Returns a newly allocated result string (caller must free).
  * Sets *is_error to 1 if the tool execution failed.
- * Sets *has_image to 1 if the result is base64-encoded image data. */
-char *tool_execute(const char *name, cJSON *input, int *is_error, int *has_image);
+ * If the result is PNG image data rather than text, *image_len is set to
+ * its size in bytes, else to 0, and *caption (unless caption is NULL)
+ * to a newly allocated caption for the image, else to NULL. */
+char *tool_execute(const char *name, cJSON *input, int *is_error,
+                   long *image_len, char **caption);
+
+/* Returns 1 if the tool only reads state (files, ports, the screen)
+ * and may run before the rest of the response has arrived. */
+int tool_is_read_only(const char *name);
 
 /* Poll callback for async shell execution.
  * Called periodically while a shell command runs in a child process.
@@ -22,4 +29,16 @@ char *tool_execute(const char *name, cJSON *input, int *is_error, int *has_image
 typedef int (*ToolPollCallback)(void *userdata);
 void tools_set_poll_callback(ToolPollCallback cb, void *userdata);
 
+/* Screenshots larger than max_edge (longest side) or max_pixels are
+ * scaled down (0 = no limit) and written at the given PNG level.
+ * mouse_move and screenshot regions then take coordinates in the
+ * scaled image. */
+void tools_set_image_limits(unsigned long max_edge, unsigned long max_pixels,
+                            int png_level);
+
+/* Forget which parts of the screen were sent, so the next screenshot
+ * is sent whole: when the conversation is cleared, when a screenshot
+ * result is dropped instead of added to it, and at exit. */
+void tools_forget_screen(void);
+
 #endif /* AMIGAAI_TOOLS_H */
@@ -0,0 +1,163 @@
+/*
+ * b64bench - Measure base64 throughput
+ *
+ * Times the table-driven encoder and decoder in src/base64.c (whole
+ * buffer and streamed in 4 KB pieces, as a file is read) against the
+ * straightforward 6-bit-per-character code they replaced, and reports
+ * MB/s of binary data. Runs on the host or, cross-compiled, on the
+ * Amiga itself.
+ *
+ * Usage: b64bench [data KB] [rounds]
+ *
+ * Build (host):  cc -O2 -Isrc -o tools/b64bench tools/b64bench.c src/base64.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "base64.h"
+
+#define PIECE 4096
+
+static const char ref_table[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* The previous encoder: four lookups per 3-byte group */
+static size_t ref_encode(const unsigned char *data, size_t len, char *out)
+{
+    size_t i, j;
+
+    for (i = 0, j = 0; i + 2 < len; i += 3) {
+        out[j++] = ref_table[(data[i] >> 2) & 0x3F];
+        out[j++] = ref_table[((data[i] & 0x03) << 4) | ((data[i+1] >> 4) & 0x0F)];
+        out[j++] = ref_table[((data[i+1] & 0x0F) << 2) | ((data[i+2] >> 6) & 0x03)];
+        out[j++] = ref_table[data[i+2] & 0x3F];
+    }
+    if (i < len) {
+        out[j++] = ref_table[(data[i] >> 2) & 0x3F];
+        if (i + 1 < len) {
+            out[j++] = ref_table[((data[i] & 0x03) << 4) | ((data[i+1] >> 4) & 0x0F)];
+            out[j++] = ref_table[((data[i+1] & 0x0F) << 2)];
+        } else {
+            out[j++] = ref_table[((data[i] & 0x03) << 4)];
+            out[j++] = '=';
+        }
+        out[j++] = '=';
+    }
+    return j;
+}
+
+static int ref_value(unsigned char c)
+{
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+/* The previous decoder: one character and a bit accumulator at a time */
+static size_t ref_decode(const char *text, size_t len, unsigned char *out)
+{
+    unsigned long acc = 0;
+    size_t i, j = 0;
+    int bits = 0;
+
+    for (i = 0; i < len; i++) {
+        int v = ref_value((unsigned char)text[i]);
+        if (v < 0)
+            break;
+        acc = (acc << 6) | (unsigned long)v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out[j++] = (unsigned char)(acc >> bits);
+        }
+    }
+    return j;
+}
+
+static double seconds(clock_t start)
+{
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void report(const char *what, long bytes, int rounds, double t)
+{
+    printf("%-16s %.1f MB/s\n", what,
+           t > 0 ? (double)bytes * rounds / t / 1048576.0 : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+    long data_kb = argc > 1 ? atol(argv[1]) : 1024;
+    int rounds = argc > 2 ? atoi(argv[2]) : 20;
+    long len = data_kb * 1024, i;
+    unsigned char *data, *back;
+    char *text;
+    size_t text_len = 0, n = 0;
+    clock_t start;
+    int r;
+
+    data = malloc(len);
+    back = malloc(BASE64_DECODED_MAX(BASE64_ENCODED_LEN(len)));
+    text = malloc(BASE64_ENCODED_LEN(len) + 1);
+    if (!data || !back || !text) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    for (i = 0; i < len; i++)
+        data[i] = (unsigned char)(i * 131 + i / 251);
+
+    start = clock();
+    for (r = 0; r < rounds; r++)
+        text_len = ref_encode(data, len, text);
+    report("encode (old):", len, rounds, seconds(start));
+
+    start = clock();
+    for (r = 0; r < rounds; r++)
+        text_len = base64_encode_block(data, len, text);
+    report("encode:", len, rounds, seconds(start));
+
+    start = clock();
+    for (r = 0; r < rounds; r++) {
+        struct Base64Encoder enc;
+        long pos;
+
+        base64_encode_init(&enc);
+        text_len = 0;
+        for (pos = 0; pos < len; pos += PIECE)
+            text_len += base64_encode_update(&enc, data + pos,
+                                             len - pos < PIECE ? len - pos : PIECE,
+                                             text + text_len);
+        text_len += base64_encode_final(&enc, text + text_len);
+    }
+    report("encode (4K):", len, rounds, seconds(start));
+
+    start = clock();
+    for (r = 0; r < rounds; r++)
+        n = ref_decode(text, text_len, back);
+    report("decode (old):", len, rounds, seconds(start));
+
+    start = clock();
+    for (r = 0; r < rounds; r++) {
+        struct Base64Decoder dec;
+
+        base64_decode_init(&dec);
+        n = (size_t)base64_decode_update(&dec, text, text_len, back);
+    }
+    report("decode:", len, rounds, seconds(start));
+
+    if (n != (size_t)len || memcmp(back, data, len) != 0) {
+        fprintf(stderr, "Round trip failed\n");
+        return 1;
+    }
+
+    free(data);
+    free(back);
+    free(text);
+    return 0;
+}
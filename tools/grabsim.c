@@ -0,0 +1,374 @@
+/*
+ * grabsim - Run the screenshot encoding path on synthetic screens
+ *
+ * Feeds screens modelled on what screen_grab.c reads (a 4-colour
+ * Workbench, an EHB and a HAM6 screen as pens, a 24-bit RTG desktop as
+ * RGB) through screen_rows.c and image_encode.c, as screen_grab.c does
+ * with the rows of a bitmap, with the same region clipping and scaling
+ * as the screenshot tool, and reports the PNG size and encoding time.
+ * With -o the PNG is written out for inspection.
+ *
+ * With -c, a rectangle is then drawn on the screen and the change
+ * detection of tile_hash.c run on the frames: the same screen again
+ * (which should send nothing), then the changed one, reporting the
+ * changed area sent and its PNG size.
+ *
+ * Usage: grabsim [-r x,y,w,h] [-s percent] [-l level] [-o file]
+ *                [-c x,y,w,h] [screen]
+ *        screen: wb (default), ehb, ham, rtg
+ *
+ * Build (host):  cc -O2 -Isrc -o tools/grabsim tools/grabsim.c \
+ *                   src/screen_rows.c src/image_encode.c \
+ *                   src/image_scale.c src/tile_hash.c \
+ *                   src/png_encode.c src/deflate.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "image_encode.h"
+#include "image_scale.h"
+#include "screen_rows.h"
+#include "tile_hash.h"
+
+struct Screen {
+    const char *name;
+    unsigned long width, height;
+    unsigned depth;
+    int truecolor;              /* rows are RGB */
+    int ham, ehb;               /* display mode properties */
+    void (*row)(unsigned char *row, unsigned long width, unsigned long y);
+};
+
+/* Region being read: screen_rows.c rows with this as their source */
+struct Grab {
+    const struct Screen *scr;
+    struct ScreenRows    rows;
+    unsigned long        top;
+    unsigned char       *line;  /* one full screen row */
+    long                 cx, cy, cw, ch;    /* rectangle drawn, if cw */
+};
+
+/* 4-colour Workbench: title bar, a window with text, icons */
+static void wb_row(unsigned char *r, unsigned long w, unsigned long y)
+{
+    unsigned long x;
+
+    for (x = 0; x < w; x++) {
+        int c = 0;
+        if (y < 11)
+            c = (x > w - 40 || y == 10) ? 1 : 2;
+        else if (x >= 40 && x < 360 && y >= 30 && y < 200) {
+            if (x == 40 || x == 359 || y == 30 || y == 199) c = 1;
+            else if (y < 41) c = ((x + y) & 1) ? 3 : 2;
+            else if (y >= 50 && (y - 50) % 12 < 8 && (x - 50) % 8 < 6 &&
+                     (x * 13 + y * 7 + (x / 8) * 31) % 5) c = 1;
+        } else if (x >= 400 && x < 600 && y >= 40 && y < 240 &&
+                   (x - 400) % 60 < 32 && (y - 40) % 50 < 20)
+            c = ((x ^ y) & 4) ? 3 : 1;
+        r[x] = (unsigned char)c;
+    }
+}
+
+/* HAM6: blue/red ramps set with modify pens, a palette colour every
+ * 16 pixels */
+static void ham_row(unsigned char *r, unsigned long w, unsigned long y)
+{
+    unsigned long x;
+
+    for (x = 0; x < w; x++) {
+        if (x % 16 == 0)
+            r[x] = (unsigned char)((x / 16 + y / 32) & 15);
+        else if (x & 1)
+            r[x] = (unsigned char)(0x10 | ((x + y) / 20 & 15));
+        else
+            r[x] = (unsigned char)(0x20 | (y / 16 & 15));
+    }
+}
+
+/* 24-bit desktop: gradient backdrop, two flat windows with text */
+static void rtg_row(unsigned char *r, unsigned long w, unsigned long y)
+{
+    unsigned long x;
+
+    for (x = 0; x < w; x++, r += 3) {
+        unsigned char c[3];
+        c[0] = (unsigned char)(40 + y * 60 / 1080);
+        c[1] = (unsigned char)(70 + x * 50 / 1920);
+        c[2] = (unsigned char)(140 + (x + y) * 60 / 3000);
+        if ((x >= 200 && x < 1100 && y >= 150 && y < 800) ||
+            (x >= 1200 && x < 1800 && y >= 300 && y < 900)) {
+            int text = y % 18 < 12 && x % 9 < 7 && (x * 7 + y * 3) % 11 > 3;
+            c[0] = c[1] = c[2] = (unsigned char)(text ? 20 : 230);
+            if (y % 650 < 22) { c[0] = 60; c[1] = 90; c[2] = 170; }
+        }
+        r[0] = c[0];
+        r[1] = c[1];
+        r[2] = c[2];
+    }
+}
+
+/* EHB: colour bars, each with a half-bright band below */
+static void ehb_row(unsigned char *r, unsigned long w, unsigned long y)
+{
+    unsigned long x;
+
+    for (x = 0; x < w; x++)
+        r[x] = (unsigned char)((x / 10 % 32) | (y % 32 >= 16 ? 32 : 0));
+}
+
+static const struct Screen screens[] = {
+    { "wb",  640,  256,  2, 0, 0, 0, wb_row  },
+    { "ehb", 320,  256,  6, 0, 0, 1, ehb_row },
+    { "ham", 320,  256,  6, 0, 1, 0, ham_row },
+    { "rtg", 1920, 1080, 24, 1, 0, 0, rtg_row }
+};
+
+/* Screen row y into g->line, with the rectangle drawn over it */
+static void screen_line(struct Grab *g, unsigned long y)
+{
+    const struct Screen *scr = g->scr;
+    int bpp = scr->truecolor ? 3 : 1;
+    long x;
+
+    scr->row(g->line, scr->width, y);
+    if (g->cw <= 0 || (long)y < g->cy || (long)y >= g->cy + g->ch)
+        return;
+    for (x = g->cx; x < g->cx + g->cw && x < (long)scr->width; x++)
+        memset(g->line + x * bpp, scr->ham ? 0x2F : 3, bpp);
+}
+
+/* Source of the rows, as screen_grab.c's bitmap readers */
+static const unsigned char *src_pens(void *handle, unsigned long y)
+{
+    struct Grab *g = (struct Grab *)handle;
+
+    screen_line(g, g->top + y);
+    return g->line + g->rows.src_left;
+}
+
+static int src_rgb(void *handle, unsigned long y, unsigned char *rgb)
+{
+    struct Grab *g = (struct Grab *)handle;
+
+    screen_line(g, g->top + y);
+    memcpy(rgb, g->line + g->rows.src_left * 3, g->rows.src_width * 3);
+    return 0;
+}
+
+/* Set g up to read x, y, w pixels wide */
+static int grab_region(struct Grab *g, unsigned long x, unsigned long y,
+                       unsigned long w)
+{
+    const struct Screen *scr = g->scr;
+    int kind = screen_rows_kind(scr->depth, scr->truecolor,
+                                scr->ham, scr->ehb);
+
+    if (kind < 0 || screen_rows_init(&g->rows, kind, scr->depth, x, w) != 0)
+        return -1;
+    g->rows.src_pens = src_pens;
+    g->rows.src_rgb = src_rgb;
+    g->rows.handle = g;
+    g->top = y;
+    return 0;
+}
+
+/* Encode region r into out */
+static int encode(struct Grab *g, const struct ScaleRegion *r, int level,
+                  struct ImageOut *out)
+{
+    struct ImageSource src;
+    int rc;
+
+    memset(out, 0, sizeof(*out));
+    if (grab_region(g, r->x, r->y, r->w) != 0) {
+        screen_rows_free(&g->rows);
+        return -1;
+    }
+
+    memset(&src, 0, sizeof(src));
+    src.width = r->w;
+    src.height = r->h;
+    src.palette = screen_rows_bpp(&g->rows) == 1 ? g->rows.palette : NULL;
+    src.read_row = screen_rows_read;
+    src.handle = &g->rows;
+
+    rc = image_encode_png(&src, r->dst_w, r->dst_h, level,
+                          image_out_sink, out);
+    screen_rows_free(&g->rows);
+    return rc;
+}
+
+/* Checksum the tiles of the whole screen as screen_grab.c does: pens,
+ * or RGB (HAM decoded) */
+static void hash_screen(struct TileHash *th, struct Grab *g)
+{
+    const struct Screen *scr = g->scr;
+    unsigned char *pixels;
+    unsigned long y;
+    int bpp;
+
+    tile_hash_start(th, scr->width, scr->height, 0);
+    if (grab_region(g, 0, 0, scr->width) != 0) {
+        screen_rows_free(&g->rows);
+        return;
+    }
+    bpp = screen_rows_bpp(&g->rows);
+    pixels = malloc(scr->width * bpp);
+    for (y = 0; pixels && y < scr->height; y++) {
+        screen_rows_read(&g->rows, y, pixels);
+        tile_hash_row(th, y, 0, scr->width, pixels, bpp);
+    }
+    free(pixels);
+    screen_rows_free(&g->rows);
+}
+
+/* Send the region once, then check an unchanged frame and one with
+ * the rectangle drawn, sending only what changed */
+static int changes(struct Grab *g, const struct ScaleRegion *r,
+                   unsigned long iw, unsigned long ih, int level,
+                   long cx, long cy, long cw, long ch)
+{
+    const struct Screen *scr = g->scr;
+    struct TileHash th;
+    struct ScaleRegion d;
+    struct ImageOut out;
+    unsigned long x, y, w, h;
+    int rc = 1;
+
+    memset(&th, 0, sizeof(th));
+    hash_screen(&th, g);
+    tile_hash_sent(&th, r->x, r->y, r->w, r->h);
+
+    hash_screen(&th, g);
+    printf("same screen: %s\n",
+           tile_hash_changed(&th, r->x, r->y, r->w, r->h, &x, &y, &w, &h) ?
+           "changed (wrong)" : "unchanged, nothing sent");
+
+    g->cx = cx;
+    g->cy = cy;
+    g->cw = cw;
+    g->ch = ch;
+    hash_screen(&th, g);
+    if (!tile_hash_changed(&th, r->x, r->y, r->w, r->h, &x, &y, &w, &h)) {
+        printf("rectangle %ld,%ld %ldx%ld: unchanged\n", cx, cy, cw, ch);
+        rc = 0;
+        goto cleanup;
+    }
+
+    scale_region(scr->width, scr->height, (long)x, (long)y, (long)w, (long)h,
+                 iw, ih, &d);
+    if (encode(g, &d, level, &out) != 0) {
+        fprintf(stderr, "Encoding failed\n");
+        goto cleanup;
+    }
+    printf("rectangle %ld,%ld %ldx%ld: sent %lu,%lu %lux%lu -> %lux%lu, "
+           "%ld bytes\n", cx, cy, cw, ch, d.x, d.y, d.w, d.h,
+           d.dst_w, d.dst_h, out.total);
+    image_out_free(&out);
+
+    tile_hash_sent(&th, d.x, d.y, d.w, d.h);
+    printf("after sending it: %s\n",
+           tile_hash_changed(&th, r->x, r->y, r->w, r->h, &x, &y, &w, &h) ?
+           "changed (wrong)" : "unchanged");
+    rc = 0;
+
+cleanup:
+    tile_hash_free(&th);
+    return rc;
+}
+
+int main(int argc, char **argv)
+{
+    const struct Screen *scr = &screens[0];
+    long rx = 0, ry = 0, rw = 0, rh = 0;
+    long cx = 0, cy = 0, cw = 0, ch = 0;
+    int pct = 100, level = 3, rounds = 5, i;
+    const char *outfile = NULL;
+    unsigned long iw, ih;
+    struct ScaleRegion r;
+    struct ImageOut out;
+    struct Grab g;
+    unsigned char *png;
+    clock_t start;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            sscanf(argv[++i], "%ld,%ld,%ld,%ld", &rx, &ry, &rw, &rh);
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+            sscanf(argv[++i], "%ld,%ld,%ld,%ld", &cx, &cy, &cw, &ch);
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            pct = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+            level = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            outfile = argv[++i];
+        else {
+            size_t n;
+            for (n = 0; n < sizeof(screens) / sizeof(screens[0]); n++)
+                if (strcmp(argv[i], screens[n].name) == 0)
+                    scr = &screens[n];
+        }
+    }
+    if (pct < 10 || pct > 100) pct = 100;
+
+    /* Scale of the full screen, as tools.c works it out */
+    scale_fit(scr->width, scr->height, IMAGE_DEFAULT_MAX_EDGE,
+              IMAGE_DEFAULT_MAX_PIXELS, &iw, &ih);
+    iw = (iw * pct + 50) / 100;
+    ih = (ih * pct + 50) / 100;
+    if (iw == 0) iw = 1;
+    if (ih == 0) ih = 1;
+
+    if (scale_region(scr->width, scr->height, rx, ry, rw, rh, iw, ih, &r) != 0) {
+        fprintf(stderr, "Region outside the screen\n");
+        return 1;
+    }
+
+    memset(&g, 0, sizeof(g));
+    g.scr = scr;
+    g.line = malloc(scr->width * 3);
+    if (!g.line) return 1;
+    for (i = 0; i < 32; i++) {
+        g.rows.palette[i * 3 + 0] = (unsigned char)(i * 8);
+        g.rows.palette[i * 3 + 1] = (unsigned char)(255 - i * 8);
+        g.rows.palette[i * 3 + 2] = (unsigned char)(i * 4);
+    }
+    /* Workbench 2.x colours */
+    if (scr->depth == 2)
+        memcpy(g.rows.palette, "\xAA\xAA\xAA\x00\x00\x00\xFF\xFF\xFF\x66\x88\xBB", 12);
+
+    start = clock();
+    for (i = 0; i < rounds; i++) {
+        if (encode(&g, &r, level, &out) != 0) {
+            fprintf(stderr, "Encoding failed\n");
+            return 1;
+        }
+        if (i < rounds - 1)
+            image_out_free(&out);
+    }
+
+    printf("%s %lux%lu: region %lu,%lu %lux%lu -> %lux%lu, %ld bytes, "
+           "%.1f ms\n", scr->name, scr->width, scr->height,
+           r.x, r.y, r.w, r.h, r.dst_w, r.dst_h, out.total,
+           (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC / rounds);
+
+    png = image_out_join(&out);
+    if (png && outfile) {
+        FILE *fp = fopen(outfile, "wb");
+        if (!fp || fwrite(png, 1, out.total, fp) != (size_t)out.total) {
+            fprintf(stderr, "Failed to write %s\n", outfile);
+            return 1;
+        }
+        fclose(fp);
+    }
+    free(png);
+
+    if (cw > 0 && changes(&g, &r, iw, ih, level, cx, cy, cw, ch) != 0)
+        return 1;
+
+    free(g.line);
+    return 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * jsonbench - Measure cJSON string throughput
+ *
+ * Builds a request-like document (a large base64 image block plus
+ * conversation text with some escapes), then times
+ * cJSON_PrintUnformatted() and cJSON_Parse() on it and reports MB/s.
+ * Runs on the host or, cross-compiled, on the Amiga itself.
+ *
+ * Usage: jsonbench [image KB] [rounds]
+ *
+ * Build (host):  cc -O2 -Isrc -o tools/jsonbench tools/jsonbench.c src/cJSON.c -lm
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cJSON.h"
+
+static double seconds(clock_t start)
+{
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char **argv)
+{
+    static const char b64[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    long image_kb = argc > 1 ? atol(argv[1]) : 1024;
+    int rounds = argc > 2 ? atoi(argv[2]) : 20;
+    long image_len = image_kb * 1024, text_len = 64 * 1024, i, len = 0;
+    char *image, *text, *json = NULL;
+    cJSON *root, *content, *block;
+    clock_t start;
+    double t_print, t_parse;
+    int r;
+
+    image = malloc(image_len + 1);
+    text = malloc(text_len + 1);
+    if (!image || !text) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    for (i = 0; i < image_len; i++)
+        image[i] = b64[(i * 7 + i / 64) & 63];
+    image[image_len] = '\0';
+    for (i = 0; i < text_len; i++)
+        text[i] = (i % 80 == 79) ? '\n' : (i % 500 == 250) ? '"' : 'a' + i % 26;
+    text[text_len] = '\0';
+
+    root = cJSON_CreateObject();
+    content = cJSON_AddArrayToObject(root, "content");
+    block = cJSON_CreateObject();
+    cJSON_AddStringToObject(block, "type", "image");
+    cJSON_AddStringToObject(block, "data", image);
+    cJSON_AddItemToArray(content, block);
+    block = cJSON_CreateObject();
+    cJSON_AddStringToObject(block, "type", "text");
+    cJSON_AddStringToObject(block, "text", text);
+    cJSON_AddItemToArray(content, block);
+
+    start = clock();
+    for (r = 0; r < rounds; r++) {
+        free(json);
+        json = cJSON_PrintUnformatted(root);
+    }
+    t_print = seconds(start);
+    len = json ? (long)strlen(json) : 0;
+
+    start = clock();
+    for (r = 0; r < rounds; r++)
+        cJSON_Delete(cJSON_Parse(json));
+    t_parse = seconds(start);
+
+    printf("document: %ld bytes, %d rounds\n", len, rounds);
+    printf("print:    %.1f MB/s\n",
+           t_print > 0 ? (double)len * rounds / t_print / 1048576.0 : 0.0);
+    printf("parse:    %.1f MB/s\n",
+           t_parse > 0 ? (double)len * rounds / t_parse / 1048576.0 : 0.0);
+
+    free(json);
+    cJSON_Delete(root);
+    free(image);
+    free(text);
+    return 0;
+}
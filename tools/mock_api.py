@@ -0,0 +1,291 @@
+#!/usr/bin/env python3
+"""Local stand-in for the Claude API, for testing AmigaAI without
+network access or API costs.
+
+Serves plain HTTP. Point AmigaAI at it with:
+
+  echo "http://<host>:8080" > ENV:AmigaAI/api_host
+
+Endpoints:
+  POST /v1/messages                      - echoes the last user message
+                                           ("stream": true -> SSE, chunked)
+  POST /v1/files                         - stores an uploaded file (multipart)
+  POST /v1/messages/batches              - creates a batch
+  GET  /v1/messages/batches/<id>         - batch status
+  GET  /v1/messages/batches/<id>/results - JSONL results (once ended)
+
+Batches end BATCH_DELAY seconds after creation, so scripts can
+exercise the BATCHSTATUS polling loop.
+
+To exercise the tool loop and model routing:
+  - a user message containing "[tool:<name>]" is answered with a
+    tool_use block for that tool (empty input)
+  - model names starting with "unknown" are rejected with HTTP 404
+
+Usage: mock_api.py [port]
+"""
+
+import base64
+import binascii
+import json
+import re
+import sys
+import time
+from http.server import BaseHTTPRequestHandler, HTTPServer
+
+BATCH_DELAY = 2.0
+STREAM_DELAY = 0.05     # seconds between streamed events
+
+batches = {}
+files = {}
+
+
+def image_text(block):
+    """Describe an image block; inline data must be valid base64."""
+    source = block.get("source", {})
+    if source.get("type") == "file":
+        return "[image %s]" % source.get("file_id")
+    try:
+        data = base64.b64decode(source.get("data", ""), validate=True)
+    except (binascii.Error, ValueError):
+        return "[image: bad base64]"
+    return "[image %d bytes]" % len(data)
+
+
+def message_text(message):
+    """Return the text of a user message (string or content blocks)."""
+    content = message.get("content", "")
+    if isinstance(content, str):
+        return content
+    parts = []
+    for block in content:
+        if block.get("type") == "text":
+            parts.append(block.get("text", ""))
+        elif block.get("type") == "tool_result":
+            parts.append("[tool_result]")
+            inner = block.get("content")
+            if isinstance(inner, list):
+                parts.extend(image_text(b) for b in inner
+                             if b.get("type") == "image")
+        elif block.get("type") == "image":
+            parts.append(image_text(block))
+    return " ".join(parts)
+
+
+def make_message(params):
+    """Build a Messages API response echoing the last user message."""
+    messages = params.get("messages", [])
+    text = message_text(messages[-1]) if messages else ""
+    content = [{"type": "text", "text": "Echo: " + text}]
+    stop_reason = "end_turn"
+    tool = re.search(r"\[tool:(\w+)\]", text)
+    if tool and params.get("tools"):
+        content.append({"type": "tool_use", "id": "toolu_mock",
+                        "name": tool.group(1), "input": {}})
+        stop_reason = "tool_use"
+    return {
+        "id": "msg_mock",
+        "type": "message",
+        "role": "assistant",
+        "model": params.get("model", "mock"),
+        "content": content,
+        "stop_reason": stop_reason,
+        "stop_sequence": None,
+        "usage": {"input_tokens": len(json.dumps(params)) // 4,
+                  "output_tokens": len(text) // 4 + 1},
+    }
+
+
+def stream_events(message):
+    """Split a message into Messages API server-sent events."""
+    start = dict(message, content=[], stop_reason=None,
+                 usage={"input_tokens": message["usage"]["input_tokens"],
+                        "output_tokens": 1})
+    yield "message_start", {"type": "message_start", "message": start}
+    for index, block in enumerate(message["content"]):
+        if block["type"] == "text":
+            empty = {"type": "text", "text": ""}
+            deltas = [{"type": "text_delta", "text": block["text"][i:i + 8]}
+                      for i in range(0, len(block["text"]), 8)]
+        else:
+            empty = dict(block, input={})
+            raw = json.dumps(block["input"])
+            deltas = [{"type": "input_json_delta", "partial_json": raw[i:i + 5]}
+                      for i in range(0, len(raw), 5)]
+        yield "content_block_start", {"type": "content_block_start",
+                                      "index": index, "content_block": empty}
+        yield "ping", {"type": "ping"}
+        for delta in deltas:
+            yield "content_block_delta", {"type": "content_block_delta",
+                                          "index": index, "delta": delta}
+        yield "content_block_stop", {"type": "content_block_stop",
+                                     "index": index}
+    yield "message_delta", {"type": "message_delta",
+                            "delta": {"stop_reason": message["stop_reason"],
+                                      "stop_sequence": None},
+                            "usage": {"output_tokens":
+                                      message["usage"]["output_tokens"]}}
+    yield "message_stop", {"type": "message_stop"}
+
+
+def batch_object(batch_id):
+    batch = batches[batch_id]
+    ended = time.time() - batch["created"] >= BATCH_DELAY
+    count = len(batch["requests"])
+    return {
+        "id": batch_id,
+        "type": "message_batch",
+        "processing_status": "ended" if ended else "in_progress",
+        "request_counts": {
+            "processing": 0 if ended else count,
+            "succeeded": count if ended else 0,
+            "errored": 0,
+            "canceled": 0,
+            "expired": 0,
+        },
+    }
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"   # needed for chunked SSE responses
+
+    def send_json(self, status, obj, content_type="application/json"):
+        body = obj if isinstance(obj, bytes) else json.dumps(obj).encode()
+        self.send_response(status)
+        self.send_header("Content-Type", content_type)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def send_stream(self, message):
+        """Send a message as server-sent events, chunked encoding."""
+        self.send_response(200)
+        self.send_header("Content-Type", "text/event-stream")
+        self.send_header("Transfer-Encoding", "chunked")
+        self.end_headers()
+        for name, data in stream_events(message):
+            event = ("event: %s\ndata: %s\n\n" % (name, json.dumps(data))).encode()
+            self.wfile.write(b"%X\r\n%s\r\n" % (len(event), event))
+            self.wfile.flush()
+            time.sleep(STREAM_DELAY)
+        self.wfile.write(b"0\r\n\r\n")
+
+    def send_error_json(self, status, err_type, message):
+        self.send_json(status, {"type": "error",
+                                "error": {"type": err_type,
+                                          "message": message}})
+
+    def check_auth(self):
+        if not self.headers.get("x-api-key"):
+            self.send_error_json(401, "authentication_error",
+                                 "x-api-key header is required")
+            return False
+        return True
+
+    def read_body(self):
+        return self.rfile.read(int(self.headers.get("Content-Length", 0)))
+
+    def read_json(self):
+        try:
+            return json.loads(self.read_body() or b"{}")
+        except ValueError:
+            self.send_error_json(400, "invalid_request_error",
+                                 "Request body is not valid JSON")
+            return None
+
+    def upload_file(self):
+        """Store the file part of a multipart/form-data upload."""
+        if "files-api" not in self.headers.get("anthropic-beta", ""):
+            self.send_error_json(400, "invalid_request_error",
+                                 "Files API requires the anthropic-beta header")
+            return
+        ctype = self.headers.get("Content-Type", "")
+        if not ctype.startswith("multipart/form-data") or "boundary=" not in ctype:
+            self.send_error_json(400, "invalid_request_error",
+                                 "Expected multipart/form-data")
+            return
+        boundary = ctype.split("boundary=", 1)[1].encode()
+        body = self.read_body()
+        # One part: headers, blank line, data, CRLF before the closing boundary
+        part = body.split(b"--" + boundary)[1]
+        head, data = part.split(b"\r\n\r\n", 1)
+        data = data[:-2]
+        mime = "application/octet-stream"
+        for line in head.decode("latin-1").split("\r\n"):
+            if line.lower().startswith("content-type:"):
+                mime = line.split(":", 1)[1].strip()
+        file_id = "file_mock%04d" % (len(files) + 1)
+        files[file_id] = data
+        self.send_json(200, {"id": file_id, "type": "file",
+                             "mime_type": mime, "size_bytes": len(data)})
+
+    def do_POST(self):
+        if not self.check_auth():
+            return
+        if self.path == "/v1/files":
+            self.upload_file()
+            return
+        params = self.read_json()
+        if params is None:
+            return
+
+        if self.path == "/v1/messages":
+            if params.get("model", "").startswith("unknown"):
+                self.send_error_json(404, "not_found_error",
+                                     "model: " + params["model"])
+                return
+            if params.get("stream"):
+                self.send_stream(make_message(params))
+            else:
+                self.send_json(200, make_message(params))
+        elif self.path == "/v1/messages/batches":
+            batch_id = "msgbatch_mock%04d" % (len(batches) + 1)
+            batches[batch_id] = {"created": time.time(),
+                                 "requests": params.get("requests", [])}
+            self.send_json(200, batch_object(batch_id))
+        else:
+            self.send_error_json(404, "not_found_error", "Unknown path")
+
+    def do_GET(self):
+        if not self.check_auth():
+            return
+
+        parts = self.path.strip("/").split("/")
+        if parts[:3] != ["v1", "messages", "batches"] or len(parts) < 4 \
+                or parts[3] not in batches:
+            self.send_error_json(404, "not_found_error", "Unknown batch")
+            return
+
+        batch_id = parts[3]
+        if len(parts) == 4:
+            self.send_json(200, batch_object(batch_id))
+        elif len(parts) == 5 and parts[4] == "results":
+            if batch_object(batch_id)["processing_status"] != "ended":
+                self.send_error_json(400, "invalid_request_error",
+                                     "Batch has not ended yet")
+                return
+            lines = []
+            for req in batches[batch_id]["requests"]:
+                lines.append(json.dumps({
+                    "custom_id": req.get("custom_id"),
+                    "result": {"type": "succeeded",
+                               "message": make_message(req.get("params", {}))},
+                }))
+            self.send_json(200, ("\n".join(lines) + "\n").encode(),
+                           "application/binary")
+        else:
+            self.send_error_json(404, "not_found_error", "Unknown path")
+
+
+def main():
+    port = int(sys.argv[1]) if len(sys.argv) > 1 else 8080
+    server = HTTPServer(("", port), Handler)
+    print("Mock Claude API listening on port %d" % port)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,293 @@
+/*
+ * pngbench - Measure PNG encoder output size and speed
+ *
+ * Encodes a set of synthetic images modelled on what AmigaAI sends
+ * (Workbench screens, dithered backdrops and ILBMs, 24-bit RTG screens
+ * and photos) with each row filter setting, and reports the PNG sizes
+ * and encoding speed. As in png_convert.c, indexed images are packed to
+ * the pens they use and RGB images of at most 256 colours are written
+ * as indexed; the "8-bit" column shows them without either. Runs on the host or, cross-compiled, on the
+ * Amiga itself.
+ *
+ * Usage: pngbench [level] [rounds]
+ *
+ * At level 0 (stored blocks) the time is mostly the CRC-32 and Adler-32
+ * checksums, so "pngbench 0" measures those.
+ *
+ * Build (host):  cc -O2 -Isrc -o tools/pngbench tools/pngbench.c \
+ *                   src/png_encode.c src/deflate.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "png_encode.h"
+
+struct Image {
+    const char *name;
+    int width, height;
+    int color_type;
+    int ncolors;
+    void (*row)(unsigned char *row, int width, int y);
+};
+
+static const int bayer[4][4] = {
+    {  0,  8,  2, 10 }, { 12,  4, 14,  6 }, {  3, 11,  1,  9 }, { 15,  7, 13,  5 }
+};
+
+static unsigned long rnd_state;
+
+static unsigned rnd(void)
+{
+    rnd_state = rnd_state * 1103515245UL + 12345UL;
+    return (unsigned)((rnd_state >> 16) & 0x7FFF);
+}
+
+/* 4-colour Workbench: title bar, two windows with text, icons */
+static void wb4(unsigned char *r, int w, int y)
+{
+    int x;
+    for (x = 0; x < w; x++) {
+        int c = 0;
+        if (y < 11)
+            c = (x > w - 40 || y == 10) ? 1 : 2;
+        else if (x >= 40 && x < 360 && y >= 30 && y < 200) {
+            if (x == 40 || x == 359 || y == 30 || y == 199) c = 1;
+            else if (y < 41) c = ((x + y) & 1) ? 3 : 2;
+            else if (y >= 50 && (y - 50) % 12 < 8 && (x - 50) % 8 < 6 &&
+                     (x * 13 + y * 7 + (x / 8) * 31) % 5) c = 1;
+        } else if (x >= 300 && x < 620 && y >= 120 && y < 250) {
+            if (x == 300 || x == 619 || y == 120 || y == 249) c = 2;
+            else if (y < 131) c = 1;
+            else if ((x / 32 + y / 24) % 5 == 0) c = (x + y) % 3 ? 1 : 2;
+        } else if (x < 40 && y > 20 && y % 40 < 30)
+            c = (x * x + y) % 7 == 0 ? 1 : (x + y) % 9 == 0 ? 3 : 0;
+        r[x] = (unsigned char)c;
+    }
+}
+
+/* 8-colour Workbench with a dithered pattern backdrop */
+static void wbpat8(unsigned char *r, int w, int y)
+{
+    int x;
+    for (x = 0; x < w; x++) {
+        int tx = x % 32, ty = y % 32;
+        int c = 4 + ((tx * tx + ty * 3) / 37 + bayer[ty & 3][tx & 3] / 6) % 4;
+        if (x >= 100 && x < 500 && y >= 40 && y < 220)
+            c = (x == 100 || y == 40) ? 2 : y < 52 ? ((x + y) & 1 ? 3 : 2) : 0;
+        r[x] = (unsigned char)c;
+    }
+}
+
+/* 16-colour dithered ILBM: sky gradient and hills */
+static void ilbm16(unsigned char *r, int w, int y)
+{
+    int x;
+    for (x = 0; x < w; x++) {
+        int hill = 150 + (x * x / 400 + x) / 30 % 40, v;
+        if (y < hill)
+            v = (y * 8 / hill) * 2 + (bayer[y & 3][x & 3] > 7);
+        else
+            v = 8 + (x / 3 + y / 2 + bayer[y & 3][x & 3] / 4) % 8;
+        r[x] = (unsigned char)(v & 15);
+    }
+}
+
+/* 256-colour ordered-dither gradient backdrop */
+static void dither256(unsigned char *r, int w, int y)
+{
+    int x;
+    for (x = 0; x < w; x++)
+        r[x] = (unsigned char)(((x * 200 / w + y * 55 / 256) * 16 +
+                                bayer[y & 3][x & 3] * 3) / 16);
+}
+
+/* 32-colour picture with error-diffusion-like noise */
+static void noise32(unsigned char *r, int w, int y)
+{
+    int x;
+    for (x = 0; x < w; x++)
+        r[x] = (unsigned char)(((x / 20 + y / 16) % 16) * 2 + ((rnd() & 7) == 0));
+}
+
+/* 24-bit photo: smooth gradients with light noise */
+static void photo(unsigned char *r, int w, int y)
+{
+    int x;
+    for (x = 0; x < w; x++) {
+        int n = (int)(rnd() % 7) - 3, cx = x - w / 2, cy = y - 128;
+        r[x * 3]     = (unsigned char)(x * 255 / w + n);
+        r[x * 3 + 1] = (unsigned char)(y + (cx * cx + cy * cy) / 600 + n);
+        r[x * 3 + 2] = (unsigned char)(128 + cx / 4 - cy / 3 + n);
+    }
+}
+
+/* 24-bit RTG Workbench: flat colours, gradient title bars */
+static void rtgwb(unsigned char *r, int w, int y)
+{
+    int x;
+    for (x = 0; x < w; x++) {
+        unsigned char c[3] = { 170, 170, 170 };
+        if (y < 20) {
+            c[0] = (unsigned char)(40 + x * 100 / w);
+            c[1] = (unsigned char)(60 + x * 120 / w);
+            c[2] = 200;
+        } else if (x > 100 && x < 700 && y > 60 && y < 500) {
+            if (x == 101 || y == 61)
+                c[0] = c[1] = c[2] = 255;
+            else if (y < 80) {
+                c[0] = (unsigned char)(x * 255 / w);
+                c[1] = 80;
+                c[2] = 160;
+            } else
+                c[0] = c[1] = c[2] = ((y - 80) % 16 < 10 && (x - 110) % 9 < 7 &&
+                                      (x * 7 + y) % 3) ? 0 : 240;
+        }
+        memcpy(r + x * 3, c, 3);
+    }
+}
+
+/* 24-bit RTG Workbench in a flat theme: a few dozen colours */
+static void rtgflat(unsigned char *r, int w, int y)
+{
+    int x;
+    rtgwb(r, w, y);
+    for (x = 0; x < w; x++) {
+        if (y < 20 || (y > 60 && y < 80 && x > 101 && x < 700)) {
+            r[x * 3]     = (unsigned char)(r[x * 3] & 0xE0);
+            r[x * 3 + 1] = (unsigned char)(r[x * 3 + 1] & 0xC0);
+        }
+    }
+}
+
+static const struct Image images[] = {
+    { "wb4 640x256",       640, 256, PNG_COLOR_INDEXED,   4, wb4 },
+    { "wbpat8 640x256",    640, 256, PNG_COLOR_INDEXED,   8, wbpat8 },
+    { "ilbm16 320x256",    320, 256, PNG_COLOR_INDEXED,  16, ilbm16 },
+    { "dither256 640x512", 640, 512, PNG_COLOR_INDEXED, 256, dither256 },
+    { "noise32 320x256",   320, 256, PNG_COLOR_INDEXED,  32, noise32 },
+    { "photo 320x256",     320, 256, PNG_COLOR_RGB,       0, photo },
+    { "rtgwb 800x600",     800, 600, PNG_COLOR_RGB,       0, rtgwb },
+    { "rtgflat 800x600",   800, 600, PNG_COLOR_RGB,       0, rtgflat }
+};
+
+#define NIMAGES ((int)(sizeof(images) / sizeof(images[0])))
+
+static long out_bytes;
+
+static int count_sink(const unsigned char *data, long len, void *userdata)
+{
+    (void)data;
+    (void)userdata;
+    out_bytes += len;
+    return 0;
+}
+
+/* filters < 0: the encoder's default for the level.
+ * pack: renumber and pack indexed images with PngPens, and write RGB
+ * images of few colours as indexed with PngColors. */
+static long encode(const struct Image *im, int level, int filters, int pack)
+{
+    static unsigned char pixels[640 * 512];
+    static unsigned char row[800 * 3], idx[800];
+    static struct PngColors colors;
+    unsigned char palette[256 * 3];
+    const unsigned char *plte = palette;
+    struct PngPens pens;
+    struct PngEncoder *enc;
+    int i, y, depth = 8, ncolors = im->ncolors, type = im->color_type;
+    int indexed = pack && im->color_type == PNG_COLOR_INDEXED;
+    int rgb_indexed = 0;
+
+    for (i = 0; i < 256 * 3; i++)
+        palette[i] = (unsigned char)(i * 37);
+    out_bytes = 0;
+
+    if (indexed) {
+        rnd_state = 1;
+        for (y = 0; y < im->height; y++)
+            im->row(pixels + y * im->width, im->width, y);
+        png_pens_init(&pens);
+        png_pens_mark(&pens, pixels, (unsigned long)im->width * im->height);
+        png_pens_compact(&pens);
+        depth = pens.bit_depth;
+        ncolors = pens.count;
+    } else if (pack) {
+        rnd_state = 1;
+        png_colors_init(&colors);
+        for (y = 0; y < im->height; y++) {
+            im->row(row, im->width, y);
+            if (png_colors_add(&colors, row, im->width) != 0)
+                break;
+        }
+        if (y == im->height) {
+            rgb_indexed = 1;
+            type = PNG_COLOR_INDEXED;
+            depth = colors.bit_depth;
+            ncolors = colors.count;
+            plte = colors.palette;
+        }
+    }
+
+    rnd_state = 1;
+    enc = png_encoder_new(im->width, im->height, depth, type,
+                          plte, ncolors, level, count_sink, NULL);
+    if (!enc)
+        return -1;
+    if (filters >= 0)
+        png_encoder_set_filters(enc, filters);
+    for (y = 0; y < im->height; y++) {
+        if (indexed) {
+            png_pens_row(&pens, pixels + y * im->width, im->width, row);
+            png_encoder_row(enc, row);
+        } else if (rgb_indexed) {
+            im->row(row, im->width, y);
+            png_colors_row(&colors, row, im->width, idx);
+            png_encoder_row(enc, idx);
+        } else {
+            im->row(row, im->width, y);
+            png_encoder_row(enc, row);
+        }
+    }
+    if (png_encoder_finish(enc) != 0)
+        out_bytes = -1;
+    png_encoder_free(enc);
+
+    return out_bytes;
+}
+
+int main(int argc, char **argv)
+{
+    int level = argc > 1 ? atoi(argv[1]) : DEFLATE_DEFAULT_LEVEL;
+    int rounds = argc > 2 ? atoi(argv[2]) : 5;
+    long total[5] = { 0, 0, 0, 0, 0 };
+    int i, f, r;
+
+    printf("level %d           %9s %9s %9s %9s %9s %8s\n",
+           level, "8-bit", "none", "fast", "all", "default", "ms");
+
+    for (i = 0; i < NIMAGES; i++) {
+        long size[5];
+        clock_t start;
+
+        size[0] = encode(&images[i], level, -1, 0);
+        for (f = 0; f < 3; f++)
+            size[f + 1] = encode(&images[i], level, f, 1);
+
+        start = clock();
+        for (r = 0; r < rounds; r++)
+            size[4] = encode(&images[i], level, -1, 1);
+
+        printf("%-20s %9ld %9ld %9ld %9ld %9ld %8.1f\n", images[i].name,
+               size[0], size[1], size[2], size[3], size[4],
+               (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC / rounds);
+        for (f = 0; f < 5; f++)
+            total[f] += size[f];
+    }
+
+    printf("%-20s %9ld %9ld %9ld %9ld %9ld\n", "total",
+           total[0], total[1], total[2], total[3], total[4]);
+    return 0;
+}